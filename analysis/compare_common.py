@@ -0,0 +1,85 @@
+# compare_common.py
+#
+# Code shared by compare_geometry.py, compare_profiles.py, and
+# compare_transport.py, which run the same macro with different options and
+# compare the results statistically.
+#
+# Each run gets a copy of the base configuration file with some options
+# replaced, and its own output files, named after the run.
+
+from root_numpy import root2rec
+import numpy as np
+import re
+import resource
+import subprocess
+import sys
+
+treename_str = 'ntp1' # Name of tree in .root file
+
+def parse_args():
+    """Returns the executable, the base configuration file, and the macro
+    given on the command line: [singleCrystal] [config.ini] [macro]."""
+    executable = sys.argv[1] if len(sys.argv) > 1 else './singleCrystal'
+    base_config = sys.argv[2] if len(sys.argv) > 2 else 'config.ini'
+    macro = sys.argv[3] if len(sys.argv) > 3 else 'geomBench.in'
+    return executable, base_config, macro
+
+def write_config(base_config, name, overrides):
+    """Copies the base configuration to 'name'.ini, with the options in
+    'overrides' replaced, and the output files named after 'name'. Energies
+    are written in double precision. Options in the [profile.*] and
+    [region.*] sections are kept. Returns the name of the file."""
+    overrides = dict(overrides)
+    for key, extension in [('rootOutfile', 'root'), ('logfileName', 'log'),
+                           ('errfileName', 'err'), ('checkpointFile', 'chk')]:
+        overrides.setdefault(key, '%s.%s' % (name, extension))
+    overrides.setdefault('hitPrecision', 'double')
+    out = []
+    in_section = False
+    for line in open(base_config).read().splitlines():
+        if re.match(r'\s*\[', line):
+            in_section = True
+        m = re.match(r'\s*(\w+)\s*=', line)
+        if m and not in_section and m.group(1) in overrides:
+            line = '%s = %s' % (m.group(1), overrides.pop(m.group(1)))
+        out.append(line)
+    # Options not in the base file go before the first section
+    first_section = len(out)
+    for i, line in enumerate(out):
+        if re.match(r'\s*\[', line):
+            first_section = i
+            break
+    extra = ['%s = %s' % (key, overrides[key]) for key in sorted(overrides)]
+    out = out[:first_section] + extra + out[first_section:]
+    config = '%s.ini' % name
+    open(config, 'w').write('\n'.join(out) + '\n')
+    return config
+
+def run(executable, base_config, macro, name, overrides):
+    """Runs the simulation with a configuration written by write_config().
+    Returns the CPU time and the contents of the ROOT tree."""
+    config = write_config(base_config, name, overrides)
+    before = resource.getrusage(resource.RUSAGE_CHILDREN)
+    subprocess.check_call([executable, '-c', config, macro])
+    after = resource.getrusage(resource.RUSAGE_CHILDREN)
+    cpu = (after.ru_utime - before.ru_utime) + (after.ru_stime - before.ru_stime)
+    data = root2rec('%s.root' % name, treename=treename_str)
+    return cpu, data
+
+def hits_per_event(data):
+    """Number of hits of every event."""
+    return np.array([len(energy) for energy in data['energy']], dtype=float)
+
+def mean_error(a):
+    """Standard error of the mean of a sample."""
+    return a.std() / np.sqrt(len(a)) if len(a) else 0.
+
+def difference(a, b):
+    """Difference of the means of two samples, its standard error, and their
+    ratio."""
+    if len(a) == 0 or len(b) == 0:
+        return 0., 0., float('inf')
+    diff = a.mean() - b.mean()
+    err = np.sqrt(a.var() / len(a) + b.var() / len(b))
+    sigma = abs(diff) / err if err > 0 else (0. if diff == 0 else float('inf'))
+    return diff, err, sigma
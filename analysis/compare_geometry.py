@@ -0,0 +1,46 @@
+# compare_geometry.py
+#
+# Benchmark and regression check for the 'geometryMode' option. Runs the same
+# macro with the boolean and the decomposed geometry, compares the CPU time
+# (dominated by navigation of the optical photons), and checks that the mean
+# number of detected photons per event agrees within 'max_sigma' standard
+# errors.
+#
+# Usage: python compare_geometry.py [singleCrystal] [config.ini] [macro]
+# Exits with a nonzero status if the yields disagree.
+
+from compare_common import parse_args, run, hits_per_event, mean_error, \
+    difference
+import sys
+
+# Set parameters
+executable, base_config, macro = parse_args()
+max_sigma = 3. # Maximum allowed difference of the yields (standard errors)
+modes = ['boolean', 'decomposed']
+
+results = {}
+for mode in modes:
+    cpu, data = run(executable, base_config, macro, 'geom_%s' % mode,
+                    {'geometryMode': mode, 'checkOverlaps': 'false'})
+    results[mode] = cpu, hits_per_event(data)
+
+# Benchmark
+print('%-12s %10s %10s %14s' % ('mode', 'CPU (s)', 'events', 'hits/event'))
+for mode in modes:
+    cpu, n_hits = results[mode]
+    print('%-12s %10.1f %10d %8.1f +- %.1f' % (mode, cpu, len(n_hits),
+                                               n_hits.mean(),
+                                               mean_error(n_hits)))
+cpu_bool = results['boolean'][0]
+cpu_dec = results['decomposed'][0]
+if cpu_dec > 0:
+    print('Speed-up of decomposed geometry: %.2f' % (cpu_bool / cpu_dec))
+
+# Regression check. The random sequences differ once the geometries are
+# navigated differently, so the yields are compared statistically.
+diff, err, sigma = difference(results['boolean'][1], results['decomposed'][1])
+print('Yield difference: %.2f +- %.2f (%.1f sigma)' % (diff, err, sigma))
+if sigma > max_sigma:
+    print('FAILED: detected photon yields disagree')
+    sys.exit(1)
+print('OK: detected photon yields agree')
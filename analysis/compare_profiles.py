@@ -0,0 +1,42 @@
+# compare_profiles.py
+#
+# Chooses the cheapest physics profile for a source. Runs the same macro with
+# each profile of the 'physicsProfile' option, compares the mean number of
+# detected photons per event with the 'reference' profile, and prints the
+# CPU time of each profile. The cheapest profile whose yield agrees with the
+# reference within 'max_sigma' standard errors is recommended.
+#
+# Usage: python compare_profiles.py [singleCrystal] [config.ini] [macro]
+# Exits with a nonzero status if no profile agrees with the reference.
+
+from compare_common import parse_args, run, hits_per_event, mean_error, \
+    difference
+import sys
+
+# Set parameters
+executable, base_config, macro = parse_args()
+max_sigma = 3. # Maximum allowed difference of the yields (standard errors)
+profiles = ['fast', 'standard', 'reference']
+
+results = {}
+for profile in profiles:
+    cpu, data = run(executable, base_config, macro, 'profile_%s' % profile,
+                    {'physicsProfile': profile})
+    results[profile] = cpu, hits_per_event(data)
+
+# Compare each profile with the reference
+ref = results['reference'][1]
+print('%-12s %10s %16s %10s' % ('profile', 'CPU (s)', 'hits/event', 'sigma'))
+passing = []
+for profile in profiles:
+    cpu, n_hits = results[profile]
+    sigma = difference(n_hits, ref)[2]
+    print('%-12s %10.1f %8.1f +- %5.1f %10.1f' %
+          (profile, cpu, n_hits.mean(), mean_error(n_hits), sigma))
+    if sigma <= max_sigma:
+        passing.append((cpu, profile))
+
+if not passing:
+    print('FAILED: no profile agrees with the reference')
+    sys.exit(1)
+print('Cheapest profile agreeing with the reference: %s' % min(passing)[1])
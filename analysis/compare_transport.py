@@ -0,0 +1,56 @@
+# compare_transport.py
+#
+# Checks the analytic optical transport of the crystal ('prismTransport')
+# against full GEANT4 tracking. Runs the same macro with the option off and
+# on, and compares the mean number of detected photons per event and the mean
+# arrival time of the detected photons. Prints the CPU time of both runs and
+# the speedup. The results agree if both means are within 'max_sigma'
+# standard errors.
+#
+# Usage: python compare_transport.py [singleCrystal] [config.ini] [macro]
+# Exits with a nonzero status if the results do not agree.
+
+from compare_common import parse_args, run, hits_per_event, mean_error, \
+    difference
+import numpy as np
+import sys
+
+# Set parameters
+executable, base_config, macro = parse_args()
+max_sigma = 3. # Maximum allowed difference of the means (standard errors)
+modes = ['geant4', 'analytic']
+
+results = {}
+for mode in modes:
+    # The hit times are recorded
+    cpu, data = run(executable, base_config, macro, 'transport_%s' % mode,
+                    {'prismTransport':
+                         'true' if mode == 'analytic' else 'false',
+                     'hitFields': 'energy,time'})
+    times = np.concatenate([np.asarray(t, dtype=float) for t in data['time']]
+                           + [np.zeros(0)])
+    results[mode] = cpu, hits_per_event(data), times
+
+ref_cpu, ref_hits, ref_times = results['geant4']
+print('%-10s %10s %16s %7s %18s %7s' %
+      ('transport', 'CPU (s)', 'hits/event', 'sigma', 'hit time (ns)',
+       'sigma'))
+agree = True
+for mode in modes:
+    cpu, n_hits, times = results[mode]
+    hits_sigma = difference(n_hits, ref_hits)[2]
+    time_sigma = difference(times, ref_times)[2]
+    mean_time = times.mean() if len(times) else 0.
+    print('%-10s %10.1f %8.1f +- %5.1f %7.1f %9.3f +- %6.3f %7.1f' %
+          (mode, cpu, n_hits.mean(), mean_error(n_hits), hits_sigma,
+           mean_time, mean_error(times), time_sigma))
+    if hits_sigma > max_sigma or time_sigma > max_sigma:
+        agree = False
+
+cpu = results['analytic'][0]
+if cpu > 0:
+    print('Speedup: %.2f' % (ref_cpu / cpu))
+if not agree:
+    print('FAILED: the analytic transport does not agree with GEANT4')
+    sys.exit(1)
+print('The analytic transport agrees with GEANT4')
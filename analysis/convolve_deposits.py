@@ -0,0 +1,147 @@
+# convolve_deposits.py
+#
+# Second stage of a two-stage simulation. Reads the energy deposits in the
+# crystal written by singleCrystal with the 'depositLibrary' option, and turns
+# them into detected photons per APD with a light response, so that the same
+# deposits can be reused for many optical and surface configurations.
+#
+# Each deposit emits a number of scintillation photons drawn as in
+# G4Scintillation (Poisson below 10 photons, otherwise Gaussian with the
+# 'resScale' of the configuration). Each photon is then detected by APD i
+# with probability p_i(x, y, z), taken from:
+# - a light response map, if one is given: a text file with the columns
+#   x y z (mm) p_0 ... p_(nAPD-1) on a regular grid, e.g. made from full
+#   simulations of photons emitted at the grid points. The nearest grid point
+#   is used.
+# - otherwise, a fast model: the photons reach the APD end with efficiency
+#   'end_efficiency', attenuated over the distance to it with length
+#   'att_length', and shared equally by the APDs.
+#
+# Usage: python convolve_deposits.py deposits.scdl [config.ini] [map.txt]
+# Writes one line per event to 'convolved.csv': the event number, the
+# detected photons of each APD, and their sum.
+
+import numpy as np
+import re
+import struct
+import sys
+
+# Set parameters
+library_file = sys.argv[1]
+config_file = sys.argv[2] if len(sys.argv) > 2 else 'config.ini'
+map_file = sys.argv[3] if len(sys.argv) > 3 else None
+out_file = 'convolved.csv'
+end_efficiency = 0.1 # Fast model: detected fraction of photons at the APD end
+att_length = 500. # Fast model: attenuation length along the crystal (mm)
+seed = 0 # Seed of the random numbers
+
+def read_config(name):
+    """Returns the options of a configuration file, outside the sections."""
+    options = {}
+    for line in open(name).read().splitlines():
+        if re.match(r'\s*\[', line):
+            break
+        m = re.match(r'\s*(\w+)\s*=\s*([^#]*)', line)
+        if m:
+            options[m.group(1)] = m.group(2).strip()
+    return options
+
+def read_library(name):
+    """Returns a dictionary of the deposits of each event, as arrays of rows
+    x, y, z (mm), energy (keV), time (ns). The last record of an event wins.
+    Reading stops with a warning at a record cut short, e.g. by a job killed
+    while writing."""
+    data = open(name, 'rb').read()
+    if data[:4] != b'SCDL':
+        sys.exit('%s is not a deposit library' % name)
+    version, = struct.unpack_from('I', data, 4)
+    if version != 1:
+        sys.exit('Unknown deposit library version %d' % version)
+    events = {}
+    pos = 8
+    while pos + 8 <= len(data):
+        event_id, n = struct.unpack_from('iI', data, pos)
+        pos += 8
+        if pos + 20 * n > len(data):
+            sys.stderr.write('Warning: %s ends with an incomplete record of '
+                             'event %d. It is ignored.\n' % (name, event_id))
+            break
+        deposits = np.frombuffer(data, dtype=np.float32, count=5 * n,
+                                 offset=pos).reshape(n, 5)
+        pos += 20 * n
+        events[event_id] = deposits
+    return events
+
+class ResponseMap:
+    """Detection probabilities of each APD on a regular grid."""
+    def __init__(self, name):
+        table = np.loadtxt(name)
+        self.axes = [np.unique(table[:, i]) for i in range(3)]
+        shape = [len(axis) for axis in self.axes]
+        if np.prod(shape) != len(table):
+            sys.exit('%s is not a regular grid' % name)
+        index = [np.searchsorted(self.axes[i], table[:, i]) for i in range(3)]
+        self.values = np.zeros(shape + [table.shape[1] - 3])
+        self.values[index[0], index[1], index[2]] = table[:, 3:]
+
+    def __call__(self, xyz):
+        index = []
+        for i, axis in enumerate(self.axes):
+            j = np.clip(np.searchsorted(axis, xyz[:, i]), 1, len(axis) - 1)
+            # Nearest of the grid points on either side
+            j -= (xyz[:, i] - axis[j - 1]) < (axis[j] - xyz[:, i])
+            index.append(j if len(axis) > 1 else np.zeros_like(j))
+        return self.values[index[0], index[1], index[2]]
+
+config = read_config(config_file)
+yield_per_kev = float(config['scintYield'])
+res_scale = float(config['resScale'])
+n_apd = int(config['nAPD'])
+crys_size_z = float(config['crysSizeZ'])
+
+if map_file:
+    response = ResponseMap(map_file)
+else:
+    # The APDs are at the -z end of the crystal
+    def response(xyz):
+        p = end_efficiency * np.exp(-(xyz[:, 2] + 0.5 * crys_size_z)
+                                    / att_length) / n_apd
+        return np.repeat(p[:, np.newaxis], n_apd, axis=1)
+
+rng = np.random.RandomState(seed)
+events = read_library(library_file)
+out = open(out_file, 'w')
+out.write('eventID,%s,sum\n' % ','.join('APD%d' % i for i in range(n_apd)))
+counts = []
+for event_id in sorted(events):
+    deposits = events[event_id]
+    mean = yield_per_kev * deposits[:, 3].astype(float)
+    photons = np.where(mean > 10.,
+        np.rint(rng.normal(mean, res_scale * np.sqrt(mean))),
+        rng.poisson(mean)).clip(0).astype(np.int64)
+    # Share the photons of each deposit between the APDs and the undetected,
+    # one APD at a time
+    p = response(deposits[:, :3].astype(float))
+    detected = np.zeros(n_apd, dtype=np.int64)
+    left = photons
+    p_left = np.ones(len(photons))
+    for i in range(n_apd):
+        p_i = np.clip(p[:, i] / np.maximum(p_left, 1e-12), 0., 1.)
+        n_i = rng.binomial(left, p_i)
+        detected[i] = n_i.sum()
+        left = left - n_i
+        p_left = p_left - p[:, i]
+    counts.append(detected)
+    out.write('%d,%s,%d\n' % (event_id, ','.join(str(n) for n in detected),
+                              detected.sum()))
+out.close()
+
+counts = np.array(counts, dtype=float).reshape(-1, n_apd)
+print('%d events, written to %s' % (len(counts), out_file))
+for i in range(n_apd):
+    print('APD%d: %.1f +- %.1f photons/event (RMS)' %
+          (i, counts[:, i].mean(), counts[:, i].std()))
+total = counts.sum(axis=1)
+if total.mean() > 0:
+    print('Sum: %.1f photons/event, RMS/mean %.3f' %
+          (total.mean(), total.std() / total.mean()))
@@ -17,6 +17,7 @@ class IAnalysisFactory;
 class ITree;
 class IHistogramFactory;
 class ITupleFactory;
+class ITuple;
 class IPlotter;
 }
 
@@ -72,6 +73,26 @@ public:
    * \return A pointer to the plotter
    */
   AIDA::IPlotter* getPlotter();
+  //! Accessor method for the tree
+  /*!
+   * Returns the pointer to the tree that holds the AIDA objects
+   * \return A pointer to the tree
+   */
+  AIDA::ITree* getTree();
+  //! Writes the current contents of the tree to the AIDA file
+  /*!
+   * \return Whether the commit succeeded
+   */
+  G4bool commit();
+  //! Removes the rows of a tuple after the first ones
+  /*!
+   * AIDA tuples cannot be shortened, so the rows kept are read back, the
+   * tuple is reset, and they are filled again.
+   * \param tuple The tuple
+   * \param nRows Number of rows to keep
+   * \return False if the tuple has fewer than 'nRows' rows
+   */
+  G4bool truncate(AIDA::ITuple* tuple, G4int nRows);
 
 private:
   //! Constructor
@@ -0,0 +1,155 @@
+/*!
+ * \file singCrysCheckpoint.hh
+ * \brief Header file for the singCrysCheckpoint class. Writes and reads
+ * checkpoints of long runs.
+ */
+
+#ifndef singCrysCheckpoint_h
+#define singCrysCheckpoint_h 1
+
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+#include <csignal>
+#include <ctime>
+#include <vector>
+
+/*!
+ * \class singCrysCheckpoint
+ * \brief Singleton class that keeps track of run progress and writes
+ * checkpoints from which a killed job can be resumed.
+ *
+ * A checkpoint is a small text file ('checkpointFile') recording the index of
+ * the current /run/beamOn in the macro, the number of events of that run that
+ * have been completed and written out, the particle gun position (i.e. the
+ * position in a scan), the number of entries in the ROOT tree, the number of
+ * rows of each AIDA tuple, and the length of the deposit library. The state of the random engine is saved next to it, in 'checkpointFile' + ".rndm".
+ * Both files are written to a temporary file first and then renamed, so a
+ * checkpoint is never half-written.
+ *
+ * Checkpoints are written every 'checkpointEvery' events and/or every
+ * 'checkpointMinutes' minutes, at the end of every run, and when SIGINT or
+ * SIGTERM is received. In the last case the current event is finished, the
+ * run is aborted, and all remaining /run/beamOn commands are skipped, so that
+ * the program exits normally and the output files are closed properly. A
+ * second signal kills the program immediately.
+ *
+ * When the program is started with --resume, the same configuration file
+ * and macro should be given. Runs that were completed are skipped, the
+ * random engine is restored, and the interrupted run continues with the
+ * event after the last checkpoint. Output files are opened for update
+ * rather than recreated, and the entries written after the last checkpoint
+ * (e.g. by an autosave) are removed from them, so that no event is written
+ * twice. If an output file has fewer entries than the checkpoint recorded,
+ * the job cannot be resumed.
+ */
+
+class singCrysCheckpoint
+{
+  public:
+    //! Returns a pointer to the singleton instance of the class.
+    static singCrysCheckpoint* GetInstance();
+    //! Reads the checkpoint file, so that the job continues from it
+    /*!
+     * Must be called before the user action classes are constructed.
+     * \return Whether a checkpoint was found and read
+     */
+    G4bool Resume();
+    //! Whether the job is continuing from a checkpoint
+    /*!
+     * \return True from a successful Resume() until the interrupted run has
+     * been started
+     */
+    G4bool IsResuming() const {return resuming;}
+    //! Whether periodic checkpoints are enabled in the configuration
+    G4bool IsEnabled() const {return checkpointEvery > 0 || checkpointTime > 0;}
+    //! Installs the SIGINT and SIGTERM handlers
+    static void InstallSignalHandlers();
+    //! Whether SIGINT or SIGTERM has been received
+    static G4bool StopRequested() {return stopRequested != 0;}
+    //! Called at the start of each /run/beamOn
+    /*!
+     * Updates the run index. When resuming, restores the random engine at
+     * the interrupted run.
+     * \param nEvent Number of events requested for the run
+     * \param gunPos Current position of the particle gun
+     * \return Number of events of this run that are already done. Equal to
+     * nEvent if the whole run should be skipped.
+     */
+    G4int BeginRun(G4int nEvent, const G4ThreeVector& gunPos);
+    //! Called at the end of each event
+    void EventDone() {eventsDone++;}
+    //! Whether a periodic checkpoint should be written now
+    G4bool IsDue() const;
+    //! Offset to add to GEANT4 event IDs in the current run
+    /*!
+     * \return Number of events of this run done before the job was resumed
+     */
+    G4int GetEventOffset() const {return eventOffset;}
+    //! Number of events written to the ROOT tree at the last checkpoint
+    G4long GetRootEntries() const {return rootEntries;}
+    //! Number of rows of the AIDA tuples at the last checkpoint
+    /*!
+     * \return The rows of each tuple, in the order given to Write(). Empty if
+     * the checkpoint did not record them.
+     */
+    const std::vector<G4long>& GetTupleRows() const {return tupleRows;}
+    //! Length of the deposit library at the last checkpoint (bytes)
+    /*!
+     * \return The length, or -1 if the checkpoint did not record it
+     */
+    G4long GetDepositBytes() const {return depositBytes;}
+    //! Writes the checkpoint and the random engine state
+    /*!
+     * The output must have been flushed before this is called.
+     * \param gunPos Current position of the particle gun
+     * \param nRootEntries Number of entries in the ROOT tree, or 0
+     * \param nTupleRows Number of rows of each AIDA tuple
+     * \param nDepositBytes Length of the deposit library, or 0
+     */
+    void Write(const G4ThreeVector& gunPos, G4long nRootEntries,
+               const std::vector<G4long>& nTupleRows, G4long nDepositBytes);
+
+  protected:
+    //! Constructor
+    /*!
+     * Reads the checkpoint options from singCrysConfig.
+     */
+    singCrysCheckpoint();
+    singCrysCheckpoint(const singCrysCheckpoint&);
+    singCrysCheckpoint& operator=(const singCrysCheckpoint&);
+    //! Signal handler for SIGINT and SIGTERM
+    static void RequestStop(int sig);
+    //! Set by the signal handler
+    static volatile sig_atomic_t stopRequested;
+
+    //! Name of the checkpoint file
+    G4String checkpointFile;
+    //! Number of events between checkpoints; 0 for none
+    G4int checkpointEvery;
+    //! Time between checkpoints (s); 0 for none
+    G4double checkpointTime;
+    //! Time of the last checkpoint
+    time_t lastCheckpoint;
+    //! Index of the current run in the macro
+    G4int runIndex;
+    //! Number of events done in the current run
+    G4int eventsDone;
+    //! Number of events done in the current run before resuming
+    G4int eventOffset;
+    //! Number of entries in the ROOT tree at the last checkpoint
+    G4long rootEntries;
+    //! Number of rows of the AIDA tuples at the last checkpoint
+    std::vector<G4long> tupleRows;
+    //! Length of the deposit library at the last checkpoint
+    G4long depositBytes;
+    //! Whether the job is continuing from a checkpoint
+    G4bool resuming;
+    //! Run index read from the checkpoint
+    G4int resumeRun;
+    //! Number of events done in the interrupted run, read from the checkpoint
+    G4int resumeEvents;
+    //! Gun position read from the checkpoint
+    G4ThreeVector resumeGunPos;
+};
+
+#endif
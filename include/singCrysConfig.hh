@@ -73,6 +73,17 @@ class singCrysConfig {
      * \return A pointer to the variable map
      */
     po::variables_map* GetMap();
+    //! Changes the value of an option
+    /*!
+     * The value is parsed as in the configuration file. Classes that read the
+     * option only when they are constructed will not see the change; the
+     * geometry reads its options again when it is rebuilt (see
+     * singCrysDetectorMessenger).
+     * \param name Name of the option
+     * \param value New value of the option
+     * \return Whether the option exists and the value could be parsed
+     */
+    G4bool SetOption(const std::string& name, const std::string& value);
 
   protected:
     //! Constructor
@@ -85,6 +96,8 @@ class singCrysConfig {
     singCrysConfig();
     singCrysConfig(const singCrysConfig&);
     singCrysConfig& operator=(const singCrysConfig&);
+    //! Description of all configuration options
+    po::options_description desc;
     //! Map that stores all configuration options
     po::variables_map vm;
     //! Name of the file from which the configuration options are read
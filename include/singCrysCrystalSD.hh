@@ -0,0 +1,45 @@
+/*!
+ * \file singCrysCrystalSD.hh
+ * \brief Header file for the singCrysCrystalSD class. Defines a sensitive
+ * detector for the energy deposits in the crystal.
+ */
+
+#ifndef singCrysCrystalSD_h
+#define singCrysCrystalSD_h 1
+
+#include "G4VSensitiveDetector.hh"
+
+class G4Step;
+class G4HCofThisEvent;
+
+/*!
+ * \class singCrysCrystalSD
+ * \brief Sensitive detector of the crystal, used when 'depositLibrary' is
+ * set.
+ *
+ * Gives every energy deposit in the crystal, at the middle of its step, to
+ * singCrysDepositLibrary, and has it write them at the end of each event.
+ * It has no hits collection.
+ */
+
+class singCrysCrystalSD : public G4VSensitiveDetector
+{
+  public:
+    //! Constructor
+    singCrysCrystalSD(const G4String& name);
+    //! Destructor
+    virtual ~singCrysCrystalSD();
+    //! Passes the energy deposit of a step to the library
+    /*!
+     * \param step The step of this event
+     * \param history The touchable history
+     */
+    virtual G4bool ProcessHits(G4Step* step, G4TouchableHistory* history);
+    //! Writes the deposits of the event to the library
+    /*!
+     * \param hitCollection The hit collection of this event
+     */
+    virtual void EndOfEvent(G4HCofThisEvent* hitCollection);
+};
+
+#endif
@@ -0,0 +1,87 @@
+/*!
+ * \file singCrysDepositLibrary.hh
+ * \brief Header file for the singCrysDepositLibrary class. Writes the energy
+ * deposits in the crystal to a file.
+ */
+
+#ifndef singCrysDepositLibrary_h
+#define singCrysDepositLibrary_h 1
+
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+#include <fstream>
+#include <vector>
+
+/*!
+ * \class singCrysDepositLibrary
+ * \brief Singleton class writing the energy deposits of each event in the
+ * crystal, for the first stage of a two-stage simulation.
+ *
+ * If 'depositLibrary' is set, no scintillation or Cerenkov light is made
+ * (see singCrysPhysicsList), and singCrysCrystalSD gives every energy
+ * deposit in the crystal to this class. The deposits are then convolved
+ * offline with a light response (analysis/convolve_deposits.py), so that the
+ * same deposits can be reused for many optical configurations.
+ *
+ * The file is binary, in the byte order of the machine:
+ * - a header: the characters "SCDL", and the format version (uint32, 1);
+ * - for each event: the event number (int32), the number of deposits
+ *   (uint32), then for each deposit x, y, z (mm), energy (keV), and global
+ *   time (ns), as float32.
+ *
+ * Every event has a record, even without deposits. The length of the file
+ * is recorded in each checkpoint. When resuming, the file is cut back to
+ * that length, which removes the records written after the checkpoint
+ * (possibly the last one only in part), and is then appended to.
+ */
+
+class singCrysDepositLibrary
+{
+  public:
+    //! Returns a pointer to the singleton instance of the class.
+    static singCrysDepositLibrary* GetInstance();
+    //! Whether the library is written ('depositLibrary' is set)
+    G4bool IsEnabled() const {return enabled;}
+    //! Adds a deposit to the current event
+    /*!
+     * \param position Position of the deposit
+     * \param energy Deposited energy
+     * \param time Global time of the deposit
+     */
+    void AddDeposit(const G4ThreeVector& position, G4double energy,
+                    G4double time);
+    //! Writes the deposits of the current event, and forgets them
+    /*!
+     * \param eventID Number of the event
+     */
+    void EndOfEvent(G4int eventID);
+    //! Writes the buffered records to disk
+    void Flush();
+    //! Length of the file (bytes), to be recorded in a checkpoint
+    /*!
+     * \return The length, or 0 if the library is not written. Flush()
+     * should be called first.
+     */
+    G4long GetLength();
+
+  protected:
+    //! Constructor
+    /*!
+     * Gets 'depositLibrary' from singCrysConfig and opens the file. When
+     * resuming from a checkpoint, cuts it back to its length at the
+     * checkpoint and appends to it.
+     */
+    singCrysDepositLibrary();
+    //! Destructor. Closes the file.
+    ~singCrysDepositLibrary();
+    singCrysDepositLibrary(const singCrysDepositLibrary&);
+    singCrysDepositLibrary& operator=(const singCrysDepositLibrary&);
+    //! Whether the library is written
+    G4bool enabled;
+    //! The library file
+    std::ofstream file;
+    //! Deposits of the current event, five floats each
+    std::vector<float> deposits;
+};
+
+#endif
@@ -11,10 +11,20 @@
 #include "globals.hh"
 #include "G4Material.hh"
 #include "G4OpticalSurface.hh"
+#include "singCrysPhysicsProfile.hh"
+#include <map>
+#include <vector>
 
 class G4VPhysicalVolume;
+class G4VSolid;
+class G4LogicalVolume;
 class G4UserLimits;
+class G4ProductionCuts;
+class G4Region;
 class singCrysSiliconSD;
+class singCrysCrystalSD;
+class singCrysPrismTransport;
+class singCrysDetectorMessenger;
 
 /*!
  * \class singCrysDetectorConstruction
@@ -24,6 +34,25 @@ class singCrysSiliconSD;
  * simplified silicon APD on one end. Hits on silicon chip in APD are recorded
  * using a SensitiveDetector in the APD epoxy layer.
  *
+ * Layer 1 (notched for the insert) and the aluminum APD case (with pockets
+ * for layer 2, the coatings, and the APDs) are boolean solids by default.
+ * With 'geometryMode = decomposed' they are built from plain polyhedra
+ * instead: the insert is placed inside an unnotched layer 1, and the case is
+ * a ring, a slot slab holding the APDs, and a bottom slab. The surfaces are
+ * the same, but navigation is much faster. Where the faces of the insert
+ * are on faces of layer 1, GEANT4 leaves both volumes in the same step, so
+ * a photon still goes from the insert straight into layer 2.
+ *
+ * The geometry can be rebuilt with different options without restarting the
+ * program, with the commands of singCrysDetectorMessenger.
+ *
+ * The crystal, the APDs, and the passive volumes (layers, insert, coatings,
+ * and aluminum case) are G4Regions with their own production cuts and user
+ * limits, from the [region.<name>] sections of the configuration file (see
+ * singCrysPhysicsProfile). The world uses the default cut. With
+ * 'prismTransport', the crystal region gets a singCrysPrismTransport model,
+ * which tracks the optical photons inside the crystal.
+ *
  * <H3>How to add a new material</H3>
  * If it is not a built-in GEANT4 material, make a new G4Material in
  * singCrysDetectorConstruction::DefineMaterials(). If it is going to interact
@@ -56,6 +85,30 @@ class singCrysDetectorConstruction : public G4VUserDetectorConstruction
       \return A pointer to the world physical volume
     */
     virtual G4VPhysicalVolume* Construct();
+    //! Rebuilds the geometry from the current configuration options
+    /*!
+     * Deletes all volumes, solids, and optical surfaces, calls Construct()
+     * again, and gives the new world volume to the run manager. Materials
+     * (with their properties tables) and the sensitive detector are kept, so
+     * physics tables are only built for materials that were not used before.
+     * Called by /singCrys/geom/rebuild.
+     */
+    void Rebuild();
+    //! Updates the optical properties from the current configuration options
+    /*!
+     * Reads the data files and options again, and copies the new values into
+     * the existing properties tables and optical surfaces, without
+     * rebuilding the geometry. Only the properties read at every step are
+     * updated: constants, surface parameters, and vectors such as ABSLENGTH
+     * or the surface REFLECTIVITY and EFFICIENCY. GEANT4 tabulates RINDEX,
+     * FASTCOMPONENT, SLOWCOMPONENT, and RAYLEIGH when the processes are
+     * built, so changes of these are reported and ignored.
+     * Called by /singCrys/optics/set and /singCrys/optics/reload.
+     */
+    void UpdateOptics();
+    //! Fast simulation model of the optical photons in the crystal, or 0 if
+    //! 'prismTransport' is not used
+    singCrysPrismTransport* GetPrismTransport() const {return prismTransport;}
   
   private:
     //! Defines materials
@@ -138,8 +191,114 @@ class singCrysDetectorConstruction : public G4VUserDetectorConstruction
      * \return the G4OpticalSurfaceFinish appropriate for the surface
      */
     G4OpticalSurfaceFinish finishType(G4String finishStr);
+    //! Solids that can be used for a regular prism
+    enum PrismShape
+    {
+      kPolyhedra,
+      kBox,
+      kTubs
+    };
+    //! Chooses the solid for a prism
+    /*!
+     * A G4Box for 4 sides (without a hole), a G4Tubs for 'tubsMinSides' or
+     * more sides, and a G4Polyhedra otherwise, or if 'specializeSolids' is
+     * false.
+     * \param rInner Apothem of the hole in the prism (0 for none)
+     * \return The solid to use
+     */
+    PrismShape prismShape(G4double rInner) const;
+    //! Ratio of the radius of a G4Tubs to the apothem of the prism it
+    //! replaces. The areas of the cross sections are the same.
+    G4double tubsRadiusFactor() const;
+    //! Makes a regular prism with the crystal's number of sides
+    /*!
+     * The parameters are those of the equivalent G4Polyhedra. A G4Box or
+     * G4Tubs is centered on its origin, unlike the G4Polyhedra, so the
+     * difference must be added to its placement.
+     * \param name Name of the solid
+     * \param zPlanes z coordinates of the two faces
+     * \param rInner Apothems of the hole at the two faces
+     * \param rOuter Apothems of the prism at the two faces
+     * \param zOffset Set to the z coordinate of the origin of the solid in
+     * the frame of the G4Polyhedra
+     * \return The solid
+     */
+    G4VSolid* makePrism(G4String name, const G4double zPlanes[2],
+                        const G4double rInner[2], const G4double rOuter[2],
+                        G4double& zOffset);
+    //! Gives a material its properties table, unless it already has one
+    /*!
+     * \param material The material
+     * \param materialStr Name of the material, passed to generateTable()
+     */
+    void setTable(G4Material* material, G4String materialStr);
+    //! Resamples the property vectors of a table on uniform grids
+    /*!
+     * Does nothing unless 'opticalLUT' is set. Otherwise, each vector with
+     * more than two points is replaced by a singCrysUniformPropertyVector
+     * with 'opticalLUTBins' bins, and the interpolation error is printed.
+     * \param table The table, which must not be used by the physics yet
+     * \param owner Name of the material or surface, for the printout
+     */
+    void resampleTable(G4MaterialPropertiesTable* table, G4String owner);
+    //! Copies properties into an existing table
+    /*!
+     * Properties missing from 'newTable' are removed from 'table'. Property
+     * vectors that changed are moved from 'newTable' to 'table', and the
+     * old ones are deleted. Vectors tabulated by GEANT4 processes (RINDEX,
+     * FASTCOMPONENT, SLOWCOMPONENT, RAYLEIGH) are kept, with a warning if
+     * they changed.
+     * \param table The table to update
+     * \param newTable The table with the new properties
+     * \param owner Name of the material or surface, for the printout
+     */
+    void copyProperties(G4MaterialPropertiesTable* table,
+                        G4MaterialPropertiesTable* newTable, G4String owner);
+    //! Makes a region with the current cuts and limits of its options
+    /*!
+     * \param region The region
+     * \param roots Root logical volumes of the region. Their daughters
+     * belong to it too, unless they are the roots of another region.
+     */
+    void setupRegion(singCrysPhysicsProfile::Region region,
+                     const std::vector<G4LogicalVolume*>& roots);
     //! Pointer to the sensitive detector that detects hits on the silicon APD
     singCrysSiliconSD* siliconSD;
+    //! Pointer to the sensitive detector recording the deposits in the
+    //! crystal, if 'depositLibrary' is set
+    singCrysCrystalSD* crystalSD;
+    //! Fast simulation model of the optical photons in the crystal, if
+    //! 'prismTransport' is set. Made by Construct() and deleted by Rebuild().
+    singCrysPrismTransport* prismTransport;
+    //! Pointer to the messenger for the geometry commands
+    singCrysDetectorMessenger* messenger;
+    //! Regions, made by Construct() and deleted by Rebuild()
+    G4Region* regions[singCrysPhysicsProfile::kNRegions];
+    //! Production cuts of the regions. They are kept when the geometry is
+    //! rebuilt, since the material-cuts couples refer to them.
+    G4ProductionCuts* regionCuts[singCrysPhysicsProfile::kNRegions];
+    //! User limits of the regions, kept when the geometry is rebuilt
+    G4UserLimits* regionLimits[singCrysPhysicsProfile::kNRegions];
+    //! Materials given a properties table, with the names of their tables
+    std::map<G4Material*, G4String> opticalMaterials;
+    //! Properties tables of the skin surfaces, deleted by Rebuild()
+    std::vector<G4MaterialPropertiesTable*> surfaceTables;
+    //! Surfaces between the crystal and the layer 1 insert (both ways)
+    G4OpticalSurface* insertSurfaces[2];
+    //! Surfaces between the crystal and layer 1 (both ways)
+    G4OpticalSurface* crystalSurfaces[2];
+    //! Skin surface of the silicon
+    G4OpticalSurface* siliconSurface;
+    //! Skin surface of the APD casing
+    G4OpticalSurface* casingSurface;
+    //! Number of sides of the prisms
+    G4int numSides;
+    //! Starting angle of the G4Polyhedra prisms
+    G4double prismRotation;
+    //! Whether to use G4Box and G4Tubs for prisms when possible
+    G4bool specializeSolids;
+    //! Number of sides from which prisms are made as G4Tubs (0 for never)
+    G4int tubsMinSides;
 };
 
 #endif
@@ -0,0 +1,94 @@
+/*!
+ * \file singCrysDetectorMessenger.hh
+ * \brief Header file for singCrysDetectorMessenger class. Handles UI
+ * commands specific to the singCrysDetectorConstruction class
+ */
+
+#ifndef singCrysDetectorMessenger_h
+#define singCrysDetectorMessenger_h 1
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class singCrysDetectorConstruction;
+class G4UIdirectory;
+class G4UIcommand;
+class G4UIcmdWithoutParameter;
+
+/*!
+ * \class singCrysDetectorMessenger
+ * \brief Handles UI commands specific to the singCrysDetectorConstruction
+ * class
+ *
+ * Allows the geometry to be changed without restarting the program.
+ * /singCrys/geom/set changes a configuration option, with the same syntax as
+ * in the configuration file, and /singCrys/geom/rebuild builds the geometry
+ * again from the current options. Several options can be set before a
+ * single rebuild. A geometry sweep then looks like
+ *
+ * \code
+ * /singCrys/geom/set crysSizeZ 100.
+ * /singCrys/geom/rebuild
+ * /run/beamOn 1000
+ * /singCrys/geom/set crysSizeZ 120.
+ * /singCrys/geom/rebuild
+ * /run/beamOn 1000
+ * \endcode
+ *
+ * Only the options read by singCrysDetectorConstruction::Construct() take
+ * effect. Materials are reused, so the physics tables are not rebuilt.
+ *
+ * The optical properties can be changed without rebuilding the geometry.
+ * /singCrys/optics/set changes an option (a data file, a constant such as
+ * 'scintYield' or 'ceramicRefl', or a surface finish or sigma alpha) and
+ * copies the new values into the existing properties tables and surfaces.
+ * /singCrys/optics/reload does the same after data files were edited.
+ */
+
+class singCrysDetectorMessenger: public G4UImessenger
+{
+  public:
+    //! Constructor
+    /*!
+     * Defines the directories and commands.
+     * \param DC Pointer to the singCrysDetectorConstruction class, which is
+     * then stored in the relevant field.
+     */
+    singCrysDetectorMessenger(singCrysDetectorConstruction* DC);
+    //! Destructor
+    /*!
+     * Deletes directories and commands created in constructor
+     */
+    virtual ~singCrysDetectorMessenger();
+    //! Executes the commands
+    /*!
+     * \param command The command passed by the UI manager.
+     * \param newVal The string inputted along with the command.
+     */
+    virtual void SetNewValue(G4UIcommand* command, G4String newVal);
+
+  private:
+    //! Adds the parameters of a command that sets an option
+    /*!
+     * \param command The command
+     */
+    void addOptionParameters(G4UIcommand* command);
+    //! Pointer to the affiliated singCrysDetectorConstruction class
+    singCrysDetectorConstruction* DetectorConstruction;
+
+    //! Pointer to the directory for the geometry UI commands
+    G4UIdirectory* geomDirectory;
+    //! Pointer to the directory for the optical properties UI commands
+    G4UIdirectory* opticsDirectory;
+
+    //! Command to change a configuration option
+    G4UIcommand* setCmd;
+    //! Command to rebuild the geometry
+    G4UIcmdWithoutParameter* rebuildCmd;
+    //! Command to change an optical option and update the properties
+    G4UIcommand* opticsSetCmd;
+    //! Command to read the optical properties again
+    G4UIcmdWithoutParameter* reloadCmd;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*!
+ * \file singCrysDigitizer.hh
+ * \brief Header file for the singCrysDigitizer class. Turns the hits of an
+ * event into APD amplitudes.
+ */
+
+#ifndef singCrysDigitizer_h
+#define singCrysDigitizer_h 1
+
+#include "globals.hh"
+#include "Randomize.hh"
+#include <vector>
+
+class singCrysSiliconHitArena;
+
+/*!
+ * \class singCrysDigitizer
+ * \brief Models the response of the APDs to the hits of an event.
+ *
+ * Each hit is a photoelectron in the APD it was recorded in. To these, each
+ * APD adds dark counts, Poisson distributed with mean 'apdDarkCounts'. The
+ * N photoelectrons are multiplied with mean gain M = 'apdGain' and excess
+ * noise factor F = 'apdExcessNoise', so that the charge is N M on average
+ * with variance N M^2 (F - 1), drawn from a Gaussian. Gaussian electronics
+ * noise of 'apdNoise' electrons RMS is then added. The amplitude of each APD
+ * is this charge, in electrons.
+ *
+ * With 'digitize = on', singCrysEventAction writes the amplitudes along with
+ * the hits, and with 'digitize = only', instead of them. If 'digitizeSum' is
+ * set, the sum of the amplitudes of all APDs is written as well.
+ *
+ * The random numbers of all APDs are drawn at once, in arrays, from the
+ * digitizer's own engine. It is seeded from 'digitizeSeed' and the event
+ * number, as in singCrysHitSampler, so the amplitudes of an event do not
+ * depend on the events before it, nor change the simulated events.
+ */
+
+class singCrysDigitizer
+{
+  public:
+    //! Whether and how the amplitudes are written
+    enum Mode
+    {
+      kOff, //!< No digitization
+      kOn, //!< Amplitudes written along with the hits
+      kOnly //!< Amplitudes written instead of the hits
+    };
+    //! Constructor
+    /*!
+     * Gets the options from singCrysConfig, and adds the APD to the hit
+     * schema when digitizing.
+     */
+    singCrysDigitizer();
+    //! Whether and how the amplitudes are written
+    Mode GetMode() const {return mode;}
+    //! Whether the sum of the amplitudes is written
+    G4bool HasSum() const {return withSum;}
+    //! Computes the amplitudes of an event
+    /*!
+     * \param eventID Number of the event
+     * \param arena Hits of the event, or 0 for none
+     */
+    void Digitize(G4int eventID, const singCrysSiliconHitArena* arena);
+    //! Amplitudes of the last event, per APD (electrons)
+    const std::vector<G4double>& GetAmplitudes() const {return amplitudes;}
+    //! Sum of the amplitudes of the last event (electrons)
+    G4double GetSum() const {return sum;}
+
+  private:
+    //! Whether and how the amplitudes are written
+    Mode mode;
+    //! Whether the sum of the amplitudes is written
+    G4bool withSum;
+    //! Mean gain of the APDs
+    G4double gain;
+    //! Excess noise factor of the APDs
+    G4double excessNoise;
+    //! Mean number of dark counts per APD per event
+    G4double darkCounts;
+    //! Electronics noise (electrons RMS)
+    G4double noise;
+    //! Seed of the random engine, combined with the event number
+    long seed;
+    //! Random engine used only for digitization
+    CLHEP::MTwistEngine engine;
+    //! Number of photoelectrons per APD
+    std::vector<long> photoelectrons;
+    //! Standard normal numbers: gain fluctuation of each APD, then noise
+    std::vector<G4double> normals;
+    //! Amplitudes of the last event
+    std::vector<G4double> amplitudes;
+    //! Sum of the amplitudes of the last event
+    G4double sum;
+};
+
+#endif
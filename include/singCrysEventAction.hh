@@ -10,10 +10,15 @@
 #include "G4UserEventAction.hh"
 #include "globals.hh"
 
+#include <map>
+#include <string>
+#include <vector>
+
 #ifdef ROOT_USE
 #include "TH2.h"
 #include "TFile.h"
 #include "TTree.h"
+#include "TNamed.h"
 #endif // ROOT_USE
 
 #ifdef AIDA_USE
@@ -22,6 +27,13 @@ using namespace AIDA;
 #endif // AIDA_USE
 
 class singCrysEventActionMessenger;
+class singCrysSiliconHitArena;
+class singCrysHitSchema;
+class singCrysTrigger;
+class singCrysHitSampler;
+class singCrysPhotonTally;
+class singCrysDigitizer;
+class singCrysPulseShaper;
 
 /*!
  * \class singCrysEventAction
@@ -39,6 +51,9 @@ class singCrysEventActionMessenger;
  *
  * The ROOT analysis outputs a ROOT file with branches for the event ID (int),
  * as well as momentum (x,y,z), position (x,y,z), and energy, all std::vector.
+ * Which of these branches exist, whether time and track ID branches are
+ * added, and whether they hold double, float, or quantized values, is set by
+ * singCrysHitSchema.
  * The event ID is the ID used by GEANT, starts at 0 and is incremented by one
  * for each event. The energy vector is a vector containing the amount of
  * energy deposited by each hit of a given event. The momentum and position
@@ -50,7 +65,39 @@ class singCrysEventActionMessenger;
  * ROOT analysis. The deposit ID is the index of the hit in the hits
  * collection. The deposit energy is the energy deposited by that hit. The
  * momentum and position vector components correspond to the three-vector
- * components of the hits.
+ * components of the hits. The columns also follow singCrysHitSchema.
+ *
+ * Only events accepted by singCrysTrigger (or kept by its prescale) are
+ * written; by default, all events are.
+ *
+ * With 'outputMode = sampled', the fields of the hits are only written for
+ * the sample chosen by singCrysHitSampler. Every written event then also
+ * has the branches nHits, totalEnergy, sampleWeight, and nHitsAPD (if the
+ * APD is recorded). The AIDA output gets them in a second tuple,
+ * EventTuple, with one row per event.
+ *
+ * With 'digitize' set, singCrysDigitizer turns the hits of every written
+ * event into APD amplitudes, written to the amplitude (and amplitudeSum)
+ * branches. The AIDA output gets them in a third tuple, APDTuple, with one
+ * row per APD and event. With 'digitize = only', the fields of the hits are
+ * not written at all.
+ *
+ * With 'pulseShape', singCrysPulseShaper makes the pulse of each APD, whose
+ * amplitude and constant fraction time are written to the pulseAmplitude and
+ * pulseTime branches, or to the AIDA tuple PulseTuple.
+ *
+ * With 'photonFates', the ROOT output has a photonFates branch with the
+ * number of optical photons of each fate in the event, in the order of
+ * singCrysPhotonTally::Fate. The names are in the tree's user info.
+ *
+ * Output memory is bounded for long runs with ROOT: the tree writes its
+ * baskets every 'rootAutoFlush' MB, and all output is flushed whenever the
+ * resident memory exceeds 'outputMemCeiling' MB. If a flush leaves the
+ * memory above the ceiling, the next one waits until the memory exceeds
+ * what was left after it. The AIDA tree can be
+ * committed every 'aidaCommitEvery' events, so that the file is up to date,
+ * but the AIDA tuples keep all their rows in memory until the end of the
+ * job: a commit rewrites the whole tuple, so the rows cannot be dropped.
  */
 class singCrysEventAction : public G4UserEventAction
 {
@@ -80,41 +127,175 @@ class singCrysEventAction : public G4UserEventAction
      * interface.
      */
     virtual void EndOfEventAction(const G4Event*);
+    //! Writes all output collected so far to the output files
+    /*!
+     * Saves the ROOT tree and/or commits the AIDA tree, so that the files
+     * are readable even if the program is killed afterwards.
+     */
+    void FlushOutput();
+    //! Flushes the output and writes a checkpoint
+    /*!
+     * \sa singCrysCheckpoint
+     */
+    void WriteCheckpoint();
 
   private:
+    //! Returns the resident memory of the process (MB)
+    /*!
+     * \return The resident set size, or 0 if it cannot be determined
+     */
+    static G4double ResidentMemory();
     //! ID of the silicon hits collection
     G4int fSiHCID;
+    //! Fields and precision of the hit output
+    singCrysHitSchema* fSchema;
+    //! Trigger deciding which events are written
+    singCrysTrigger* fTrigger;
+    //! Sampler choosing the hits written in the sampled output mode
+    singCrysHitSampler* fSampler;
+    //! Counts of the optical photon fates
+    singCrysPhotonTally* fPhotonTally;
+    //! Digitizer making the APD amplitudes
+    singCrysDigitizer* fDigitizer;
+    //! Pulse shaper making the APD pulses
+    singCrysPulseShaper* fShaper;
+    //! Counts the hits of an event, per APD, and sums their energy
+    /*!
+     * \param arena Hits of the event, or 0 for none
+     */
+    void SumHits(const singCrysSiliconHitArena* arena);
+    //! Number of hits of the event (sampled output mode)
+    G4int nHitsEvent;
+    //! Total energy of the hits of the event (sampled output mode)
+    G4double totalEnergy;
+    //! Number of hits per APD of the event (sampled output mode)
+    std::vector<G4int> nHitsAPD;
+    //! Number of hits each written hit stands for, 0 if none are written
+    //! (sampled output mode)
+    G4double sampleWeight;
+    //! Number of events processed by this event action
+    G4int nEventsProcessed;
+    //! Number of events between AIDA commits; 0 to commit only at the end
+    G4int aidaCommitEvery;
+    //! Memory (MB) above which the output is flushed; 0 for no limit
+    G4double memCeiling;
+    //! Number of events between two checks of the memory use
+    G4int memCheckEvery;
+    //! Memory (MB) above which the output is flushed next
+    G4double memThreshold;
     //! Verbosity level
     G4int fVerboseLevel;
     
 #ifdef ROOT_USE
+    //! Per-event vectors of hit fields, one per branch
+    /*!
+     * Instantiated with double or float, depending on the precision in the
+     * hit schema. Vectors of fields not in the schema stay empty and have no
+     * branch.
+     */
+    template <typename Real>
+    struct HitVectors
+    {
+      //! Vector to store APD ID quantities
+      std::vector<Real> APDID;
+      //! Vector to store energies of hits
+      std::vector<Real> energy;
+      //! Vector to store global times of hits
+      std::vector<Real> time;
+      //! Vector to store x position of hits
+      std::vector<Real> xPos;
+      //! Vector to store y position of hits
+      std::vector<Real> yPos;
+      //! Vector to store z position of hits
+      std::vector<Real> zPos;
+      //! Vector to store x momentum of hits
+      std::vector<Real> xPVec;
+      //! Vector to store y momentum of hits
+      std::vector<Real> yPVec;
+      //! Vector to store z momentum of hits
+      std::vector<Real> zPVec;
+      //! Vector to store track IDs of hits
+      std::vector<Real> trackID;
+      //! Empties all vectors, keeping their capacity
+      void clear()
+      {
+        APDID.clear(); energy.clear(); time.clear();
+        xPos.clear(); yPos.clear(); zPos.clear();
+        xPVec.clear(); yPVec.clear(); zPVec.clear();
+        trackID.clear();
+      }
+    };
+    //! Creates (or connects) the branches of the fields in the hit schema
+    /*!
+     * \param vecs Vectors holding the data of the branches
+     * \param existing Whether the tree was read from file (when resuming)
+     */
+    template <typename Real>
+    void AddHitBranches(HitVectors<Real>& vecs, G4bool existing);
+    //! Creates a branch for a vector, or connects it to an existing branch
+    /*!
+     * \param name Name of the branch
+     * \param vec Vector holding the data of the branch
+     * \param existing Whether the tree was read from file (when resuming)
+     */
+    template <typename T>
+    void AddBranch(const char* name, std::vector<T>* vec, G4bool existing);
+    //! Copies the fields in the hit schema of the hits to the vectors
+    /*!
+     * \param vecs Vectors to fill
+     * \param arena Arena holding the hits of the event
+     * \param selected Indices of the hits to copy, or 0 for all
+     */
+    template <typename Real>
+    void FillHits(HitVectors<Real>& vecs, const singCrysSiliconHitArena* arena,
+                  const std::vector<size_t>* selected);
+    //! Branch addresses of vector branches in a tree read from file. ROOT
+    //! needs the address of a pointer that lives as long as the tree.
+    std::map<std::string, void*> branchAddresses;
     //! Pointer to the ROOT TFile object
     TFile *myFile;
     //! Pointer to the TTree
     TTree *myTree;
     //! ID number of the event 
     G4int eventID;
-    //! Vector to store APD ID quantities
-    std::vector<double> APDID;
-    //! Vector to store energies of hits
-    std::vector<double> energy;
-    //! Vector to store x position of hits
-    std::vector<double> xPos;
-    //! Vector to store y position of hits
-    std::vector<double> yPos;
-    //! Vector to store z position of hits
-    std::vector<double> zPos;
-    //! Vector to store x momentum of hits
-    std::vector<double> xPVec;
-    //! Vector to store y momentum of hits
-    std::vector<double> yPVec;
-    //! Vector to store z momentum of hits
-    std::vector<double> zPVec;
+    //! Hit vectors used with double precision
+    HitVectors<double> doubleHits;
+    //! Hit vectors used with float and quantized precision
+    HitVectors<float> floatHits;
+    //! Quantized energies of hits, used instead of the energy vector with
+    //! quantized precision
+    std::vector<unsigned short> energyCode;
+    //! Number of optical photons of each fate in the event
+    std::vector<G4int> photonFates;
+    //! Amplitudes of the APDs in the event (electrons)
+    std::vector<double> amplitudes;
+    //! Sum of the amplitudes of the APDs in the event (electrons)
+    double amplitudeSum;
+    //! Amplitudes of the pulses of the APDs in the event
+    std::vector<double> pulseAmplitudes;
+    //! Constant fraction times of the pulses of the APDs in the event (ns)
+    std::vector<double> pulseTimes;
 #endif // ROOT_USE
 
 #ifdef AIDA_USE
+    //! Fills a floating point column with the precision of the hit schema
+    /*!
+     * \param column Index of the column
+     * \param value Value to fill
+     */
+    void FillTupleColumn(G4int column, G4double value);
     //! Tuple used in AIDA analysis
     ITuple* fTuple;
+    //! Tuple with a row per event, in the sampled output mode
+    ITuple* fEventTuple;
+    //! Tuple with a row per APD and event, with the digitizer
+    ITuple* fAPDTuple;
+    //! Tuple with a row per APD and event, with the pulse shaper
+    ITuple* fPulseTuple;
+    //! Tuple column indices of the hit fields, or -1 if not in the schema.
+    //! The y and z components follow the x component.
+    G4int colEvent, colDeposit, colAPD, colEnergy, colTime, colPos, colMom,
+      colTrack;
 #endif // AIDA_USE
 
   public:
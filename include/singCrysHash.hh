@@ -0,0 +1,69 @@
+/*!
+ * \file singCrysHash.hh
+ * \brief Header file for the singCrysHash class. Computes hashes used as keys
+ * of on-disk caches.
+ */
+
+#ifndef singCrysHash_h
+#define singCrysHash_h 1
+
+#include "globals.hh"
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+
+/*!
+ * \class singCrysHash
+ * \brief 64-bit FNV-1a hash, fed with strings and numbers.
+ *
+ * Used to key on-disk caches (e.g. of overlap checks) on all the parameters
+ * that determine their contents. Not a cryptographic hash.
+ */
+
+class singCrysHash
+{
+  public:
+    //! Constructor. Starts from the FNV offset basis.
+    singCrysHash() : hash(14695981039346656037ULL) {}
+    //! Adds raw bytes to the hash
+    /*!
+     * \param data Pointer to the bytes
+     * \param size Number of bytes
+     */
+    void Add(const void* data, size_t size)
+    {
+      const unsigned char* bytes = (const unsigned char*) data;
+      for (size_t i = 0; i < size; i++)
+      {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+      }
+    }
+    //! Adds a string, including its length
+    void Add(const std::string& str)
+    {
+      Add((G4long) str.size());
+      Add(str.data(), str.size());
+    }
+    //! Adds a double
+    void Add(G4double value) {Add(&value, sizeof(value));}
+    //! Adds an integer
+    void Add(G4long value) {Add(&value, sizeof(value));}
+    //! Adds an integer
+    void Add(G4int value) {Add((G4long) value);}
+    //! Current value of the hash
+    uint64_t Value() const {return hash;}
+    //! Current value of the hash as 16 hexadecimal digits
+    std::string Hex() const
+    {
+      char buf[17];
+      std::sprintf(buf, "%016llx", (unsigned long long) hash);
+      return std::string(buf);
+    }
+
+  private:
+    //! Current value of the hash
+    uint64_t hash;
+};
+
+#endif
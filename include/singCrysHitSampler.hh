@@ -0,0 +1,69 @@
+/*!
+ * \file singCrysHitSampler.hh
+ * \brief Header file for the singCrysHitSampler class. Chooses the events
+ * and hits whose details are written in the sampled output mode.
+ */
+
+#ifndef singCrysHitSampler_h
+#define singCrysHitSampler_h 1
+
+#include "globals.hh"
+#include "Randomize.hh"
+#include <vector>
+
+/*!
+ * \class singCrysHitSampler
+ * \brief Samples the hits written with 'outputMode = sampled'.
+ *
+ * In the sampled output mode, singCrysEventAction writes the number of hits,
+ * their total energy, and the number of hits per APD for every event, but
+ * the fields of individual hits only for a sample:
+ * - each event is sampled with probability 'sampleFraction';
+ * - of a sampled event, at most 'samplePhotons' hits are kept, chosen by
+ *   reservoir sampling (0 keeps them all).
+ *
+ * Each event records a weight: the number of hits each kept hit stands for,
+ * (1 / sampleFraction) * (hits / kept hits), or 0 if no hit is kept.
+ *
+ * The sampler has its own random engine, so sampling does not change the
+ * simulated events. It is seeded from 'sampleSeed' and the event number,
+ * so the sample of an event does not depend on the events before it, and
+ * is the same when a job is resumed from a checkpoint.
+ */
+
+class singCrysHitSampler
+{
+  public:
+    //! Constructor
+    /*!
+     * Gets the options from singCrysConfig.
+     */
+    singCrysHitSampler();
+    //! Whether the output mode is 'sampled'
+    G4bool IsSampled() const {return sampled;}
+    //! Chooses the hits of an event to keep
+    /*!
+     * \param eventID Number of the event
+     * \param nHits Number of hits of the event
+     * \return Weight of the kept hits, 0 if none are kept
+     */
+    G4double Sample(G4int eventID, size_t nHits);
+    //! Indices of the hits kept by the last Sample(), in increasing order
+    const std::vector<size_t>& GetSelected() const {return selected;}
+
+  private:
+    //! Whether the output mode is 'sampled'
+    G4bool sampled;
+    //! Probability that an event is sampled
+    G4double fraction;
+    //! Maximum number of hits kept per event (0 for all)
+    G4int maxPhotons;
+    //! Seed of the random engine, combined with the event number
+    long seed;
+    //! Random engine used only for sampling
+    CLHEP::MTwistEngine engine;
+    //! Indices of the kept hits
+    std::vector<size_t> selected;
+};
+
+#endif
@@ -0,0 +1,101 @@
+/*!
+ * \file singCrysHitSchema.hh
+ * \brief Header file for the singCrysHitSchema class. Selects which hit
+ * fields are recorded and with which precision.
+ */
+
+#ifndef singCrysHitSchema_h
+#define singCrysHitSchema_h 1
+
+#include "globals.hh"
+
+/*!
+ * \class singCrysHitSchema
+ * \brief Singleton class describing which fields of a silicon hit are
+ * recorded, and with what precision.
+ *
+ * The fields are chosen with the 'hitFields' configuration option, a comma
+ * separated list of any of: energy, APDID, time, position, momentum,
+ * trackID. The sensitive detector only fills the selected fields, and the
+ * ROOT and AIDA writers only create branches/columns for them.
+ *
+ * The precision is chosen with 'hitPrecision':
+ * - double: all fields are written as double (the original output format).
+ * - float: all fields, including APDID and trackID, are written as float.
+ * - quantized: as float, except that the energy is written as a 16-bit code
+ *   q, with E = quantMinEnergy + q * (quantMaxEnergy - quantMinEnergy) /
+ *   65535. The band 1.3-3.6 eV covers the optical photons; deposits outside
+ *   it are clamped. ROOT stores q as unsigned short. AIDA has no unsigned
+ *   type, so q - 32768 is stored as short.
+ */
+
+class singCrysHitSchema
+{
+  public:
+    //! Fields of a hit that can be recorded
+    enum Field
+    {
+      kEnergy   = 1 << 0,
+      kAPD      = 1 << 1,
+      kTime     = 1 << 2,
+      kPosition = 1 << 3,
+      kMomentum = 1 << 4,
+      kTrackID  = 1 << 5
+    };
+    //! Precision with which the fields are written
+    enum Precision
+    {
+      kDouble,
+      kFloat,
+      kQuantized
+    };
+    //! Returns a pointer to the singleton instance of the class.
+    static singCrysHitSchema* GetInstance();
+    //! Whether a field is recorded
+    /*!
+     * \param field The field to check
+     * \return Whether the field is in the schema
+     */
+    G4bool Has(Field field) const {return (fields & field) != 0;}
+    //! Adds a field to the schema
+    /*!
+     * For stages that need a field regardless of the configured output.
+     * Must be called before the sensitive detector is built (at
+     * /run/initialize), since its hit arena is sized from the schema.
+     * \param field The field to add
+     */
+    void Require(Field field) {fields |= field;}
+    //! Accessor for the precision
+    Precision GetPrecision() const {return precision;}
+    //! Converts an energy to its 16-bit code
+    /*!
+     * \param energy Energy in GEANT4 units
+     * \return Code between 0 and 65535
+     */
+    static unsigned short QuantizeEnergy(G4double energy);
+    //! Converts a 16-bit code back to an energy
+    /*!
+     * \param code Code between 0 and 65535
+     * \return Energy in GEANT4 units
+     */
+    static G4double DequantizeEnergy(unsigned short code);
+    //! Lower edge of the quantized energy band
+    static const G4double quantMinEnergy;
+    //! Upper edge of the quantized energy band
+    static const G4double quantMaxEnergy;
+
+  protected:
+    //! Constructor
+    /*!
+     * Parses 'hitFields' and 'hitPrecision' from singCrysConfig.
+     */
+    singCrysHitSchema();
+    singCrysHitSchema(const singCrysHitSchema&);
+    singCrysHitSchema& operator=(const singCrysHitSchema&);
+    //! Bit mask of the recorded fields
+    G4int fields;
+    //! Precision of the recorded fields
+    Precision precision;
+};
+
+#endif
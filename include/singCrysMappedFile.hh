@@ -0,0 +1,52 @@
+/*!
+ * \file singCrysMappedFile.hh
+ * \brief Header file for the singCrysMappedFile class. Maps a file into
+ * memory.
+ */
+
+#ifndef singCrysMappedFile_h
+#define singCrysMappedFile_h 1
+
+#include "globals.hh"
+#include <cstddef>
+
+/*!
+ * \class singCrysMappedFile
+ * \brief Read-only memory mapping of a whole file
+ *
+ * The file is mapped in the constructor and unmapped in the destructor. The
+ * contents are not null-terminated: they must be read between Begin() and
+ * End(). The class cannot be copied.
+ */
+
+class singCrysMappedFile
+{
+  public:
+    //! Constructor. Maps the file.
+    /*!
+     * \param filename Path of the file
+     */
+    singCrysMappedFile(const G4String& filename);
+    //! Destructor. Unmaps the file.
+    ~singCrysMappedFile();
+    //! Whether the file could be opened and mapped
+    G4bool IsOpen() const {return ok;}
+    //! First byte of the file
+    const char* Begin() const {return data;}
+    //! One past the last byte of the file
+    const char* End() const {return data + size;}
+    //! Size of the file in bytes
+    size_t Size() const {return size;}
+
+  private:
+    singCrysMappedFile(const singCrysMappedFile&);
+    singCrysMappedFile& operator=(const singCrysMappedFile&);
+    //! Start of the mapping (0 for an empty or unmapped file)
+    const char* data;
+    //! Size of the mapping
+    size_t size;
+    //! Whether the file could be opened and mapped
+    G4bool ok;
+};
+
+#endif
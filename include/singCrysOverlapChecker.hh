@@ -0,0 +1,89 @@
+/*!
+ * \file singCrysOverlapChecker.hh
+ * \brief Header file for the singCrysOverlapChecker class. Checks the
+ * geometry for overlapping volumes.
+ */
+
+#ifndef singCrysOverlapChecker_h
+#define singCrysOverlapChecker_h 1
+
+#include "globals.hh"
+#include <string>
+#include <vector>
+
+class G4VPhysicalVolume;
+class G4LogicalVolume;
+
+/*!
+ * \class singCrysOverlapChecker
+ * \brief Checks all placements of a geometry for overlaps, in parallel, and
+ * remembers geometries that passed.
+ *
+ * The placements are split between 'overlapJobs' child processes (GEANT4
+ * 9.6 is not thread-safe, so processes are used rather than threads), each
+ * of which runs G4VPhysicalVolume::CheckOverlaps with 'overlapResolution'
+ * surface points and tolerance 'overlapTolerance' on its share. The output
+ * of the children is collected and printed by the parent.
+ *
+ * Before checking, a hash is computed from everything the result depends
+ * on: the solids (with all their dimensions), the placements, the
+ * resolution, the tolerance, and the GEANT4 version. If the directory
+ * 'overlapCacheDir' already holds a file for that hash, the geometry has
+ * been checked before without overlaps and the check is skipped. Only
+ * geometries without overlaps are recorded.
+ */
+
+class singCrysOverlapChecker
+{
+  public:
+    //! Constructor
+    /*!
+     * Gets the options from singCrysConfig.
+     */
+    singCrysOverlapChecker();
+    //! Checks the geometry below a world volume
+    /*!
+     * \param world The world volume
+     * \return Whether no overlaps were found
+     */
+    G4bool Check(G4VPhysicalVolume* world);
+
+  private:
+    //! Collects the placements in a logical volume and its daughters
+    /*!
+     * Daughters of a logical volume placed several times are only collected
+     * once.
+     * \param logical The logical volume
+     * \param visited Logical volumes already collected
+     */
+    void CollectPlacements(G4LogicalVolume* logical,
+                           std::vector<G4LogicalVolume*>& visited);
+    //! Hash of the geometry and of the check options
+    std::string GeometryHash() const;
+    //! Checks the placements with the given indices (modulo 'nJobs')
+    /*!
+     * \param job Index of the job
+     * \param nJobs Number of jobs
+     * \return Number of placements with overlaps
+     */
+    G4int CheckShare(G4int job, G4int nJobs);
+    //! Checks the placements in child processes
+    /*!
+     * \param nJobs Number of child processes
+     * \return Whether no overlaps were found and all children succeeded
+     */
+    G4bool CheckInChildren(G4int nJobs);
+
+    //! Number of surface points per placement
+    G4int resolution;
+    //! Overlaps smaller than this are ignored
+    G4double tolerance;
+    //! Number of parallel jobs
+    G4int jobs;
+    //! Directory of the cache; empty for no caching
+    std::string cacheDir;
+    //! Placements to check
+    std::vector<G4VPhysicalVolume*> placements;
+};
+
+#endif
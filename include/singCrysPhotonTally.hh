@@ -0,0 +1,92 @@
+/*!
+ * \file singCrysPhotonTally.hh
+ * \brief Header file for the singCrysPhotonTally class. Counts where the
+ * optical photons end up.
+ */
+
+#ifndef singCrysPhotonTally_h
+#define singCrysPhotonTally_h 1
+
+#include "globals.hh"
+#include <string>
+#include <vector>
+
+/*!
+ * \class singCrysPhotonTally
+ * \brief Singleton class counting the fates of the optical photons, per
+ * event and per run.
+ *
+ * Filled by singCrysSteppingAction when 'photonFates' is set. For each fate,
+ * the run counts also sum the number of reflections (bounces) and the path
+ * length of the photons, so that their means can be compared between
+ * wrapping and coating choices. The event counts are written by
+ * singCrysEventAction, and the run counts are printed by singCrysRunAction.
+ *
+ * GEANT4 9.6 tracks the events of a job in a single thread, so there is one
+ * set of counters.
+ */
+
+class singCrysPhotonTally
+{
+  public:
+    //! Where an optical photon ended up
+    enum Fate
+    {
+      kDetected, //!< Detected at the silicon surface (a hit in the epoxy)
+      kCrystal, //!< Absorbed in the bulk of the crystal
+      kWrapping, //!< Absorbed in or on layer 1, layer 2, or the insert
+      kAluminum, //!< Absorbed in or on the aluminum coatings or case
+      kCasing, //!< Absorbed in or on the APD casing
+      kSilicon, //!< Absorbed at the silicon surface without detection
+      kEpoxy, //!< Absorbed in the bulk of the epoxy
+      kEscaped, //!< Left the world volume
+      kOther, //!< Anything else
+      kNFates
+    };
+    //! Returns a pointer to the singleton instance of the class.
+    static singCrysPhotonTally* GetInstance();
+    //! Short name of a fate
+    static const char* GetFateName(Fate fate);
+    //! Whether photon fates are counted ('photonFates')
+    G4bool IsEnabled() const {return enabled;}
+    //! Forgets the counts of the event
+    void BeginEvent();
+    //! Forgets the counts of the run
+    void BeginRun();
+    //! Counts a photon
+    /*!
+     * \param fate Where the photon ended up
+     * \param bounces Number of reflections of the photon
+     * \param length Path length of the photon
+     */
+    void Record(Fate fate, G4int bounces, G4double length);
+    //! Counts of the current event, indexed by Fate
+    const std::vector<G4int>& GetEventCounts() const {return eventCounts;}
+    //! Counts of the current event as "name=count" pairs
+    std::string EventSummary() const;
+    //! One-line summary of the run
+    std::string RunSummary() const;
+    //! Prints a table of the counts of the run
+    void PrintRun() const;
+
+  protected:
+    //! Constructor
+    /*!
+     * Gets 'photonFates' from singCrysConfig.
+     */
+    singCrysPhotonTally();
+    singCrysPhotonTally(const singCrysPhotonTally&);
+    singCrysPhotonTally& operator=(const singCrysPhotonTally&);
+    //! Whether photon fates are counted
+    G4bool enabled;
+    //! Number of photons per fate in the current event
+    std::vector<G4int> eventCounts;
+    //! Number of photons per fate in the current run
+    std::vector<G4long> runCounts;
+    //! Sum of the bounces per fate in the current run
+    std::vector<G4double> runBounces;
+    //! Sum of the path lengths per fate in the current run
+    std::vector<G4double> runLengths;
+};
+
+#endif
@@ -12,6 +12,7 @@
 
 #include "G4VUserPhysicsList.hh"
 #include "globals.hh"
+#include <string>
 
 class G4Cerenkov;
 class G4Scintillation;
@@ -25,7 +26,21 @@ class G4OpBoundaryProcess;
  * \brief Class for defining all physics processes.
  *
  * Defines all particles and physics processes. Different types of processes
- * are defined in different helper functions.
+ * are defined in different helper functions. Which optional processes are
+ * used, and with which parameters, is set by singCrysPhysicsProfile.
+ *
+ * With 'batchScintillation', the scintillation process is a
+ * singCrysScintillation. With 'prismTransport', optical photons also get a
+ * G4FastSimulationManagerProcess, so that singCrysPrismTransport can track
+ * them in the crystal.
+ *
+ * If 'physicsTableCacheDir' is set, the physics tables are stored in a
+ * subdirectory of it after they are first built, and retrieved by later
+ * jobs instead of being built again. The subdirectory is named by a hash of
+ * everything the tables depend on: the GEANT4 version, the physics profile,
+ * the cuts, and the composition of all materials. GEANT4 checks the
+ * retrieved cuts table against the current couples, and builds the tables
+ * if it does not match.
  */
 
 class singCrysPhysicsList: public G4VUserPhysicsList
@@ -38,6 +53,13 @@ class singCrysPhysicsList: public G4VUserPhysicsList
     singCrysPhysicsList();
     //! Destructor
     ~singCrysPhysicsList();
+    //! Stores the physics tables in the cache, if they were not retrieved
+    /*!
+     * Called by singCrysRunManager after the tables are built. Only stores
+     * once per job. The tables are written to a temporary directory, which
+     * is then renamed, so that concurrent jobs do not see partial tables.
+     */
+    void StoreTableCache();
 
   protected:
     //! Constructs all particles
@@ -54,7 +76,9 @@ class singCrysPhysicsList: public G4VUserPhysicsList
     void ConstructProcess();
     //! Set production cut values
     /*!
-     * Sets particle production cuts and prints the cuts.
+     * Sets particle production cuts and prints the cuts. The geometry and
+     * materials exist at this point, so this also looks up the physics
+     * tables in the cache.
      */
     void SetCuts();
     // Helper functions for 'ConstructParticle'
@@ -99,10 +123,20 @@ class singCrysPhysicsList: public G4VUserPhysicsList
      * Adds Cerenkov radiation, scintillation, absorption, Rayleigh
      * scattering, and boundary handling. Also defines some Cerenkov and
      * scintillation parameters, as well as verbosity for optical processes.
+     * Cerenkov radiation and scintillation are left out when the deposit
+     * library is written (see singCrysDepositLibrary).
      */
     void ConstructOp();
+    //! Helper function that enforces the user limits of the regions
+    /*!
+     * Adds G4StepLimiter to all charged particles if a region has a maximum
+     * step, and G4UserSpecialCuts if a region has a minimum kinetic energy.
+     */
+    void ConstructUserLimits();
     //! Sets verbosity of optical processes
     void SetVerbose(G4int verbose);
+    //! Hash of the settings and materials the physics tables depend on
+    std::string TableHash() const;
 
   private:
     // Pointers to the various processes
@@ -117,6 +151,12 @@ class singCrysPhysicsList: public G4VUserPhysicsList
 //    G4OpMieHG*            theMieHGScatteringProcess;
     //! Pointer to the optical boundary process
     G4OpBoundaryProcess*    theBoundaryProcess;
+    //! Directory of the physics table cache; empty for no caching
+    std::string tableCacheDir;
+    //! Directory of the tables of this configuration in the cache
+    std::string tableDir;
+    //! Whether the tables still have to be stored in the cache
+    G4bool storeTables;
 };
 
 #endif
@@ -0,0 +1,114 @@
+/*!
+ * \file singCrysPhysicsProfile.hh
+ * \brief Header file for the singCrysPhysicsProfile class. Selects the
+ * processes and parameters of the physics list.
+ */
+
+#ifndef singCrysPhysicsProfile_h
+#define singCrysPhysicsProfile_h 1
+
+#include "globals.hh"
+
+/*!
+ * \class singCrysPhysicsProfile
+ * \brief Singleton class holding the settings of the selected physics
+ * profile.
+ *
+ * A profile is a set of physics settings, chosen with the 'physicsProfile'
+ * option. The profiles are 'fast', 'standard', and 'reference', and their
+ * settings can be changed in the [profile.<name>] sections at the end of the
+ * configuration file:
+ * - cerenkov: whether Cerenkov light is produced
+ * - cerenkovMaxPhotons: maximum number of Cerenkov photons per step
+ * - cerenkovMaxBetaChange: maximum change of beta per step (%)
+ * - rayleigh: whether optical photons are Rayleigh scattered
+ * - muonHadronEM: whether muons and hadrons have EM processes
+ * - cut: production cut (mm)
+ * - crystalMaxStep: maximum step of charged particles in the crystal (mm, 0
+ *   for no limit)
+ *
+ * 'standard' has Cerenkov light, Rayleigh scattering, EM processes for muons
+ * and hadrons, and a 0.01 mm cut. 'fast' drops what a low-energy gamma
+ * source does not need, and 'reference' uses finer steps and cuts to check
+ * the other two. The active settings are printed by
+ * Print() when the physics list is constructed.
+ *
+ * The geometry is split in regions (see Region), each with the options
+ * 'cut', 'maxStep' and 'minEkin' in the section [region.<name>]. They do not
+ * depend on the profile, but a region cut or maximum step of 0 falls back to
+ * the profile's. The region options are read again whenever they are asked
+ * for, so that a rebuilt geometry uses their current values.
+ */
+
+class singCrysPhysicsProfile
+{
+  public:
+    //! Regions of the geometry with their own cuts and limits
+    enum Region
+    {
+      kCrystalRegion, //!< The crystal
+      kAPDRegion, //!< The APDs (epoxy, silicon, and casing)
+      kPassiveRegion, //!< Layers, insert, coatings, and aluminum case
+      kNRegions
+    };
+    //! Returns a pointer to the singleton instance of the class.
+    static singCrysPhysicsProfile* GetInstance();
+    //! Name of a region, as in its configuration section
+    static G4String GetRegionName(Region region);
+    //! Prints the name and settings of the profile
+    void Print() const;
+    //! Name of the profile
+    G4String GetName() const {return name;}
+    //! Whether Cerenkov light is produced
+    G4bool UseCerenkov() const {return cerenkov;}
+    //! Maximum number of Cerenkov photons per step
+    G4int GetCerenkovMaxPhotons() const {return cerenkovMaxPhotons;}
+    //! Maximum change of beta per step for Cerenkov light (%)
+    G4double GetCerenkovMaxBetaChange() const {return cerenkovMaxBetaChange;}
+    //! Whether optical photons are Rayleigh scattered
+    G4bool UseRayleigh() const {return rayleigh;}
+    //! Whether muons and hadrons have EM processes
+    G4bool UseMuonHadronEM() const {return muonHadronEM;}
+    //! Production cut
+    G4double GetCut() const {return cut;}
+    //! Maximum step of charged particles in the crystal (0 for no limit)
+    G4double GetCrystalMaxStep() const {return crystalMaxStep;}
+    //! Production cut of a region (the profile's if 'cut' is 0)
+    G4double GetRegionCut(Region region) const;
+    //! Maximum step of charged particles in a region (0 for no limit)
+    /*!
+     * In the crystal, the profile's maximum step is used if 'maxStep' is 0.
+     */
+    G4double GetRegionMaxStep(Region region) const;
+    //! Kinetic energy below which charged particles are killed in a region
+    //! (0 for never)
+    G4double GetRegionMinEkin(Region region) const;
+
+  protected:
+    //! Constructor
+    /*!
+     * Gets 'physicsProfile' and the settings of that profile from
+     * singCrysConfig.
+     */
+    singCrysPhysicsProfile();
+    singCrysPhysicsProfile(const singCrysPhysicsProfile&);
+    singCrysPhysicsProfile& operator=(const singCrysPhysicsProfile&);
+    //! Name of the profile
+    G4String name;
+    //! Whether Cerenkov light is produced
+    G4bool cerenkov;
+    //! Maximum number of Cerenkov photons per step
+    G4int cerenkovMaxPhotons;
+    //! Maximum change of beta per step for Cerenkov light (%)
+    G4double cerenkovMaxBetaChange;
+    //! Whether optical photons are Rayleigh scattered
+    G4bool rayleigh;
+    //! Whether muons and hadrons have EM processes
+    G4bool muonHadronEM;
+    //! Production cut
+    G4double cut;
+    //! Maximum step of charged particles in the crystal (0 for no limit)
+    G4double crystalMaxStep;
+};
+
+#endif
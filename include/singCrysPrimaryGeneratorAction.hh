@@ -55,6 +55,11 @@ class singCrysPrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
      *\param newPos The G4ThreeVector of the new position
      */
     void setGunPos(G4ThreeVector newPos);
+    //! Function that returns the three-vector position of the particle gun
+    /*!
+     * \return The current position of the particle gun
+     */
+    G4ThreeVector getGunPos() const {return gunPos;}
 
   private:
     //! Particle gun used to 'shoot' particles to generate an event
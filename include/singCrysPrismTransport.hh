@@ -0,0 +1,166 @@
+/*!
+ * \file singCrysPrismTransport.hh
+ * \brief Header file for the singCrysPrismTransport class. Tracks optical
+ * photons through the crystal analytically.
+ */
+
+#ifndef singCrysPrismTransport_h
+#define singCrysPrismTransport_h 1
+
+#include "G4VFastSimulationModel.hh"
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+#include <vector>
+
+class G4Material;
+class G4OpticalSurface;
+class G4LogicalVolume;
+
+/*!
+ * \class singCrysPrismTransport
+ * \brief Fast simulation model transporting optical photons inside the
+ * crystal, used when 'prismTransport' is set.
+ *
+ * The crystal is a convex prism, so the next face of a photon is the
+ * nearest of N + 2 planes along its direction. The model follows the photon
+ * from face to face, with bulk absorption and Rayleigh scattering sampled
+ * from the ABSLENGTH and RAYLEIGH properties of the crystal, and decides at
+ * each face between reflection and refraction as G4OpBoundaryProcess does
+ * for a dielectric_dielectric surface of the unified model (polished, or
+ * ground with facet normals of spread sigma alpha).
+ *
+ * A photon is handed back to GEANT4:
+ * - when it reaches the APD end (-z face), just inside the crystal, so that
+ *   GEANT4 handles the coating, epoxy, and APD;
+ * - when it is refracted out of a side face or the +z face, just outside
+ *   the crystal, in layer 1 or its insert;
+ * - when it reaches a face whose surface the model does not handle (e.g. a
+ *   metal layer 1, or a surface with a REFLECTIVITY or a TRANSMITTANCE),
+ *   just inside the crystal, so that GEANT4 handles that face.
+ * Photons are never absorbed at a face by the model, so those absorbed at
+ * the surfaces of the crystal are counted by singCrysPhotonTally as with
+ * full tracking.
+ * The model is not triggered again until the photon has left the face it
+ * was handed back at.
+ *
+ * Transport() can also be called directly, e.g. by singCrysScintillation
+ * for photons that are never made into tracks.
+ *
+ * The model only applies to prisms. It is not used when the crystal is
+ * built as a cylinder ('tubsMinSides'). Reflections inside the model are
+ * not seen by the stepping action, so singCrysPhotonTally does not count
+ * them as bounces.
+ */
+
+class singCrysPrismTransport : public G4VFastSimulationModel
+{
+  public:
+    //! Constructor
+    /*!
+     * \param name Name of the model
+     * \param envelope Region of the crystal
+     * \param nSides Number of sides of the crystal
+     * \param apothem Distance from the axis to the side faces
+     * \param halfZ Half length of the crystal
+     * \param crystal Material of the crystal
+     * \param layer1 Material of layer 1, beyond the sides and the +z face
+     * \param insert Material of the insert, beyond the +y face
+     * \param layer1Surface Surface between the crystal and layer 1
+     * \param insertSurface Surface between the crystal and the insert
+     */
+    singCrysPrismTransport(const G4String& name, G4Envelope* envelope,
+                           G4int nSides, G4double apothem, G4double halfZ,
+                           G4Material* crystal, G4Material* layer1,
+                           G4Material* insert, G4OpticalSurface* layer1Surface,
+                           G4OpticalSurface* insertSurface);
+    //! Destructor
+    virtual ~singCrysPrismTransport();
+    //! Applies to optical photons only
+    virtual G4bool IsApplicable(const G4ParticleDefinition& particle);
+    //! Triggers, unless the photon was just handed back at a face
+    virtual G4bool ModelTrigger(const G4FastTrack& fastTrack);
+    //! Transports the photon until it is absorbed or handed back
+    virtual void DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep);
+    //! State of an optical photon, in the frame of the crystal
+    struct Photon
+    {
+      G4ThreeVector position;
+      G4ThreeVector momentum;
+      G4ThreeVector polarization;
+      G4double energy;
+      //! Global time
+      G4double time;
+      //! Path length in the model
+      G4double length;
+    };
+    //! What happened to a photon
+    enum Outcome
+    {
+      kBulkAbsorbed, //!< Absorbed in the crystal
+      kHandedBack //!< To be tracked by GEANT4 from its final state
+    };
+    //! Transports a photon from inside the crystal
+    /*!
+     * \param photon The photon, updated to its final state
+     * \return What happened to the photon
+     */
+    Outcome Transport(Photon& photon) const;
+    //! Whether a volume is in the region of the model
+    G4bool Covers(const G4LogicalVolume* volume) const;
+
+  private:
+    //! A face of the prism
+    struct Face
+    {
+      //! Outward normal, in the frame of the crystal
+      G4ThreeVector normal;
+      //! Distance of the plane from the center of the crystal
+      G4double distance;
+      //! Material beyond the face, 0 for the APD end
+      G4Material* outside;
+      //! Surface of the face, 0 for the APD end
+      G4OpticalSurface* surface;
+    };
+    //! Whether the model handles a face, and the refractive index beyond it
+    /*!
+     * \param face The face
+     * \param energy Energy of the photon
+     * \param rindex2 Refractive index beyond the face
+     */
+    G4bool IsAnalytic(const Face& face, G4double energy,
+                      G4double& rindex2) const;
+    //! Reflects or refracts a photon at a dielectric_dielectric surface
+    /*!
+     * \param face The face
+     * \param rindex1 Refractive index of the crystal
+     * \param rindex2 Refractive index beyond the face
+     * \param energy Energy of the photon
+     * \param momentum Direction of the photon, updated
+     * \param polarization Polarization of the photon, updated
+     * \return Whether the photon is refracted out of the crystal
+     */
+    G4bool DielectricDielectric(const Face& face, G4double rindex1,
+                                G4double rindex2, G4double energy,
+                                G4ThreeVector& momentum,
+                                G4ThreeVector& polarization) const;
+    //! Samples a facet normal of the unified model
+    G4ThreeVector FacetNormal(const G4ThreeVector& momentum,
+                              const G4ThreeVector& normal,
+                              G4double sigmaAlpha) const;
+    //! Scatters the photon as G4OpRayleigh does
+    void RayleighScatter(G4ThreeVector& momentum,
+                         G4ThreeVector& polarization) const;
+
+    //! Region of the crystal
+    G4Envelope* envelope;
+    //! Faces of the prism: the sides, starting with +y, then +z and -z
+    std::vector<Face> faces;
+    //! Material of the crystal
+    G4Material* crystal;
+    //! Whether Rayleigh scattering is simulated
+    G4bool rayleigh;
+    //! Maximum number of interactions of a photon in the model
+    G4int maxInteractions;
+};
+
+#endif
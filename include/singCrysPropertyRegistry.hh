@@ -0,0 +1,109 @@
+/*!
+ * \file singCrysPropertyRegistry.hh
+ * \brief Header file for the singCrysPropertyRegistry class. Parses the
+ * optical data files once and caches them.
+ */
+
+#ifndef singCrysPropertyRegistry_h
+#define singCrysPropertyRegistry_h 1
+
+#include "globals.hh"
+#include <map>
+#include <string>
+#include <vector>
+
+/*!
+ * \struct singCrysPropertyData
+ * \brief Contents of a data file: energies (increasing) and values, in
+ * GEANT4 units.
+ */
+
+struct singCrysPropertyData
+{
+  //! Energies of the entries
+  std::vector<G4double> energies;
+  //! Values of the entries
+  std::vector<G4double> values;
+};
+
+/*!
+ * \class singCrysPropertyRegistry
+ * \brief Singleton class holding the parsed contents of the data files
+ *
+ * Every data file is parsed at most once per content: the file is mapped
+ * into memory (singCrysMappedFile) and hashed, and the hash is looked up
+ * first in memory, then in the binary cache in the directory
+ * 'propertyCacheDir'. Only if both miss is the text parsed, validated, and
+ * written to the cache. Editing a file changes its hash, so stale data are
+ * never used.
+ *
+ * The files are read line by line. Anything after a '#' is a comment, and
+ * fields are separated by whitespace, commas, or semicolons. If the first
+ * line with data holds a single number, it is the number of entries (as in
+ * the original format described in singCrysReadFile), and the number of
+ * entries read must match it. Every other line is an entry; by default the
+ * first column is the wavelength in nm and the second the value, but other
+ * columns can be selected with a ":x,y" suffix on the file name (e.g.
+ * "spectrum.csv:1,3").
+ *
+ * When a file is parsed, it is checked that the wavelengths are positive
+ * and strictly monotonic, and that the values are not negative. Files with
+ * increasing wavelengths are reversed, since GEANT4 needs increasing
+ * energies. Wavelengths outside 100-2000 nm give a warning, as they
+ * probably are not in nm. Errors are fatal G4Exceptions that give the line.
+ */
+
+class singCrysPropertyRegistry
+{
+  public:
+    //! Returns a pointer to the singleton instance of the class.
+    static singCrysPropertyRegistry* GetInstance();
+    //! Gets the contents of a data file
+    /*!
+     * Raises a fatal G4Exception if the file cannot be read or is invalid.
+     * \param filename Path of the file, optionally followed by ":x,y" to
+     * select the columns of the wavelengths and values (from 1)
+     * \return The contents. They stay valid for the whole job.
+     */
+    const singCrysPropertyData* Get(const G4String& filename);
+
+  protected:
+    //! Constructor
+    /*!
+     * Gets 'propertyCacheDir' from singCrysConfig.
+     */
+    singCrysPropertyRegistry();
+    singCrysPropertyRegistry(const singCrysPropertyRegistry&);
+    singCrysPropertyRegistry& operator=(const singCrysPropertyRegistry&);
+    //! Parses and validates the text of a data file
+    /*!
+     * \param filename Path of the file, for messages
+     * \param begin First byte of the file
+     * \param end One past the last byte of the file
+     * \param xCol Column of the wavelengths (from 1)
+     * \param yCol Column of the values (from 1)
+     * \param data Filled with the parsed contents
+     */
+    void Parse(const G4String& filename, const char* begin, const char* end,
+               G4int xCol, G4int yCol, singCrysPropertyData& data);
+    //! Reads contents from the binary cache
+    /*!
+     * \param cacheFile Path of the cache file
+     * \param data Filled with the cached contents
+     * \return Whether the cache file exists and is complete
+     */
+    G4bool ReadCache(const std::string& cacheFile, singCrysPropertyData& data);
+    //! Writes contents to the binary cache
+    /*!
+     * \param cacheFile Path of the cache file
+     * \param data The contents
+     */
+    void WriteCache(const std::string& cacheFile,
+                    const singCrysPropertyData& data);
+    //! Directory of the binary cache; empty for no cache
+    std::string cacheDir;
+    //! Parsed contents, by hash of the file contents
+    std::map<std::string, singCrysPropertyData> entries;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*!
+ * \file singCrysPulseShaper.hh
+ * \brief Header file for the singCrysPulseShaper class. Makes the pulse of
+ * each APD from the arrival times of its hits.
+ */
+
+#ifndef singCrysPulseShaper_h
+#define singCrysPulseShaper_h 1
+
+#include "globals.hh"
+#include <vector>
+
+class singCrysSiliconHitArena;
+
+/*!
+ * \class singCrysPulseShaper
+ * \brief Synthesizes the shaped pulse of each APD, and extracts its
+ * amplitude and constant fraction time.
+ *
+ * With 'pulseShape' set, the arrival (global) times of the hits of each APD
+ * are histogrammed in bins of 'pulseBinWidth' ns, from the start of the
+ * event to 'pulseWindow' ns, and convolved with a CR-RC^n shaping kernel of
+ * order n = 'pulseShapingOrder' and time constant 'pulseShapingTime' ns:
+ *
+ * h(t) = (t / (n tau))^n exp(n - t / tau),
+ *
+ * which peaks at 1 at t = n tau (n = 0 is a single exponential decay). The
+ * amplitude is the maximum of the pulse, in units of the peak of a single
+ * photoelectron. The time is where the leading edge crosses 'cfdFraction'
+ * of the amplitude, interpolated between bins, or -1 if there is no pulse.
+ *
+ * The time and APD of each hit are recorded when shaping (see
+ * singCrysHitSchema). With 'digitize = only', the hits themselves are not
+ * written, so that timing studies only store a few numbers per event.
+ */
+
+class singCrysPulseShaper
+{
+  public:
+    //! Constructor
+    /*!
+     * Gets the options from singCrysConfig and samples the kernel. When
+     * shaping, adds the APD and the time to the hit schema.
+     */
+    singCrysPulseShaper();
+    //! Whether the pulses are shaped ('pulseShape')
+    G4bool IsEnabled() const {return enabled;}
+    //! Makes the pulses of an event
+    /*!
+     * \param arena Hits of the event, or 0 for none
+     */
+    void Shape(const singCrysSiliconHitArena* arena);
+    //! Amplitudes of the last event, per APD (photoelectron peaks)
+    const std::vector<G4double>& GetAmplitudes() const {return amplitudes;}
+    //! Constant fraction times of the last event, per APD (ns)
+    const std::vector<G4double>& GetTimes() const {return times;}
+
+  private:
+    //! Convolves the histogram of an APD with the kernel into 'pulse'
+    /*!
+     * \param counts Histogram of the arrival times
+     * \param first First nonzero bin
+     * \param last Last nonzero bin
+     */
+    void Convolve(const G4double* counts, G4int first, G4int last);
+    //! Finds the amplitude and constant fraction time of 'pulse'
+    /*!
+     * \param first First bin of the pulse
+     * \param amplitude Amplitude of the pulse
+     * \param time Constant fraction time of the pulse (ns)
+     */
+    void Analyze(G4int first, G4double& amplitude, G4double& time) const;
+
+    //! Whether the pulses are shaped
+    G4bool enabled;
+    //! Width of the bins
+    G4double binWidth;
+    //! Number of bins of the window
+    G4int nBins;
+    //! Fraction of the amplitude at which the time is taken
+    G4double cfdFraction;
+    //! Shaping kernel, sampled at the bin centers
+    std::vector<G4double> kernel;
+    //! Histograms of the arrival times, nBins per APD
+    std::vector<G4double> counts;
+    //! Shaped pulse of the APD being analyzed
+    std::vector<G4double> pulse;
+    //! First and last filled bins of each APD
+    std::vector<G4int> firstBin, lastBin;
+    //! Amplitudes of the last event
+    std::vector<G4double> amplitudes;
+    //! Constant fraction times of the last event
+    std::vector<G4double> times;
+};
+
+#endif
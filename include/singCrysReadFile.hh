@@ -8,6 +8,8 @@
 
 #include "globals.hh"
 
+struct singCrysPropertyData;
+
 /*!
  * \class singCrysReadFile
  * \brief Reads in data files
@@ -20,6 +22,11 @@
  * that wavelength. The class contains arrays of the energies (converted
  * from the wavelengths), the values (in standard GEANT4 units), and the number
  * of entries.
+ *
+ * The arrays belong to singCrysPropertyRegistry, which parses each file only
+ * once, so reading the same file again is cheap. The registry also accepts
+ * comments, files without the number of entries, and files with more
+ * columns (see singCrysPropertyRegistry).
  */
 
 class singCrysReadFile
@@ -36,11 +43,6 @@ class singCrysReadFile
      * \param filename File to be read
      */
     singCrysReadFile(const G4String filename);
-    //! Destructor
-    /*!
-     * Deletes dynamically allocated arrays of energies and values.
-     */
-    ~singCrysReadFile();
     //! Accessor for number of entries in the file
     /*!
      * \return Number of entries
@@ -48,7 +50,7 @@ class singCrysReadFile
     G4int GetNEntries() {return nEntries;}
     //! Accessor for the energies of the entries
     /*!
-     * \return Array of energies
+     * \return Array of energies, in increasing order
      */
     G4double* GetEnergies() {return energies;}
     //! Accessor for the values of the entries
@@ -0,0 +1,96 @@
+/*!
+ * \file singCrysRunAction.hh
+ * \brief Header file for the singCrysRun and singCrysRunAction classes.
+ * Summarize the hits of each run.
+ */
+
+#ifndef singCrysRunAction_h
+#define singCrysRunAction_h 1
+
+#include "G4Run.hh"
+#include "G4UserRunAction.hh"
+#include "globals.hh"
+#include <ctime>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+/*!
+ * \class singCrysRun
+ * \brief Run that accumulates the number of hits of its events.
+ */
+
+class singCrysRun : public G4Run
+{
+  public:
+    //! Constructor
+    /*!
+     * \param HCID ID of the silicon hits collection
+     */
+    singCrysRun(G4int HCID);
+    //! Adds the hits of an event to the sums
+    virtual void RecordEvent(const G4Event* evt);
+    //! Number of events with at least one hit
+    G4int GetEventsWithHits() const {return nEventsWithHits;}
+    //! Total number of hits
+    G4double GetSumHits() const {return sumHits;}
+    //! Sum of the squares of the number of hits per event
+    G4double GetSumHits2() const {return sumHits2;}
+
+  private:
+    //! ID of the silicon hits collection
+    G4int fSiHCID;
+    //! Number of events with at least one hit
+    G4int nEventsWithHits;
+    //! Total number of hits
+    G4double sumHits;
+    //! Sum of the squares of the number of hits per event
+    G4double sumHits2;
+};
+
+/*!
+ * \class singCrysRunAction
+ * \brief User-defined optional run action class. Makes a summary of each
+ * run.
+ *
+ * At the end of each run, a one-line summary is printed and kept until it
+ * is taken with TakeSummaries(): the number of events, the mean number of
+ * hits per event with its standard error and RMS, the fraction of events
+ * with hits, and the CPU and wall clock time of the run, followed by the
+ * fractions of the photon fates with 'photonFates'. singCrysServer sends
+ * these summaries to its clients. The table of photon fates, with the mean
+ * bounces and path length, is only printed.
+ */
+
+class singCrysRunAction : public G4UserRunAction
+{
+  public:
+    //! Constructor
+    /*!
+     * Gets the ID of the silicon hits collection.
+     */
+    singCrysRunAction();
+    //! Destructor
+    virtual ~singCrysRunAction();
+    //! Makes a singCrysRun
+    virtual G4Run* GenerateRun();
+    //! Starts the timers
+    virtual void BeginOfRunAction(const G4Run* run);
+    //! Prints and keeps the summary of the run
+    virtual void EndOfRunAction(const G4Run* run);
+    //! Returns the summaries of the runs since the last call, and forgets
+    //! them
+    std::vector<std::string> TakeSummaries();
+
+  private:
+    //! ID of the silicon hits collection
+    G4int fSiHCID;
+    //! CPU time at the start of the run
+    std::clock_t cpuStart;
+    //! Wall clock time at the start of the run
+    struct timeval wallStart;
+    //! Summaries not taken yet
+    std::vector<std::string> summaries;
+};
+
+#endif
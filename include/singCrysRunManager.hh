@@ -0,0 +1,46 @@
+/*!
+ * \file singCrysRunManager.hh
+ * \brief Header file for the singCrysRunManager class. Run manager that
+ * supports checkpointing and resuming.
+ */
+
+#ifndef singCrysRunManager_h
+#define singCrysRunManager_h 1
+
+#include "G4RunManager.hh"
+
+/*!
+ * \class singCrysRunManager
+ * \brief Run manager that skips or shortens runs when resuming from a
+ * checkpoint.
+ *
+ * Every /run/beamOn goes through singCrysRunManager::BeamOn. Runs that were
+ * completed before a checkpoint are skipped, and the interrupted run only
+ * processes the remaining events. After a SIGINT or SIGTERM, all further
+ * runs are skipped. A checkpoint is written at the end of each run.
+ *
+ * Once the physics tables are built for the first run, they are stored in
+ * the cache of singCrysPhysicsList.
+ * \sa singCrysCheckpoint
+ */
+
+class singCrysRunManager : public G4RunManager
+{
+  public:
+    //! Constructor
+    singCrysRunManager();
+    //! Destructor
+    virtual ~singCrysRunManager();
+    //! Starts a run, taking into account the checkpoint state
+    /*!
+     * \param n_event Number of events requested
+     * \param macroFile Macro to be executed for the first n_select events
+     * \param n_select Number of events for which macroFile is executed
+     */
+    virtual void BeamOn(G4int n_event, const char* macroFile = 0,
+                        G4int n_select = -1);
+    //! Prepares a run, and stores the physics tables in the cache
+    virtual void RunInitialization();
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*!
+ * \file singCrysScintillation.hh
+ * \brief Header file for the singCrysScintillation class. Makes the
+ * scintillation photons of a step in batches.
+ */
+
+#ifndef singCrysScintillation_h
+#define singCrysScintillation_h 1
+
+#include "G4Scintillation.hh"
+#include "globals.hh"
+#include <vector>
+
+class G4Material;
+class G4MaterialPropertyVector;
+
+/*!
+ * \class singCrysScintillation
+ * \brief Scintillation process sampling all the photons of a step at once,
+ * used instead of G4Scintillation when 'batchScintillation' is set.
+ *
+ * The number of photons, their split between the fast and slow components,
+ * and their distributions are those of G4Scintillation. The photons of a
+ * step are sampled as a structure of arrays: all the uniform random numbers
+ * are drawn with one call to the engine, and each quantity (energy,
+ * direction, polarization, position, time) is computed in its own loop over
+ * the photons. The energies are drawn from inverse cumulative distributions
+ * of the FASTCOMPONENT and SLOWCOMPONENT spectra (e.g. LYSO_FastScint.dat),
+ * tabulated on 'scintCDFBins' uniform bins, so a photon costs a table lookup
+ * instead of a search.
+ *
+ * When singCrysPrismTransport is used ('prismTransport'), the photons made
+ * in the crystal are transported by it directly. Photons absorbed in the
+ * crystal are never made into tracks; only those it hands back are pushed
+ * onto the stack. Otherwise, every photon becomes a track, as with
+ * G4Scintillation.
+ *
+ * Scintillation by particle type is not supported.
+ */
+
+class singCrysScintillation : public G4Scintillation
+{
+  public:
+    //! Constructor
+    /*!
+     * Gets 'scintCDFBins' from singCrysConfig.
+     */
+    singCrysScintillation(const G4String& processName = "Scintillation");
+    //! Destructor
+    virtual ~singCrysScintillation();
+    //! Builds the tables of G4Scintillation, and forgets the inverse
+    //! cumulative distributions, which are remade when first used
+    virtual void BuildPhysicsTable(const G4ParticleDefinition& particle);
+    //! Makes the scintillation photons of a step
+    virtual G4VParticleChange* PostStepDoIt(const G4Track& aTrack,
+                                            const G4Step& aStep);
+    //! Makes the scintillation photons of a particle at rest
+    virtual G4VParticleChange* AtRestDoIt(const G4Track& aTrack,
+                                          const G4Step& aStep);
+
+  private:
+    //! Photons of a step, as a structure of arrays
+    struct Batch
+    {
+      std::vector<G4double> energy;
+      std::vector<G4double> time;
+      std::vector<G4double> x, y, z;
+      std::vector<G4double> px, py, pz;
+      std::vector<G4double> sx, sy, sz;
+      //! Path length already travelled in singCrysPrismTransport
+      std::vector<G4double> length;
+      //! Whether the photon is made into a track
+      std::vector<char> alive;
+      //! Resizes all the arrays
+      void Resize(size_t n);
+    };
+    //! Inverse cumulative distribution of a spectrum of a material
+    /*!
+     * \param material The material
+     * \param spectrum Its FASTCOMPONENT or SLOWCOMPONENT, with at least two
+     * points
+     * \param fast Whether it is the fast component
+     * \return Photon energies at 'nBins' + 1 equally spaced probabilities
+     */
+    const std::vector<G4double>& InverseCDF(const G4Material* material,
+                                            G4MaterialPropertyVector* spectrum,
+                                            G4bool fast);
+    //! Samples photons of one component into the batch
+    /*!
+     * \param aTrack The track making the photons
+     * \param aStep Its step
+     * \param cdf Inverse cumulative distribution of the spectrum
+     * \param decayTime Decay time of the component
+     * \param riseTime Rise time of the component (0 for none)
+     * \param begin First photon of the batch to fill
+     * \param end One past the last photon to fill
+     */
+    void Sample(const G4Track& aTrack, const G4Step& aStep,
+                const std::vector<G4double>& cdf, G4double decayTime,
+                G4double riseTime, size_t begin, size_t end);
+    //! Emission time with a rise and a decay, as G4Scintillation samples it
+    G4double RiseDecayTime(G4double riseTime, G4double decayTime) const;
+
+    //! Number of bins of the inverse cumulative distributions
+    G4int nBins;
+    //! Inverse cumulative distributions of the fast spectra, by material
+    //! index (empty until used)
+    std::vector<std::vector<G4double> > fastCDFs;
+    //! Inverse cumulative distributions of the slow spectra
+    std::vector<std::vector<G4double> > slowCDFs;
+    //! Uniform random numbers of a component
+    std::vector<G4double> uniforms;
+    //! Photons of the current step
+    Batch batch;
+};
+
+#endif
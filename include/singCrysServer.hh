@@ -0,0 +1,82 @@
+/*!
+ * \file singCrysServer.hh
+ * \brief Header file for the singCrysServer class. Runs UI commands
+ * received over a Unix domain socket.
+ */
+
+#ifndef singCrysServer_h
+#define singCrysServer_h 1
+
+#include "globals.hh"
+#include <string>
+
+class singCrysRunAction;
+
+/*!
+ * \class singCrysServer
+ * \brief Keeps an initialized simulation running, and executes the commands
+ * of clients connecting to a Unix domain socket.
+ *
+ * Started with 'singleCrystal --serve <socket>'. Clients connect one at a
+ * time, e.g. with 'socat - UNIX-CONNECT:<socket>', and send UI commands, one
+ * per line, as in a macro. Empty lines and lines starting with '#' are
+ * ignored. The reply to each command is the summary of every run it made
+ * (lines starting with "summary "), followed by "ok" or by "error <code>",
+ * where the code is that of G4UImanager::ApplyCommand. Parameters are
+ * changed with the usual messenger commands, e.g. /singCrys/geom/set and
+ * /singCrys/geom/rebuild, and persist for later clients.
+ *
+ * "exit" closes the connection, and "shutdown" stops the server. The server
+ * also stops on SIGINT or SIGTERM.
+ */
+
+class singCrysServer
+{
+  public:
+    //! Constructor
+    /*!
+     * \param path Path of the socket. An existing file there is replaced.
+     * \param runAction Run action making the run summaries
+     */
+    singCrysServer(const std::string& path, singCrysRunAction* runAction);
+    //! Destructor. Removes the socket.
+    ~singCrysServer();
+    //! Accepts clients until shut down
+    /*!
+     * \return Whether the socket could be opened
+     */
+    G4bool Serve();
+
+  private:
+    //! Executes the commands of a client until it disconnects
+    /*!
+     * \param fd File descriptor of the connection
+     * \return Whether the client asked to shut down the server
+     */
+    G4bool HandleClient(int fd);
+    //! Executes one command and sends the reply
+    /*!
+     * \param fd File descriptor of the connection
+     * \param command The command
+     */
+    void Execute(int fd, const std::string& command);
+    //! Writes a whole string to a connection
+    /*!
+     * \return Whether everything was written
+     */
+    static G4bool WriteAll(int fd, const std::string& str);
+    //! Waits until a file descriptor is readable or a stop is requested
+    /*!
+     * \return Whether the file descriptor is readable
+     */
+    static G4bool WaitReadable(int fd);
+
+    //! Path of the socket
+    std::string socketPath;
+    //! Run action making the run summaries
+    singCrysRunAction* runAction;
+    //! Listening socket, or -1
+    int listenFd;
+};
+
+#endif
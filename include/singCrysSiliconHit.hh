@@ -13,8 +13,6 @@
 #define singCrysSiliconHit_h 1
 
 #include "G4VHit.hh"
-#include "G4THitsCollection.hh"
-#include "G4Allocator.hh"
 #include "G4ThreeVector.hh"
 
 /*!
@@ -24,8 +22,13 @@
  *
  * User-defined hit class. Instances of this class are generated when a hit
  * is recorded in the sensitive detector. They contain information about energy,
- * which APD the hit was recorded on, the position and momentum of the hit, and
- * the track ID.
+ * which APD the hit was recorded on, the time, the position and momentum of the
+ * hit, and the track ID. Only the fields selected by singCrysHitSchema are
+ * filled; the others keep their default values.
+ *
+ * The hits of an event are stored column by column in a
+ * singCrysSiliconHitArena rather than as individual objects; this class is
+ * the value type used to look at one hit at a time.
  */
 
 class singCrysSiliconHit : public G4VHit
@@ -56,11 +59,6 @@ class singCrysSiliconHit : public G4VHit
      */
     G4int operator==(const singCrysSiliconHit& right) const;
 
-    //! Overload of new operator
-    inline void* operator new(size_t);
-    //! Overload of delete operator
-    inline void operator delete(void*);
-
     // methods from base class
     //! Draws hits in visualization
     virtual void Draw();
@@ -87,6 +85,11 @@ class singCrysSiliconHit : public G4VHit
      * \param de Energy deposited
      */
     void SetEdep(G4double de)     {fEdep = de;};
+    //! Mutator method for the global time of the hit
+    /*!
+     * \param t Time since the start of the event
+     */
+    void SetTime(G4double t)      {fTime = t;};
     //! Mutator method for the position of the hit
     /*!
      * \param xyz Position
@@ -114,6 +117,11 @@ class singCrysSiliconHit : public G4VHit
      * \return Deposited energy
      */
     G4double GetEdep() const    {return fEdep;};
+    //! Accessor method for the global time of the hit
+    /*!
+     * \return Time since the start of the event
+     */
+    G4double GetTime() const    {return fTime;};
     //! Accessor method for the position of the hit
     /*!
      * \return Position
@@ -132,26 +140,12 @@ class singCrysSiliconHit : public G4VHit
     G4int fAPDNb;
     //! Energy deposited in the hit
     G4double fEdep;
+    //! Global time of the hit
+    G4double fTime;
     //! Position of the hit
     G4ThreeVector fPos;
     //! Momentum of the hit
     G4ThreeVector fPVec;
 };
 
-typedef G4THitsCollection<singCrysSiliconHit> singCrysSiliconHitsCollection;
-
-extern G4Allocator<singCrysSiliconHit> singCrysSiliconHitAllocator;
-
-inline void* singCrysSiliconHit::operator new(size_t)
-{
-  void *hit;
-  hit = (void *) singCrysSiliconHitAllocator.MallocSingle();
-  return hit;
-}
-
-inline void singCrysSiliconHit::operator delete(void *hit)
-{
-  singCrysSiliconHitAllocator.FreeSingle((singCrysSiliconHit*) hit);
-}
-
 #endif
@@ -0,0 +1,216 @@
+/*!
+ * \file singCrysSiliconHitsCollection.hh
+ * \brief Header file for the singCrysSiliconHitArena and
+ * singCrysSiliconHitsCollection classes. Stores the silicon hits of an event
+ * column by column.
+ */
+
+#ifndef singCrysSiliconHitsCollection_h
+#define singCrysSiliconHitsCollection_h 1
+
+#include "G4VHitsCollection.hh"
+#include "singCrysSiliconHit.hh"
+#include <vector>
+
+/*!
+ * \class singCrysSiliconHitArena
+ * \brief Structure-of-arrays storage for the silicon hits of an event.
+ *
+ * Each hit field is a contiguous column, so the hits can be written out with
+ * bulk copies instead of chasing one pointer per hit. Only the columns of the
+ * fields in singCrysHitSchema are allocated. The floating point columns are
+ * double or float, following the precision of the schema (quantized energies
+ * are kept as float and only encoded when written).
+ *
+ * The arena is owned by the sensitive detector and lives for the whole job.
+ * Reset() only sets the number of hits to zero, so after the first few
+ * events the columns have reached their working size and recording a hit
+ * does not allocate at all.
+ */
+
+class singCrysSiliconHitArena
+{
+  public:
+    //! Floating point columns
+    enum RealColumn
+    {
+      kEdep,
+      kTime,
+      kXPos,
+      kYPos,
+      kZPos,
+      kXPVec,
+      kYPVec,
+      kZPVec,
+      kNReal
+    };
+    //! Integer columns
+    enum IntColumn
+    {
+      kTrackID,
+      kAPDNb,
+      kNInt
+    };
+    //! Constructor
+    /*!
+     * Gets the fields and precision from singCrysHitSchema.
+     */
+    singCrysSiliconHitArena();
+    //! Forgets all hits, keeping the allocated columns
+    void Reset() {nHits = 0;}
+    //! Number of hits stored
+    size_t Size() const {return nHits;}
+    //! Adds a hit
+    /*!
+     * All stored columns of the new hit must be set by the caller.
+     * \return Index of the new hit
+     */
+    size_t Append();
+    //! Whether a floating point column is stored
+    G4bool Has(RealColumn column) const {return realUsed[column];}
+    //! Whether an integer column is stored
+    G4bool Has(IntColumn column) const {return intUsed[column];}
+    //! Whether the floating point columns are float rather than double
+    G4bool IsFloat() const {return useFloat;}
+    //! Sets a value in a floating point column. Ignored if not stored.
+    /*!
+     * \param column The column
+     * \param i Index of the hit
+     * \param value The value
+     */
+    void Set(RealColumn column, size_t i, G4double value)
+    {
+      if (!realUsed[column]) return;
+      if (useFloat) floatColumns[column][i] = (G4float) value;
+      else doubleColumns[column][i] = value;
+    }
+    //! Sets a value in an integer column. Ignored if not stored.
+    /*!
+     * \param column The column
+     * \param i Index of the hit
+     * \param value The value
+     */
+    void Set(IntColumn column, size_t i, G4int value)
+    {
+      if (intUsed[column]) intColumns[column][i] = value;
+    }
+    //! Gets a value from a floating point column
+    /*!
+     * \param column The column
+     * \param i Index of the hit
+     * \return The value, or 0 if the column is not stored
+     */
+    G4double Get(RealColumn column, size_t i) const
+    {
+      if (!realUsed[column]) return 0.;
+      return useFloat ? floatColumns[column][i] : doubleColumns[column][i];
+    }
+    //! Gets a value from an integer column
+    /*!
+     * \param column The column
+     * \param i Index of the hit
+     * \return The value, or -1 if the column is not stored
+     */
+    G4int Get(IntColumn column, size_t i) const
+    {
+      return intUsed[column] ? intColumns[column][i] : -1;
+    }
+    //! Contiguous data of a floating point column
+    /*!
+     * Real must be G4float if IsFloat() and G4double otherwise.
+     * \param column The column
+     * \return Pointer to the first hit, or 0 if the column is empty
+     */
+    template <typename Real>
+    const Real* Column(RealColumn column) const;
+    //! Contiguous data of an integer column
+    /*!
+     * \param column The column
+     * \return Pointer to the first hit, or 0 if the column is empty
+     */
+    const G4int* Column(IntColumn column) const
+    {
+      return intColumns[column].empty() ? 0 : &intColumns[column][0];
+    }
+
+  private:
+    //! Enlarges all stored columns
+    void Grow();
+    //! Which floating point columns are stored
+    G4bool realUsed[kNReal];
+    //! Which integer columns are stored
+    G4bool intUsed[kNInt];
+    //! Whether the floating point columns are float
+    G4bool useFloat;
+    //! Number of hits stored
+    size_t nHits;
+    //! Number of hits the columns can hold
+    size_t capacity;
+    //! Floating point columns, double precision
+    std::vector<G4double> doubleColumns[kNReal];
+    //! Floating point columns, single precision
+    std::vector<G4float> floatColumns[kNReal];
+    //! Integer columns
+    std::vector<G4int> intColumns[kNInt];
+};
+
+template <>
+inline const G4double* singCrysSiliconHitArena::
+  Column<G4double>(RealColumn column) const
+{
+  return doubleColumns[column].empty() ? 0 : &doubleColumns[column][0];
+}
+
+template <>
+inline const G4float* singCrysSiliconHitArena::
+  Column<G4float>(RealColumn column) const
+{
+  return floatColumns[column].empty() ? 0 : &floatColumns[column][0];
+}
+
+/*!
+ * \class singCrysSiliconHitsCollection
+ * \brief Hits collection of the silicon sensitive detector.
+ *
+ * A view of the singCrysSiliconHitArena of the sensitive detector, handed to
+ * G4HCofThisEvent. GEANT4 deletes the collection at the end of the event,
+ * but the arena and its columns are kept. operator[] returns a
+ * singCrysSiliconHit by value, for code that wants a hit at a time.
+ */
+
+class singCrysSiliconHitsCollection : public G4VHitsCollection
+{
+  public:
+    //! Constructor
+    /*!
+     * \param detName Name of the sensitive detector
+     * \param colName Name of the collection
+     * \param hitArena Arena holding the hits of the event
+     */
+    singCrysSiliconHitsCollection(G4String detName, G4String colName,
+                                  const singCrysSiliconHitArena* hitArena);
+    //! Destructor. The arena is not deleted.
+    virtual ~singCrysSiliconHitsCollection();
+    //! Number of hits in the event
+    G4int entries() const {return (G4int) arena->Size();}
+    //! Number of hits in the event
+    virtual size_t GetSize() const {return arena->Size();}
+    //! Copy of a hit
+    /*!
+     * \param i Index of the hit
+     * \return The hit
+     */
+    singCrysSiliconHit operator[](size_t i) const;
+    //! Accessor for the arena, for column-wise access
+    const singCrysSiliconHitArena* GetArena() const {return arena;}
+    //! Draws all hits
+    virtual void DrawAllHits();
+    //! Prints all hits
+    virtual void PrintAllHits();
+
+  private:
+    //! Arena holding the hits
+    const singCrysSiliconHitArena* arena;
+};
+
+#endif
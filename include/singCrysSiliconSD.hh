@@ -8,7 +8,7 @@
 #define singCrysSiliconSD_h 1
 
 #include "G4VSensitiveDetector.hh"
-#include "singCrysSiliconHit.hh"
+#include "singCrysSiliconHitsCollection.hh"
 #include <vector>
 
 class G4Step;
@@ -18,8 +18,9 @@ class G4HCofThisEvent;
  * \class singCrysSiliconSD
  * \brief User-defined sensitive detector class.
  * 
- * Processes hits that occur in the volume it is assigned to, and creates the
- * appropriate singCrysSiliconHit objects.
+ * Processes hits that occur in the volume it is assigned to, and records
+ * them in its singCrysSiliconHitArena. The arena is reused from event to
+ * event, so no memory is allocated per hit.
  */
 
 class singCrysSiliconSD : public G4VSensitiveDetector
@@ -34,16 +35,15 @@ class singCrysSiliconSD : public G4VSensitiveDetector
     // methods from base classes
     //! Initializes hit collections
     /*!
-     * Initializes the singCrysSiliconHitsCollection and adds it to the hit
-     * collection of this event.
+     * Resets the arena, creates a singCrysSiliconHitsCollection viewing it,
+     * and adds it to the hit collection of this event.
      * \param hce The hit collection of this event
      */
     virtual void Initialize(G4HCofThisEvent* hce);
     //! Process hits
     /*!
-     * Function called by GEANT4 to proceses the hits. Makes singCrysSiliconHit
-     * objects and puts in the relevant information about the hit. Also prints
-     * the hit information.
+     * Function called by GEANT4 to proceses the hits. Appends a hit to the
+     * arena and puts in the relevant information about the hit.
      * \param step The step of this event
      * \param history The touchable history
      */
@@ -59,6 +59,8 @@ class singCrysSiliconSD : public G4VSensitiveDetector
   private:
     //! Hit collection object
     singCrysSiliconHitsCollection* fHitsCollection;
+    //! Storage of the hits, reused for every event
+    singCrysSiliconHitArena fArena;
 };
 
 #endif
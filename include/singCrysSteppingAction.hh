@@ -0,0 +1,62 @@
+/*!
+ * \file singCrysSteppingAction.hh
+ * \brief Header file for the singCrysSteppingAction class. Follows the
+ * optical photons to find where they end up.
+ */
+
+#ifndef singCrysSteppingAction_h
+#define singCrysSteppingAction_h 1
+
+#include "G4UserSteppingAction.hh"
+#include "singCrysPhotonTally.hh"
+#include "globals.hh"
+
+class G4OpBoundaryProcess;
+class G4Track;
+class G4VPhysicalVolume;
+
+/*!
+ * \class singCrysSteppingAction
+ * \brief User-defined optional stepping action class. Counts the bounces of
+ * each optical photon, and its fate when it is killed.
+ *
+ * Only registered when 'photonFates' is set, since it is called at every
+ * step. A bounce is any reflection reported by G4OpBoundaryProcess. When a
+ * photon is killed, its fate is found from the boundary status and the
+ * volume:
+ * - Detection at a boundary is a detected photon;
+ * - Absorption at a boundary is charged to the volume on the other side;
+ * - bulk absorption is charged to the volume the photon was in;
+ * - a photon leaving the world, or absorbed in it, escaped.
+ *
+ * The fate, bounces, and path length are given to singCrysPhotonTally.
+ */
+
+class singCrysSteppingAction : public G4UserSteppingAction
+{
+  public:
+    //! Constructor
+    singCrysSteppingAction();
+    //! Destructor
+    virtual ~singCrysSteppingAction();
+    //! Counts the bounces of optical photons and records their fates
+    virtual void UserSteppingAction(const G4Step* step);
+
+  private:
+    //! Finds the boundary process of the optical photon
+    G4OpBoundaryProcess* FindBoundaryProcess();
+    //! Fate charged to a volume
+    static singCrysPhotonTally::Fate VolumeFate(
+      const G4VPhysicalVolume* volume);
+
+    //! Boundary process of the optical photon, found at the first step
+    G4OpBoundaryProcess* boundary;
+    //! Track whose bounces are being counted
+    const G4Track* currentTrack;
+    //! ID of that track. The address alone could be reused.
+    G4int currentTrackID;
+    //! Number of bounces of the current track
+    G4int bounces;
+};
+
+#endif
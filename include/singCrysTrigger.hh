@@ -0,0 +1,81 @@
+/*!
+ * \file singCrysTrigger.hh
+ * \brief Header file for the singCrysTrigger class. Decides which events are
+ * written to the output.
+ */
+
+#ifndef singCrysTrigger_h
+#define singCrysTrigger_h 1
+
+#include "globals.hh"
+#include <string>
+#include <vector>
+
+class singCrysSiliconHitArena;
+
+/*!
+ * \class singCrysTrigger
+ * \brief Online trigger applied by singCrysEventAction before the output is
+ * written.
+ *
+ * An APD fires if it has at least 'triggerMinHits' hits, and an event passes
+ * if at least 'triggerCoincidence' APDs fire and the total energy of its
+ * hits is within 'triggerEnergyMin' and 'triggerEnergyMax'. A
+ * 'triggerMinHits' of 0 disables the APD requirement, and an energy bound of
+ * 0 disables that bound. With all three at 0 (the default), every event is
+ * written, as before the trigger existed. The APD of each hit is recorded
+ * (see singCrysHitSchema) when 'triggerMinHits' is set.
+ *
+ * Rejected events are only counted, except every 'triggerPrescale'-th one,
+ * which is written anyway (0 for none). They can be told apart offline by
+ * applying the same requirements to the written hits. The counts are
+ * printed, and stored in the ROOT file, at the end of the job.
+ */
+
+class singCrysTrigger
+{
+  public:
+    //! Constructor
+    /*!
+     * Gets the options from singCrysConfig, and adds the APD to the hit
+     * schema if 'triggerMinHits' is set.
+     */
+    singCrysTrigger();
+    //! Applies the trigger and the prescale to an event
+    /*!
+     * \param arena Hits of the event, or 0 if there is no hits collection
+     * \return Whether the event is written
+     */
+    G4bool Accept(const singCrysSiliconHitArena* arena);
+    //! Whether any requirement is set
+    G4bool IsActive() const {return active;}
+    //! Summary of the requirements and of the counts
+    std::string Summary() const;
+
+  private:
+    //! Whether an event passes the requirements
+    G4bool Passes(const singCrysSiliconHitArena* arena);
+
+    //! Whether any requirement is set
+    G4bool active;
+    //! Number of hits for an APD to fire (0 for no requirement)
+    G4int minHits;
+    //! Number of APDs that must fire
+    G4int coincidence;
+    //! Minimum total energy of the hits (0 for none)
+    G4double energyMin;
+    //! Maximum total energy of the hits (0 for none)
+    G4double energyMax;
+    //! Every prescale-th rejected event is written (0 for none)
+    G4int prescale;
+    //! Number of hits per APD in the current event
+    std::vector<G4int> hitsPerAPD;
+    //! Number of events that passed
+    G4long nAccepted;
+    //! Number of events that failed
+    G4long nRejected;
+    //! Number of failed events written because of the prescale
+    G4long nPrescaled;
+};
+
+#endif
@@ -9,6 +9,9 @@
 
 #include "G4UIsession.hh"
 #include <fstream>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
 
 using namespace std;
 
@@ -19,6 +22,15 @@ using namespace std;
  *
  * User-defined UI session class that user-defined files and diverts G4cout
  * and G4cerr to them.
+ *
+ * G4cout is not written to the log file directly. Each thread appends to its
+ * own buffer, and a background thread writes the buffers to the log file
+ * whenever one of them is full or every 'logFlushInterval' milliseconds. The
+ * log file is rotated once it grows past 'logMaxSize' megabytes. G4cerr is
+ * written and flushed immediately, after all pending G4cout output, so that
+ * the log is complete up to every error. The buffers are also flushed on
+ * exit and, on a best-effort basis, when the program is killed by a fatal
+ * signal.
  */
 
 class singCrysUIsession : public G4UIsession
@@ -26,22 +38,96 @@ class singCrysUIsession : public G4UIsession
   public:
     //! Constructor
     /*!
-     * Gets the file names from singCrysConfig and opens them.
+     * Gets the file names and buffering options from singCrysConfig, opens
+     * the files, and starts the background flushing thread.
      */
     singCrysUIsession();
     //! Destructor
     /*!
-     * Closes the files opened in the constructor.
+     * Stops the flushing thread, writes out everything that is still
+     * buffered, and closes the files opened in the constructor.
      */
     ~singCrysUIsession();
-    //! Writes contents of G4cout to file
+    //! Appends contents of G4cout to the buffer of the calling thread
     virtual G4int ReceiveG4cout(const G4String& coutString);
-    //! Writes contents of G4cerr to file
+    //! Writes contents of G4cerr to file, after flushing buffered G4cout
     virtual G4int ReceiveG4cerr(const G4String& cerrString);
+    //! Writes all buffered G4cout output to the log file
+    void Flush();
+
   private:
+    //! Buffer of G4cout output belonging to a single thread
+    struct LogBuffer
+    {
+      //! Protects 'data' against the flushing thread
+      boost::mutex mutex;
+      //! Output not yet written to the log file
+      std::string data;
+    };
+    //! Returns the buffer of the calling thread, creating it if necessary
+    LogBuffer* GetThreadBuffer();
+    //! Body of the background flushing thread
+    void FlusherLoop();
+    //! Writes all buffered G4cout output to the log file
+    /*!
+     * Must be called with 'fileMutex' held.
+     */
+    void FlushLocked();
+    //! Writes text to the log file, rotating it if needed
+    /*!
+     * Must be called with 'fileMutex' held.
+     * \param text Text to be written
+     */
+    void WriteLog(const std::string& text);
+    //! Renames the log files one step down the rotation and reopens the log
+    void RotateLog();
+    //! Flushes the buffers without blocking on locks held elsewhere
+    /*!
+     * Used from the fatal signal handler, where waiting on a lock held by
+     * the interrupted code would deadlock.
+     */
+    void EmergencyFlush();
+    //! Flushes the active session when the program exits
+    static void FlushAtExit();
+    //! Flushes the active session on a fatal signal and re-raises the signal
+    static void FlushOnSignal(int sig);
+    //! Cleanup function for the thread-specific pointer. Does nothing, since
+    //! the buffers are owned by 'buffers'.
+    static void KeepBuffer(LogBuffer*) {}
+    //! Session currently receiving output, used by the exit handlers
+    static singCrysUIsession* fInstance;
+
     //! File to write G4cout to
     ofstream logfile;
     //! File to write G4cerr to
     ofstream errfile;
+    //! Name of the log file, used for rotation
+    std::string logfileName;
+    //! Number of bytes written to the current log file
+    std::streamoff logSize;
+    //! Buffer size (bytes) above which the flushing thread is woken up
+    size_t bufferSize;
+    //! Maximum time (ms) between two flushes
+    G4int flushInterval;
+    //! Size (bytes) above which the log file is rotated; 0 to never rotate
+    std::streamoff maxLogSize;
+    //! Number of rotated log files to keep
+    G4int maxLogFiles;
+    //! Buffer of the calling thread
+    boost::thread_specific_ptr<LogBuffer> threadBuffer;
+    //! All thread buffers created so far
+    std::vector<LogBuffer*> buffers;
+    //! Protects 'buffers'
+    boost::mutex buffersMutex;
+    //! Protects the log and error files
+    boost::mutex fileMutex;
+    //! Protects 'stopFlusher' and is used with 'flushCondition'
+    boost::mutex flushMutex;
+    //! Wakes up the flushing thread
+    boost::condition_variable flushCondition;
+    //! Whether the flushing thread should stop
+    G4bool stopFlusher;
+    //! Background flushing thread
+    boost::thread flusher;
 };
 #endif
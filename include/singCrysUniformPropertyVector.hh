@@ -0,0 +1,66 @@
+/*!
+ * \file singCrysUniformPropertyVector.hh
+ * \brief Header file for the singCrysUniformPropertyVector class. Material
+ * property vector on a uniform energy grid.
+ */
+
+#ifndef singCrysUniformPropertyVector_h
+#define singCrysUniformPropertyVector_h 1
+
+#include "globals.hh"
+#include "G4MaterialPropertyVector.hh"
+
+/*!
+ * \class singCrysUniformPropertyVector
+ * \brief Material property vector resampled on a uniform energy grid
+ *
+ * A property vector read from a data file has an irregular energy grid, so
+ * every lookup does a binary search for the bin, and vectors with
+ * SetSpline(true) also evaluate the spline. This vector samples the
+ * original (with its interpolation) at 'nBins' + 1 equally spaced energies
+ * between its first and last energy, and interpolates linearly between
+ * them. FindBinLocation is then a single multiplication.
+ *
+ * While resampling, the original is also evaluated at the middle of each
+ * bin, and the largest difference to the linear interpolation is kept as
+ * the interpolation error. It shrinks as 1/nBins^2 for smooth properties.
+ *
+ * It is a G4MaterialPropertyVector, so it can be added to a
+ * G4MaterialPropertiesTable and is used by the optical processes like any
+ * other property.
+ */
+
+class singCrysUniformPropertyVector : public G4MaterialPropertyVector
+{
+  public:
+    //! Constructor
+    /*!
+     * \param original The vector to resample. It is not modified, except
+     * for its lookup cache, and may be deleted afterwards.
+     * \param nBins Number of bins of the uniform grid
+     */
+    singCrysUniformPropertyVector(G4MaterialPropertyVector* original,
+                                  G4int nBins);
+    //! Destructor
+    virtual ~singCrysUniformPropertyVector();
+    //! Finds the bin of an energy in constant time
+    /*!
+     * \param theEnergy Energy between the first and last energies
+     * \return Index of the lower edge of the bin
+     */
+    virtual size_t FindBinLocation(G4double theEnergy) const;
+    //! Largest absolute difference to the original vector
+    G4double GetMaxError() const {return maxError;}
+    //! Largest difference relative to the original value
+    G4double GetMaxRelError() const {return maxRelError;}
+
+  private:
+    //! Inverse of the width of the bins
+    G4double invBinWidth;
+    //! Largest absolute difference to the original vector
+    G4double maxError;
+    //! Largest difference relative to the original value
+    G4double maxRelError;
+};
+
+#endif
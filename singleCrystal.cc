@@ -5,7 +5,7 @@
  */
 
 #include "G4UImanager.hh"
-#include "G4RunManager.hh"
+#include "singCrysRunManager.hh"
 #include "singCrysUIsession.hh"
 
 #ifdef G4VIS_USE
@@ -21,6 +21,11 @@
 #include "singCrysPrimaryGeneratorAction.hh"
 #include "singCrysConfig.hh"
 #include "singCrysEventAction.hh"
+#include "singCrysRunAction.hh"
+#include "singCrysSteppingAction.hh"
+#include "singCrysPhotonTally.hh"
+#include "singCrysServer.hh"
+#include "singCrysCheckpoint.hh"
 
 #include "G4StepLimiterBuilder.hh"
 #include "G4VModularPhysicsList.hh"
@@ -45,7 +50,10 @@ int main(int argc, char** argv)
     ("help", "produce help message")
     ("config,c", po::value<std::string>()->default_value("config.ini"),
       "configuration fle")
-    ("script", po::value<std::string>(), "script to run in batch mode");
+    ("script", po::value<std::string>(), "script to run in batch mode")
+    ("resume", "continue from the last checkpoint")
+    ("serve", po::value<std::string>(),
+      "after initialization, run the commands sent to this Unix socket");
   // Make the 'script' option be positional. There should be at most one
   // script argument.
   po::positional_options_description pos_options;
@@ -67,8 +75,17 @@ int main(int argc, char** argv)
   // Choose the random engine
   CLHEP::HepRandom::setTheEngine(new CLHEP::RanecuEngine);
 
-  // Construct the default run manager
-  G4RunManager* runManager = new G4RunManager;
+  // Read the checkpoint if resuming. This must be done before the user
+  // action classes are constructed, since they open the output files.
+  if (vm.count("resume"))
+  {
+    singCrysCheckpoint::GetInstance()->Resume();
+  }
+  // Stop gracefully, with a checkpoint, on SIGINT and SIGTERM
+  singCrysCheckpoint::InstallSignalHandlers();
+
+  // Construct the run manager
+  G4RunManager* runManager = new singCrysRunManager;
 
   // Set detector construction class
   runManager->SetUserInitialization(new singCrysDetectorConstruction());
@@ -82,6 +99,17 @@ int main(int argc, char** argv)
   // Add optional event action class
   runManager->SetUserAction(new singCrysEventAction());
 
+  // Add optional run action class, which makes the run summaries
+  singCrysRunAction* runAction = new singCrysRunAction();
+  runManager->SetUserAction(runAction);
+
+  // Add optional stepping action class, only if the photon fates are
+  // counted, since it is called at every step
+  if (singCrysPhotonTally::GetInstance()->IsEnabled())
+  {
+    runManager->SetUserAction(new singCrysSteppingAction());
+  }
+
   // Initialize kernel
   runManager->Initialize();
 
@@ -96,8 +124,21 @@ int main(int argc, char** argv)
   singCrysUIsession* loggedSession = new singCrysUIsession;
   UImanager->SetCoutDestination(loggedSession);
  
+  // Server mode: the script, if any, is executed first, then the commands
+  // of the clients
+  if (vm.count("serve"))
+  {
+    if (vm.count("script"))
+    {
+      UImanager->ApplyCommand("/control/execute " +
+        (G4String) vm["script"].as<std::string>());
+    }
+    singCrysServer server(vm["serve"].as<std::string>(), runAction);
+    server.Serve();
+  }
+
   // If a script option was passed in, batch mode
-  if (vm.count("script"))
+  else if (vm.count("script"))
   {
     G4String command = "/control/execute ";
 
@@ -7,6 +7,7 @@
 #ifdef AIDA_USE
 
 #include <fstream>
+#include <string>
 #include "G4ios.hh"
 #include "G4Run.hh"
 #include "G4Event.hh"
@@ -19,6 +20,7 @@
 
 #include "singCrysAIDAManager.hh"
 #include "singCrysConfig.hh"
+#include "singCrysCheckpoint.hh"
 #include <boost/program_options.hpp>
 
 namespace po = boost::program_options;
@@ -39,8 +41,11 @@ singCrysAIDAManager::singCrysAIDAManager()
     // Get tree for file output
     G4String aidaOutfile = (G4String) config["aidaOutfile"].as<std::string>();
     AIDA::ITreeFactory* treeFactory = fAnalysisFactory->createTreeFactory();
+    // When resuming from a checkpoint, open the existing file instead of
+    // creating a new one.
+    G4bool createNew = !singCrysCheckpoint::GetInstance()->IsResuming();
     fTree = treeFactory->
-      create(aidaOutfile, "root", false, true, "compress=no");
+      create(aidaOutfile, "root", false, createNew, "compress=no");
     // Create factories
     fFactory = fAnalysisFactory->createHistogramFactory(*fTree);
     tFactory = fAnalysisFactory->createTupleFactory(*fTree);
@@ -89,6 +94,58 @@ AIDA::IPlotter* singCrysAIDAManager::getPlotter()
   return fPlotter;
 }
 
+// Accessor method for the tree
+AIDA::ITree* singCrysAIDAManager::getTree()
+{
+  return fTree;
+}
+
+// Writes the tree contents to file
+G4bool singCrysAIDAManager::commit()
+{
+  if (!fAnalysisFactory) return false;
+  return fTree->commit();
+}
+
+// Keeps the first rows of a tuple
+G4bool singCrysAIDAManager::truncate(AIDA::ITuple* tuple, G4int nRows)
+{
+  if (tuple->rows() < nRows) return false;
+  if (tuple->rows() == nRows) return true;
+  // Read back the rows kept. Every column type fits in a double.
+  G4int nColumns = tuple->columns();
+  std::vector<std::string> types(nColumns);
+  for (G4int j = 0; j < nColumns; j++) types[j] = tuple->columnType(j);
+  std::vector<G4double> values((size_t) nRows * nColumns);
+  tuple->start();
+  for (G4int i = 0; i < nRows && tuple->next(); i++)
+  {
+    for (G4int j = 0; j < nColumns; j++)
+    {
+      G4double& value = values[(size_t) i * nColumns + j];
+      if (types[j] == "int") value = tuple->getInt(j);
+      else if (types[j] == "short") value = tuple->getShort(j);
+      else if (types[j] == "float") value = tuple->getFloat(j);
+      else value = tuple->getDouble(j);
+    }
+  }
+  // Fill them again
+  tuple->reset();
+  for (G4int i = 0; i < nRows; i++)
+  {
+    for (G4int j = 0; j < nColumns; j++)
+    {
+      G4double value = values[(size_t) i * nColumns + j];
+      if (types[j] == "int") tuple->fill(j, (int) value);
+      else if (types[j] == "short") tuple->fill(j, (short) value);
+      else if (types[j] == "float") tuple->fill(j, (float) value);
+      else tuple->fill(j, value);
+    }
+    tuple->addRow();
+  }
+  return true;
+}
+
 // Returns the pointer to the class, if the class has been initialized.
 // Otherwise creates an instance.
 singCrysAIDAManager* singCrysAIDAManager::getInstance()
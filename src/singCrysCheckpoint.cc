@@ -0,0 +1,182 @@
+/*!
+ * \file singCrysCheckpoint.cc
+ * \brief Implementation file for the singCrysCheckpoint class. Writes and
+ * reads checkpoints of long runs.
+ */
+
+#include "singCrysCheckpoint.hh"
+#include "singCrysConfig.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <cstdio>
+#include <sstream>
+
+namespace po = boost::program_options;
+
+// Initialize static members
+volatile sig_atomic_t singCrysCheckpoint::stopRequested = 0;
+
+// Constructor. Get the checkpoint options.
+singCrysCheckpoint::singCrysCheckpoint()
+  : runIndex(-1),
+    eventsDone(0),
+    eventOffset(0),
+    rootEntries(0),
+    depositBytes(-1),
+    resuming(false),
+    resumeRun(-1),
+    resumeEvents(0)
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  checkpointFile = (G4String) config["checkpointFile"].as<std::string>();
+  checkpointEvery = config["checkpointEvery"].as<G4int>();
+  checkpointTime = config["checkpointMinutes"].as<G4double>() * 60.;
+  lastCheckpoint = time(NULL);
+}
+
+// Returns the pointer to the singleton class.
+singCrysCheckpoint* singCrysCheckpoint::GetInstance()
+{
+  static singCrysCheckpoint pInstance;
+  return &pInstance;
+}
+
+// Reads the checkpoint file
+G4bool singCrysCheckpoint::Resume()
+{
+  std::ifstream inf(checkpointFile);
+  if (!inf)
+  {
+    G4cerr << "Error: checkpoint " << checkpointFile << " cannot be read. "
+      << "Starting from the beginning." << G4endl;
+    return false;
+  }
+  // The checkpoint has the same key = value format as the config file
+  po::options_description desc;
+  desc.add_options()
+    ("runIndex", po::value<G4int>(), "Index of the interrupted run")
+    ("eventsDone", po::value<G4int>(), "Events done in the interrupted run")
+    ("gunX", po::value<G4double>()->default_value(0.), "Gun x position (mm)")
+    ("gunY", po::value<G4double>()->default_value(0.), "Gun y position (mm)")
+    ("gunZ", po::value<G4double>()->default_value(0.), "Gun z position (mm)")
+    ("rootEntries", po::value<G4long>()->default_value(0),
+      "Entries in the ROOT tree")
+    ("tupleRows", po::value<std::string>()->default_value(""),
+      "Rows of the AIDA tuples")
+    ("depositBytes", po::value<G4long>()->default_value(-1),
+      "Length of the deposit library")
+    ;
+  po::variables_map vm;
+  po::store(parse_config_file(inf, desc), vm);
+  po::notify(vm);
+  if (!vm.count("runIndex") || !vm.count("eventsDone"))
+  {
+    G4cerr << "Error: checkpoint " << checkpointFile << " is incomplete. "
+      << "Starting from the beginning." << G4endl;
+    return false;
+  }
+  resumeRun = vm["runIndex"].as<G4int>();
+  resumeEvents = vm["eventsDone"].as<G4int>();
+  resumeGunPos = G4ThreeVector(vm["gunX"].as<G4double>() * mm,
+                               vm["gunY"].as<G4double>() * mm,
+                               vm["gunZ"].as<G4double>() * mm);
+  rootEntries = vm["rootEntries"].as<G4long>();
+  tupleRows.clear();
+  std::istringstream rows(vm["tupleRows"].as<std::string>());
+  G4long nRows;
+  while (rows >> nRows) tupleRows.push_back(nRows);
+  depositBytes = vm["depositBytes"].as<G4long>();
+  resuming = true;
+  G4cout << "Resuming from checkpoint " << checkpointFile << ": run "
+    << resumeRun << ", " << resumeEvents << " events done." << G4endl;
+  return true;
+}
+
+// Installs the handlers for SIGINT and SIGTERM
+void singCrysCheckpoint::InstallSignalHandlers()
+{
+  signal(SIGINT, &singCrysCheckpoint::RequestStop);
+  signal(SIGTERM, &singCrysCheckpoint::RequestStop);
+}
+
+// Asks for a graceful stop. A second signal gets the default action.
+void singCrysCheckpoint::RequestStop(int sig)
+{
+  stopRequested = 1;
+  signal(sig, SIG_DFL);
+}
+
+// Updates the run counters at the start of a run
+G4int singCrysCheckpoint::BeginRun(G4int nEvent, const G4ThreeVector& gunPos)
+{
+  runIndex++;
+  eventsDone = 0;
+  eventOffset = 0;
+  lastCheckpoint = time(NULL);
+  if (!resuming) return 0;
+  // Runs before the interrupted one are skipped entirely.
+  if (runIndex < resumeRun) return nEvent;
+  // The interrupted run: restore the random engine and skip the events
+  // already done.
+  resuming = false;
+  if ((gunPos - resumeGunPos).mag() > 1.e-6 * mm)
+  {
+    G4cerr << "Warning: gun position " << gunPos / mm << " mm differs from "
+      << "the checkpoint position " << resumeGunPos / mm << " mm. Is the "
+      << "macro the same as for the interrupted job?" << G4endl;
+  }
+  G4String engineFile = checkpointFile + ".rndm";
+  CLHEP::HepRandom::restoreEngineStatus(engineFile);
+  eventsDone = resumeEvents;
+  eventOffset = resumeEvents;
+  return resumeEvents;
+}
+
+// Whether enough events or time have passed since the last checkpoint
+G4bool singCrysCheckpoint::IsDue() const
+{
+  if (checkpointEvery > 0 && eventsDone % checkpointEvery == 0) return true;
+  if (checkpointTime > 0 && difftime(time(NULL), lastCheckpoint)
+      >= checkpointTime) return true;
+  return false;
+}
+
+// Writes the checkpoint. Both files are written under temporary names
+// first, so that an interruption never leaves a corrupt checkpoint.
+void singCrysCheckpoint::Write(const G4ThreeVector& gunPos,
+                               G4long nRootEntries,
+                               const std::vector<G4long>& nTupleRows,
+                               G4long nDepositBytes)
+{
+  G4String engineFile = checkpointFile + ".rndm";
+  G4String tmpEngineFile = engineFile + ".tmp";
+  G4String tmpFile = checkpointFile + ".tmp";
+  CLHEP::HepRandom::saveEngineStatus(tmpEngineFile);
+  std::ofstream outf(tmpFile);
+  outf.precision(17);
+  outf << "runIndex = " << runIndex << "\n"
+       << "eventsDone = " << eventsDone << "\n"
+       << "gunX = " << gunPos.x() / mm << "\n"
+       << "gunY = " << gunPos.y() / mm << "\n"
+       << "gunZ = " << gunPos.z() / mm << "\n"
+       << "rootEntries = " << nRootEntries << "\n"
+       << "tupleRows =";
+  for (size_t i = 0; i < nTupleRows.size(); i++) outf << " " << nTupleRows[i];
+  outf << "\n"
+       << "depositBytes = " << nDepositBytes << "\n";
+  outf.close();
+  if (!outf)
+  {
+    G4cerr << "Error: checkpoint " << tmpFile << " could not be written."
+      << G4endl;
+    return;
+  }
+  std::rename(tmpEngineFile.c_str(), engineFile.c_str());
+  std::rename(tmpFile.c_str(), checkpointFile.c_str());
+  rootEntries = nRootEntries;
+  tupleRows = nTupleRows;
+  depositBytes = nDepositBytes;
+  lastCheckpoint = time(NULL);
+}
@@ -7,6 +7,7 @@
 #include "singCrysConfig.hh"
 #include <boost/program_options.hpp>
 #include <string>
+#include <vector>
 #include <fstream>
 #include <iostream>
 
@@ -19,7 +20,6 @@ singCrysConfig::singCrysConfig()
 {
   // Open the config file, and read in its contents
   std::ifstream ini_file(filename); // Open stream
-  po::options_description desc;     // Declare option description object
   desc.add_options()                // Add options
     // Geometry options
     ("crysNumSides", po::value<G4int>()->default_value(4),
@@ -60,6 +60,12 @@ singCrysConfig::singCrysConfig()
       "How much of the crystal is in the Al case (mm)")
     ("nAPD", po::value<G4int>()->default_value(2),
       "Number of APDs")
+    ("geometryMode", po::value<std::string>()->default_value("boolean"),
+      "Build volumes with cut-outs as 'boolean' or 'decomposed' solids")
+    ("specializeSolids", po::value<G4bool>()->default_value(true),
+      "Use G4Box or G4Tubs instead of G4Polyhedra when possible")
+    ("tubsMinSides", po::value<G4int>()->default_value(64),
+      "Number of sides from which prisms are made as cylinders (0 for never)")
     // Materials
     ("crysMat", po::value<std::string>()->default_value("LYSO"),
       "Crystal material")
@@ -87,6 +93,15 @@ singCrysConfig::singCrysConfig()
     // Whether to check for volume overlaps
     ("checkOverlaps", po::value<G4bool>()->default_value(true),
       "Check overlaps in geometry?")
+    ("overlapResolution", po::value<G4int>()->default_value(1000),
+      "Number of surface points per volume in the overlap check")
+    ("overlapTolerance", po::value<G4double>()->default_value(0.),
+      "Overlaps smaller than this are ignored (mm)")
+    ("overlapJobs", po::value<G4int>()->default_value(0),
+      "Number of parallel overlap checking jobs (0 for one per processor)")
+    ("overlapCacheDir",
+      po::value<std::string>()->default_value(".overlapCache"),
+      "Directory remembering geometries without overlaps (empty for none)")
     // Single-value physics parameters
     ("ceramicRefl", po::value<G4double>()->default_value(0.9),
       "Reflectance of ceramic")
@@ -100,9 +115,16 @@ singCrysConfig::singCrysConfig()
       "Time constant for slow component of scintillation (ns)")
     ("yieldRatio", po::value<G4double>()->default_value(1.),
       "Relative strength of fast component as fraction of total scint yeild")
+    ("opticalLUT", po::value<G4bool>()->default_value(false),
+      "Resample the optical property vectors on uniform energy grids")
+    ("opticalLUTBins", po::value<G4int>()->default_value(1000),
+      "Number of bins of the uniform energy grids")
     // Data files
     ("dataPath", po::value<std::string>()->default_value(""),
       "Path to data files")
+    ("propertyCacheDir",
+      po::value<std::string>()->default_value(".propertyCache"),
+      "Directory of the binary cache of parsed data files (empty for none)")
     ("crysRIndexFile", po::value<std::string>()
       ->default_value("LYSO_RIndex.dat"),
       "File name for crystal refractive index")
@@ -150,18 +172,193 @@ singCrysConfig::singCrysConfig()
     ("errfileName",
       po::value<std::string>()->default_value("singleCrystal.err"),
       "Name of error file")
+    ("logBufferSize", po::value<G4int>()->default_value(65536),
+      "Size of per-thread log buffers (bytes)")
+    ("logFlushInterval", po::value<G4int>()->default_value(1000),
+      "Maximum time between two writes of the log buffers (ms)")
+    ("logMaxSize", po::value<G4double>()->default_value(0.),
+      "Size above which the log file is rotated (MB, 0 for no rotation)")
+    ("logMaxFiles", po::value<G4int>()->default_value(5),
+      "Number of rotated log files to keep")
     // Options for singCrysPhysicsList
     ("optVerbosity", po::value<G4int>()->default_value(0),
       "Verbosity for optical processes")
+    ("physicsProfile", po::value<std::string>()->default_value("standard"),
+      "Physics profile: fast, standard, or reference")
+    ("physicsTableCacheDir", po::value<std::string>()->default_value(""),
+      "Directory of the physics table cache (empty for no caching)")
     // Options for singCrysEventAction
     ("printEvery", po::value<G4int>()->default_value(100),
       "Print the event number every 'printEvery' event")
     ("rootOutfile", po::value<std::string>()->default_value("output.root"),
       "File for the ROOT-type output")
+    ("rootBasketSize", po::value<G4int>()->default_value(32000),
+      "Basket size of the branches of the ROOT tree (bytes)")
+    ("rootAutoFlush", po::value<G4double>()->default_value(30.),
+      "Write ROOT baskets to disk every 'rootAutoFlush' MB")
+    ("rootAutoSave", po::value<G4double>()->default_value(300.),
+      "Save the ROOT tree header every 'rootAutoSave' MB")
+    ("outputMemCeiling", po::value<G4double>()->default_value(0.),
+      "Memory use (MB) above which all output is flushed (0 for no limit)")
+    ("memCheckEvery", po::value<G4int>()->default_value(100),
+      "Check the memory use every 'memCheckEvery' events")
+    // Options for singCrysHitSchema
+    ("hitFields",
+      po::value<std::string>()->default_value("energy,APDID,position,momentum"),
+      "Comma separated list of hit fields to record")
+    ("hitPrecision", po::value<std::string>()->default_value("double"),
+      "Precision of the hit fields: double, float, or quantized")
+    // Options for singCrysHitSampler
+    ("outputMode", po::value<std::string>()->default_value("full"),
+      "Output mode: full, or sampled (hit fields only for a sample)")
+    ("sampleFraction", po::value<G4double>()->default_value(0.01),
+      "Fraction of events whose hits are sampled")
+    ("samplePhotons", po::value<G4int>()->default_value(0),
+      "Maximum number of hits kept per sampled event (0 for all)")
+    ("sampleSeed", po::value<G4long>()->default_value(12345),
+      "Seed of the random engine of the sampler")
+    // Options for singCrysDigitizer
+    ("digitize", po::value<std::string>()->default_value("off"),
+      "Write APD amplitudes: off, on (with the hits), or only (without them)")
+    ("digitizeSum", po::value<G4bool>()->default_value(false),
+      "Also write the sum of the amplitudes of all APDs")
+    ("apdGain", po::value<G4double>()->default_value(50.),
+      "Mean gain of the APDs")
+    ("apdExcessNoise", po::value<G4double>()->default_value(2.),
+      "Excess noise factor of the APDs")
+    ("apdDarkCounts", po::value<G4double>()->default_value(0.),
+      "Mean number of dark counts per APD per event")
+    ("apdNoise", po::value<G4double>()->default_value(0.),
+      "Electronics noise (electrons RMS)")
+    ("digitizeSeed", po::value<G4long>()->default_value(54321),
+      "Seed of the random engine of the digitizer")
+    // Options for singCrysPulseShaper
+    ("pulseShape", po::value<G4bool>()->default_value(false),
+      "Shape the pulse of each APD and write its amplitude and time")
+    ("pulseBinWidth", po::value<G4double>()->default_value(1.),
+      "Width of the bins of the pulses (ns)")
+    ("pulseWindow", po::value<G4double>()->default_value(2000.),
+      "Length of the pulses from the start of the event (ns)")
+    ("pulseShapingTime", po::value<G4double>()->default_value(20.),
+      "Time constant of the CR-RC^n shaping kernel (ns)")
+    ("pulseShapingOrder", po::value<G4int>()->default_value(1),
+      "Order n of the CR-RC^n shaping kernel")
+    ("cfdFraction", po::value<G4double>()->default_value(0.2),
+      "Fraction of the amplitude at which the pulse time is taken")
+    // Options for singCrysDepositLibrary
+    ("depositLibrary", po::value<std::string>()->default_value(""),
+      "Write the energy deposits in the crystal to this file, without light")
+    // Options for singCrysPrismTransport
+    ("prismTransport", po::value<G4bool>()->default_value(false),
+      "Track optical photons in the crystal analytically")
+    // Options for singCrysScintillation
+    ("batchScintillation", po::value<G4bool>()->default_value(false),
+      "Sample the scintillation photons of a step in batches")
+    ("scintCDFBins", po::value<G4int>()->default_value(1024),
+      "Bins of the inverse cumulative distributions of the spectra")
+    // Options for singCrysPhotonTally
+    ("photonFates", po::value<G4bool>()->default_value(false),
+      "Count where the optical photons end up, per event and per run")
+    // Options for singCrysTrigger
+    ("triggerMinHits", po::value<G4int>()->default_value(0),
+      "Number of hits for an APD to fire (0 for no requirement)")
+    ("triggerCoincidence", po::value<G4int>()->default_value(1),
+      "Number of APDs that must fire")
+    ("triggerEnergyMin", po::value<G4double>()->default_value(0.),
+      "Minimum total energy of the hits of an event (eV, 0 for none)")
+    ("triggerEnergyMax", po::value<G4double>()->default_value(0.),
+      "Maximum total energy of the hits of an event (eV, 0 for none)")
+    ("triggerPrescale", po::value<G4int>()->default_value(0),
+      "Write every 'triggerPrescale'-th rejected event (0 for none)")
+    // Options for singCrysCheckpoint
+    ("checkpointFile",
+      po::value<std::string>()->default_value("singleCrystal.chk"),
+      "Name of the checkpoint file")
+    ("checkpointEvery", po::value<G4int>()->default_value(0),
+      "Write a checkpoint every 'checkpointEvery' events (0 for never)")
+    ("checkpointMinutes", po::value<G4double>()->default_value(0.),
+      "Write a checkpoint every 'checkpointMinutes' minutes (0 for never)")
     // Options for singCrysAIDAManager
     ("aidaOutfile", po::value<std::string>()->default_value("aida.root"),
-      "File for the AIDA-type output") 
+      "File for the AIDA-type output")
+    ("aidaCommitEvery", po::value<G4int>()->default_value(0),
+      "Commit the AIDA tree every 'aidaCommitEvery' events (0 for at end)")
     ;
+  // Options for singCrysPhysicsProfile. Each profile has the same options,
+  // read from the section [profile.<name>] of the file.
+  struct ProfileDefaults
+  {
+    const char* name;
+    G4bool cerenkov;
+    G4int cerenkovMaxPhotons;
+    G4double cerenkovMaxBetaChange;
+    G4bool rayleigh;
+    G4bool muonHadronEM;
+    G4double cut;
+    G4double crystalMaxStep;
+  };
+  const ProfileDefaults profiles[3] =
+  {
+    {"fast", false, 100, 10., true, false, 0.1, 0.},
+    {"standard", true, 20, 10., true, true, 0.01, 0.},
+    {"reference", true, 5, 2., true, true, 0.001, 0.1}
+  };
+  for (G4int i = 0; i < 3; i++)
+  {
+    std::string prefix = std::string("profile.") + profiles[i].name + ".";
+    desc.add_options()
+      ((prefix + "cerenkov").c_str(),
+        po::value<G4bool>()->default_value(profiles[i].cerenkov),
+        "Produce Cerenkov light")
+      ((prefix + "cerenkovMaxPhotons").c_str(),
+        po::value<G4int>()->default_value(profiles[i].cerenkovMaxPhotons),
+        "Maximum number of Cerenkov photons per step")
+      ((prefix + "cerenkovMaxBetaChange").c_str(),
+        po::value<G4double>()->
+          default_value(profiles[i].cerenkovMaxBetaChange),
+        "Maximum change of beta per step for Cerenkov light (%)")
+      ((prefix + "rayleigh").c_str(),
+        po::value<G4bool>()->default_value(profiles[i].rayleigh),
+        "Rayleigh scattering of optical photons")
+      ((prefix + "muonHadronEM").c_str(),
+        po::value<G4bool>()->default_value(profiles[i].muonHadronEM),
+        "EM processes for muons and hadrons")
+      ((prefix + "cut").c_str(),
+        po::value<G4double>()->default_value(profiles[i].cut),
+        "Production cut (mm)")
+      ((prefix + "crystalMaxStep").c_str(),
+        po::value<G4double>()->default_value(profiles[i].crystalMaxStep),
+        "Maximum step of charged particles in the crystal (mm, 0 for none)");
+  }
+  // Options for the regions of singCrysDetectorConstruction, read from the
+  // section [region.<name>] of the file
+  struct RegionDefaults
+  {
+    const char* name;
+    G4double cut;
+    G4double maxStep;
+    G4double minEkin;
+  };
+  const RegionDefaults regions[3] =
+  {
+    {"crystal", 0., 0., 0.},
+    {"APD", 0., 0., 0.},
+    {"passive", 1., 0., 0.}
+  };
+  for (G4int i = 0; i < 3; i++)
+  {
+    std::string prefix = std::string("region.") + regions[i].name + ".";
+    desc.add_options()
+      ((prefix + "cut").c_str(),
+        po::value<G4double>()->default_value(regions[i].cut),
+        "Production cut (mm, 0 for that of the physics profile)")
+      ((prefix + "maxStep").c_str(),
+        po::value<G4double>()->default_value(regions[i].maxStep),
+        "Maximum step of charged particles (mm, 0 for none)")
+      ((prefix + "minEkin").c_str(),
+        po::value<G4double>()->default_value(regions[i].minEkin),
+        "Kill charged particles below this kinetic energy (keV, 0 for never)");
+  }
   // Add to map of stored options
   po::store(parse_config_file(ini_file, desc), vm);
   po::notify(vm);
@@ -197,3 +394,31 @@ po::variables_map* singCrysConfig::GetMap()
 {
   return &vm;
 }
+
+// Parses a new value for an option with the option's own semantic, and
+// replaces the stored value.
+G4bool singCrysConfig::SetOption(const std::string& name,
+                                 const std::string& value)
+{
+  const po::option_description* option = desc.find_nothrow(name, false);
+  if (!option)
+  {
+    G4cerr << "Unknown option " << name << "." << G4endl;
+    return false;
+  }
+  boost::any parsed;
+  try
+  {
+    option->semantic()->parse(parsed, std::vector<std::string>(1, value),
+                              false);
+  }
+  catch (const po::error& e)
+  {
+    G4cerr << "Invalid value " << value << " for option " << name << ": "
+      << e.what() << G4endl;
+    return false;
+  }
+  vm.erase(name);
+  vm.insert(std::make_pair(name, po::variable_value(parsed, false)));
+  return true;
+}
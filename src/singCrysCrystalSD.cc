@@ -0,0 +1,44 @@
+/*!
+ * \file singCrysCrystalSD.cc
+ * \brief Implementation file for the singCrysCrystalSD class. Defines a
+ * sensitive detector for the energy deposits in the crystal.
+ */
+
+#include "singCrysCrystalSD.hh"
+#include "singCrysDepositLibrary.hh"
+#include "singCrysCheckpoint.hh"
+#include "G4Event.hh"
+#include "G4RunManager.hh"
+#include "G4Step.hh"
+#include "G4ThreeVector.hh"
+
+// Constructor
+singCrysCrystalSD::singCrysCrystalSD(const G4String& name)
+  : G4VSensitiveDetector(name)
+{}
+
+// Destructor
+singCrysCrystalSD::~singCrysCrystalSD()
+{}
+
+// Records the deposit at the middle of the step
+G4bool singCrysCrystalSD::ProcessHits(G4Step* aStep, G4TouchableHistory*)
+{
+  G4double edep = aStep->GetTotalEnergyDeposit();
+  if (edep == 0.) return false;
+  G4StepPoint* pre = aStep->GetPreStepPoint();
+  G4StepPoint* post = aStep->GetPostStepPoint();
+  singCrysDepositLibrary::GetInstance()->AddDeposit(
+    0.5 * (pre->GetPosition() + post->GetPosition()), edep,
+    0.5 * (pre->GetGlobalTime() + post->GetGlobalTime()));
+  return true;
+}
+
+// Writes the event, numbered as in singCrysEventAction
+void singCrysCrystalSD::EndOfEvent(G4HCofThisEvent*)
+{
+  const G4Event* evt = G4RunManager::GetRunManager()->GetCurrentEvent();
+  G4int eventID = (evt ? evt->GetEventID() : 0)
+    + singCrysCheckpoint::GetInstance()->GetEventOffset();
+  singCrysDepositLibrary::GetInstance()->EndOfEvent(eventID);
+}
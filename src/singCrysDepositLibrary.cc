@@ -0,0 +1,111 @@
+/*!
+ * \file singCrysDepositLibrary.cc
+ * \brief Implementation file for the singCrysDepositLibrary class. Writes
+ * the energy deposits in the crystal to a file.
+ */
+
+#include "singCrysDepositLibrary.hh"
+#include "singCrysConfig.hh"
+#include "singCrysCheckpoint.hh"
+#include "G4SystemOfUnits.hh"
+#include <boost/program_options.hpp>
+#include <stdint.h>
+#include <unistd.h>
+
+// Constructor. Open the file and write the header, unless appending to it.
+singCrysDepositLibrary::singCrysDepositLibrary() : enabled(false)
+{
+  std::string fileName = (*singCrysConfig::GetInstance()->GetMap())
+    ["depositLibrary"].as<std::string>();
+  if (fileName.empty()) return;
+  G4bool resuming = singCrysCheckpoint::GetInstance()->IsResuming();
+  // When resuming, remove the records written after the last checkpoint,
+  // including a record cut short by the interruption
+  G4long length = singCrysCheckpoint::GetInstance()->GetDepositBytes();
+  if (resuming && length >= 0)
+  {
+    std::ifstream old(fileName.c_str(), std::ios::binary | std::ios::ate);
+    G4long found = old ? (G4long) old.tellg() : 0;
+    old.close();
+    if (found < length)
+    {
+      G4ExceptionDescription msg;
+      msg << fileName << " has " << found << " bytes, but the checkpoint "
+        << "recorded " << length << ". The job cannot be resumed.";
+      G4Exception("singCrysDepositLibrary::singCrysDepositLibrary()",
+                  "singCrysCheckpoint003", FatalException, msg);
+    }
+    if (found > length && truncate(fileName.c_str(), length) != 0)
+    {
+      G4ExceptionDescription msg;
+      msg << fileName << " cannot be cut back to the checkpoint.";
+      G4Exception("singCrysDepositLibrary::singCrysDepositLibrary()",
+                  "singCrysCheckpoint004", FatalException, msg);
+    }
+  }
+  file.open(fileName.c_str(), std::ios::binary |
+    (resuming ? std::ios::app : std::ios::trunc));
+  if (!file)
+  {
+    G4cerr << "Cannot open deposit library " << fileName
+      << ". No deposits are written." << G4endl;
+    return;
+  }
+  enabled = true;
+  file.seekp(0, std::ios::end);
+  if (file.tellp() == 0)
+  {
+    uint32_t version = 1;
+    file.write("SCDL", 4);
+    file.write((const char*) &version, sizeof(version));
+  }
+}
+
+// Destructor
+singCrysDepositLibrary::~singCrysDepositLibrary()
+{
+  if (file.is_open()) file.close();
+}
+
+// Returns the pointer to the singleton class.
+singCrysDepositLibrary* singCrysDepositLibrary::GetInstance()
+{
+  static singCrysDepositLibrary pInstance;
+  return &pInstance;
+}
+
+// Buffers a deposit in the units of the file
+void singCrysDepositLibrary::AddDeposit(const G4ThreeVector& position,
+                                        G4double energy, G4double time)
+{
+  deposits.push_back(position.x() / mm);
+  deposits.push_back(position.y() / mm);
+  deposits.push_back(position.z() / mm);
+  deposits.push_back(energy / keV);
+  deposits.push_back(time / ns);
+}
+
+// Writes the record of the event
+void singCrysDepositLibrary::EndOfEvent(G4int eventID)
+{
+  if (!enabled) return;
+  int32_t id = eventID;
+  uint32_t n = deposits.size() / 5;
+  file.write((const char*) &id, sizeof(id));
+  file.write((const char*) &n, sizeof(n));
+  if (n > 0)
+    file.write((const char*) &deposits[0], deposits.size() * sizeof(float));
+  deposits.clear();
+}
+
+// Writes the stream buffer
+void singCrysDepositLibrary::Flush()
+{
+  if (enabled) file.flush();
+}
+
+// Length of the file, once flushed
+G4long singCrysDepositLibrary::GetLength()
+{
+  return enabled ? (G4long) file.tellp() : 0;
+}
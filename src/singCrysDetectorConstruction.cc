@@ -8,39 +8,141 @@
 
 #include "G4NistManager.hh"
 #include "G4RunManager.hh"
+#include "G4StateManager.hh"
+#include "G4UImanager.hh"
+#include "G4VVisManager.hh"
 #include "G4SDManager.hh"
 #include "G4SystemOfUnits.hh"
 
 #include "G4Box.hh"
 #include "G4Polyhedra.hh"
+#include "G4Tubs.hh"
 #include "G4LogicalVolume.hh"
 #include "G4PVPlacement.hh"
 #include "G4SubtractionSolid.hh"
+#include "G4UserLimits.hh"
+#include "G4Region.hh"
+#include "G4ProductionCuts.hh"
+#include "G4GeometryManager.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4SolidStore.hh"
+#include "G4FastSimulationManager.hh"
 
 #include "singCrysSiliconSD.hh"
+#include "singCrysCrystalSD.hh"
+#include "singCrysDepositLibrary.hh"
+#include "singCrysOverlapChecker.hh"
+#include "singCrysDetectorMessenger.hh"
+#include "singCrysPhysicsProfile.hh"
+#include "singCrysPrismTransport.hh"
 
 #include "G4OpticalSurface.hh"
 #include "G4LogicalBorderSurface.hh"
 #include "G4LogicalSkinSurface.hh"
+#include "G4SurfaceProperty.hh"
 
 #include "singCrysConfig.hh"
 #include "singCrysReadFile.hh"
+#include "singCrysUniformPropertyVector.hh"
 #include <boost/program_options.hpp>
+#include <algorithm>
 
 // Constructor: define materials
 singCrysDetectorConstruction::singCrysDetectorConstruction()
 : G4VUserDetectorConstruction()
 { 
   DefineMaterials();
-  // Define new sensitive detector
+  // Define new sensitive detector. It is kept when the geometry is rebuilt.
   siliconSD = new singCrysSiliconSD("singCrys/siliconSD",
     "SiliconHitsCollection");
   G4SDManager::GetSDMpointer()->AddNewDetector(siliconSD);
+  // The deposits in the crystal are only recorded for the deposit library
+  crystalSD = 0;
+  if (singCrysDepositLibrary::GetInstance()->IsEnabled())
+  {
+    crystalSD = new singCrysCrystalSD("singCrys/crystalSD");
+    G4SDManager::GetSDMpointer()->AddNewDetector(crystalSD);
+  }
+  // The fast optical model is made with the crystal region
+  prismTransport = 0;
+  // Commands to change the geometry
+  messenger = new singCrysDetectorMessenger(this);
+  // Cuts and limits of the regions, set when the regions are made
+  for (G4int i = 0; i < singCrysPhysicsProfile::kNRegions; i++)
+  {
+    regions[i] = 0;
+    regionCuts[i] = new G4ProductionCuts();
+    regionLimits[i] = new G4UserLimits();
+  }
 }
 
-// Destructor: nothing to delete
+// Destructor: delete the messenger, and the cuts and limits of the regions
 singCrysDetectorConstruction::~singCrysDetectorConstruction()
-{ }
+{
+  delete messenger;
+  for (G4int i = 0; i < singCrysPhysicsProfile::kNRegions; i++)
+  {
+    delete regionCuts[i];
+    delete regionLimits[i];
+  }
+}
+
+// Deletes the geometry and builds it again from the current options
+void singCrysDetectorConstruction::Rebuild()
+{
+  // Before /run/initialize, the geometry has not been built yet, and will be
+  // built with the current options.
+  G4StateManager* stateManager = G4StateManager::GetStateManager();
+  if (stateManager->GetCurrentState() == G4State_PreInit)
+  {
+    G4cout << "The geometry will be built at initialization." << G4endl;
+    return;
+  }
+
+  // Delete the volumes, solids, and surfaces. Pointers to the surfaces must
+  // not be used until they are made again.
+  G4GeometryManager::GetInstance()->OpenGeometry();
+  G4PhysicalVolumeStore::Clean();
+  G4LogicalVolumeStore::Clean();
+  G4SolidStore::Clean();
+  G4LogicalSkinSurface::CleanSurfaceTable();
+  G4LogicalBorderSurface::CleanSurfaceTable();
+  G4SurfaceProperty::CleanSurfacePropertyTable();
+  // The fast optical model refers to the crystal region and its surfaces.
+  // Its manager must go before the region.
+  if (prismTransport)
+  {
+    delete regions[singCrysPhysicsProfile::kCrystalRegion]->
+      GetFastSimulationManager();
+    delete prismTransport;
+    prismTransport = 0;
+  }
+  // The regions refer to the deleted volumes. Their cuts and limits are kept.
+  for (G4int i = 0; i < singCrysPhysicsProfile::kNRegions; i++)
+  {
+    delete regions[i];
+    regions[i] = 0;
+  }
+
+  // Delete the properties tables of the surfaces. The materials keep
+  // theirs, since the physics tables built for them (e.g. by G4OpRayleigh)
+  // refer to their property vectors.
+  for (size_t i = 0; i < surfaceTables.size(); i++)
+    delete surfaceTables[i];
+  surfaceTables.clear();
+
+  // Build the new geometry. The run manager closes it and updates the
+  // couples at the next run. Only couples of new materials need new physics
+  // tables.
+  G4RunManager* runManager = G4RunManager::GetRunManager();
+  runManager->DefineWorldVolume(Construct());
+  runManager->GeometryHasBeenModified();
+  // The current scene refers to the deleted world volume, so replace it
+  if (G4VVisManager::GetConcreteInstance())
+    G4UImanager::GetUIpointer()->ApplyCommand("/vis/drawVolume");
+  G4cout << "Geometry rebuilt." << G4endl;
+}
 
 // Defines LYSO material
 void singCrysDetectorConstruction::DefineMaterials()
@@ -286,8 +388,20 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
   // Also get config file parameters
   po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
 
-  // Check overlaps in volumes
-  G4bool checkOverlaps = config["checkOverlaps"].as<G4bool>();
+  // Overlaps are not checked at each placement, but for the whole geometry
+  // at the end, by singCrysOverlapChecker
+  G4bool checkOverlaps = false;
+
+  // How to build the volumes with cut-outs: as boolean solids, or
+  // decomposed into simple solids with the same surfaces, which are much
+  // faster to navigate.
+  G4String geometryMode = (G4String) config["geometryMode"].as<std::string>();
+  G4bool decomposed = geometryMode.compareTo("decomposed") == 0;
+  if (!decomposed && geometryMode.compareTo("boolean") != 0)
+  {
+    G4cerr << "Unknown geometry mode " << geometryMode << ". Using boolean."
+      << G4endl;
+  }
 
   // Number of APDs
   G4int nAPD = config["nAPD"].as<G4int>();
@@ -350,6 +464,12 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
   // the interior angles of the polygon divided by the number of sides,
   // divided by two.
   G4double rotation = (crysNumSides - 2) * pi / (2 * crysNumSides);
+  // Prisms are made by makePrism(), which may use a cheaper solid than
+  // G4Polyhedra
+  numSides = crysNumSides;
+  prismRotation = rotation;
+  specializeSolids = config["specializeSolids"].as<G4bool>();
+  tubsMinSides = config["tubsMinSides"].as<G4int>();
   // Parameters for two other polyhedra to serve as layers surrounding the
   // crystal. The first will be 'layer1Thick' larger than the crystal, and the
   // second will be 'layer2Thick' larger than the first. The crystal will be
@@ -436,64 +556,87 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
   G4Material* coating2Mat = nist->FindOrBuildMaterial(coating2MatStr);
 
   // Get the material properties tables for all of the materials that
-  // interact with optical photons.
-  crysMat->SetMaterialPropertiesTable(generateTable(crysMatStr));
-  layer1Mat->SetMaterialPropertiesTable(generateTable(layer1MatStr));
-  layer2Mat->SetMaterialPropertiesTable(generateTable(layer2MatStr));
-  layer1InsertMat->
-    SetMaterialPropertiesTable(generateTable(layer1InsertMatStr));
-  worldMat->SetMaterialPropertiesTable(generateTable(worldMatStr));
-  epoxyMat->SetMaterialPropertiesTable(generateTable(epoxyMatStr));
-  APDAlCaseMat->SetMaterialPropertiesTable(generateTable(APDAlCaseMatStr));
-  coating1Mat->SetMaterialPropertiesTable(generateTable(coating1MatStr));
-  coating2Mat->SetMaterialPropertiesTable(generateTable(coating2MatStr));
+  // interact with optical photons. A material gets its table only once;
+  // later changes of the properties are copied into it by UpdateOptics().
+  setTable(crysMat, crysMatStr);
+  setTable(layer1Mat, layer1MatStr);
+  setTable(layer2Mat, layer2MatStr);
+  setTable(layer1InsertMat, layer1InsertMatStr);
+  setTable(worldMat, worldMatStr);
+  setTable(epoxyMat, epoxyMatStr);
+  setTable(APDAlCaseMat, APDAlCaseMatStr);
+  setTable(coating1Mat, coating1MatStr);
+  setTable(coating2Mat, coating2MatStr);
 
   // Define the necessary solids for the geometry.
+  // Offsets along z of the origins of the prism solids from the origins of
+  // the equivalent G4Polyhedra. They are nonzero for the centered G4Box and
+  // G4Tubs, and are used to correct placements and subtractions.
+  G4double crysZOffset, layer1ZOffset, layer2ZOffset, coating1ZOffset,
+    coating2ZOffset;
+  G4double caseZOffset = 0., ringZOffset = 0., slotZOffset = 0.,
+    bottomZOffset = 0.;
   // Define world
   G4Box* solidWorld = new G4Box("World",
                                 0.5 * worldSizeXY,
                                 0.5 * worldSizeXY,
                                 0.5 * worldSizeZ);
   // Define crystal
-  G4Polyhedra* solidCrys = new G4Polyhedra("Crystal",
-                                           rotation,
-                                           2*pi + rotation,
-                                           crysNumSides,
-                                           2,
-                                           crysZPlaneCoords,
-                                           crysRInner,
-                                           crysROuter);
+  G4VSolid* solidCrys = makePrism("Crystal",
+                                  crysZPlaneCoords,
+                                  crysRInner,
+                                  crysROuter,
+                                  crysZOffset);
   // Layers surroudning crystals
-  G4Polyhedra* solidLayer1full = new G4Polyhedra("Layer 1 Full",
-                                                 rotation,
-                                                 2*pi + rotation,
-                                                 crysNumSides,
-                                                 2,
-                                                 layer1ZPlaneCoords,
-                                                 crysRInner,
-                                                 layer1ROuter);
-
-  G4Polyhedra* solidLayer2 = new G4Polyhedra("Layer 2",
-                                            rotation,
-                                            2*pi + rotation,
-                                            crysNumSides,
-                                            2,
-                                            layer2ZPlaneCoords,
-                                            crysRInner,
-                                            layer2ROuter);
+  G4VSolid* solidLayer1full = makePrism("Layer 1 Full",
+                                        layer1ZPlaneCoords,
+                                        crysRInner,
+                                        layer1ROuter,
+                                        layer1ZOffset);
+
+  G4VSolid* solidLayer2 = makePrism("Layer 2",
+                                    layer2ZPlaneCoords,
+                                    crysRInner,
+                                    layer2ROuter,
+                                    layer2ZOffset);
   // Solid to be subtracted from layer1 in order to vary the surface of the
-  // crystal.
-  G4Box* solidLayer1Insert = new G4Box("Layer 1 Insert",
-                                       crysSideLength * 0.5,
-                                       layer1Thick * 0.5,
-                                       crysSizeZ * 0.5);
+  // crystal. When the prisms are cylinders, it is the sector of layer1
+  // facing the top side.
+  G4VSolid* solidLayer1Insert;
+  if (prismShape(0.) == kTubs)
+  {
+    G4double factor = tubsRadiusFactor();
+    solidLayer1Insert = new G4Tubs("Layer 1 Insert",
+                                   crysRadLen * factor,
+                                   layer1RadLen * factor,
+                                   crysSizeZ * 0.5,
+                                   0.5 * pi - pi / crysNumSides,
+                                   2 * pi / crysNumSides);
+    translInsert = G4ThreeVector();
+  }
+  else
+  {
+    solidLayer1Insert = new G4Box("Layer 1 Insert",
+                                  crysSideLength * 0.5,
+                                  layer1Thick * 0.5,
+                                  crysSizeZ * 0.5);
+  }
   // Subtract the insert from the current layer1 to obtain the final layer1
-  // solid.
-  G4SubtractionSolid* solidLayer1 = new G4SubtractionSolid("Layer 1",
-                                                           solidLayer1full,
-                                                           solidLayer1Insert,
-                                                           0,
-                                                           translInsert);
+  // solid. In decomposed mode, the insert is placed inside the full layer1
+  // instead, which gives the same surfaces: a photon leaving the insert
+  // through a face on the surface of layer1 also leaves layer1, and its
+  // next volume is layer2, as with the notch.
+  G4VSolid* solidLayer1 = solidLayer1full;
+  if (!decomposed)
+  {
+    G4ThreeVector insertInLayer1 = translInsert - G4ThreeVector(0., 0.,
+      layer1ZOffset);
+    solidLayer1 = new G4SubtractionSolid("Layer 1",
+                                         solidLayer1full,
+                                         solidLayer1Insert,
+                                         0,
+                                         insertInLayer1);
+  }
 
   // Define solids for APD
   G4Box* solidAPD = new G4Box("APD",
@@ -523,65 +666,106 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
 
   // Aluminum casing for APD. Make it by subtracting out the overlap with
   // the crystal and the APD itself.
-  G4Polyhedra* solidAlAPDCaseFull = new G4Polyhedra("AlAPDCaseFull",
-                                                    rotation,
-                                                    2*pi + rotation,
-                                                    crysNumSides,
-                                                    2,
-                                                    APDAlCaseZPlaneCoords,
-                                                    crysRInner,
-                                                    APDAlCaseROuter);
-  // Subtract the crystal from the APD case.
-  G4SubtractionSolid* solidAlAPDCaseMid =
-    new G4SubtractionSolid("AlAPDCaseMid",
-                           solidAlAPDCaseFull,
-                           solidLayer2,
-                           0,
-                           translCrysAPDCase);
-  // Subtract the APD(s) from the aluminum case.
-  G4SubtractionSolid* solidAlAPDCase;
-  // If one APD, subtract it centered in the aluminum case
-  if (nAPD == 1)
+  // In decomposed mode, it is made of three stacked polyhedra instead: a
+  // ring around the bottom of layer 2 and the coatings, a slab in which the
+  // APD(s) are placed, and a slab below the APD(s). All z coordinates are
+  // relative to the center of the case.
+  // Bottom of the pocket for the crystal and coatings
+  G4double APDAlCasePocketZ = 0.5 * APDAlCaseZ - APDSlotDepth - AlCoating1Z
+    - AlCoating2Z;
+  // Bottom of the APD(s)
+  G4double APDAlCaseAPDZ = APDAlCasePocketZ - casingZ;
+  if (decomposed && APDAlCaseAPDZ < -0.5 * APDAlCaseZ)
+  {
+    G4cerr << "The APDs stick out of the aluminum case, which cannot be "
+      << "decomposed. Using a boolean solid for the case." << G4endl;
+  }
+  G4bool decomposedCase = decomposed && APDAlCaseAPDZ >= -0.5 * APDAlCaseZ;
+  G4VSolid* solidAlAPDCase = 0;
+  G4VSolid* solidAlAPDCaseRing = 0;
+  G4VSolid* solidAlAPDCaseSlot = 0;
+  G4VSolid* solidAlAPDCaseBottom = 0;
+  if (decomposedCase)
   {
-    solidAlAPDCase = new G4SubtractionSolid("AlAPDCase",
-                                            solidAlAPDCaseMid,
-                                            solidAPD,
-                                            0,
-                                            translAPDCase);
+    G4double ringZPlaneCoords[2] = {APDAlCasePocketZ, 0.5 * APDAlCaseZ};
+    G4double ringRInner[2] = {layer2RadLen, layer2RadLen};
+    G4double slotZPlaneCoords[2] = {APDAlCaseAPDZ, APDAlCasePocketZ};
+    G4double bottomZPlaneCoords[2] = {-0.5 * APDAlCaseZ, APDAlCaseAPDZ};
+    if (APDAlCasePocketZ < 0.5 * APDAlCaseZ)
+    {
+      solidAlAPDCaseRing = makePrism("AlAPDCaseRing",
+                                     ringZPlaneCoords,
+                                     ringRInner,
+                                     APDAlCaseROuter,
+                                     ringZOffset);
+    }
+    solidAlAPDCaseSlot = makePrism("AlAPDCaseSlot",
+                                   slotZPlaneCoords,
+                                   crysRInner,
+                                   APDAlCaseROuter,
+                                   slotZOffset);
+    if (APDAlCaseAPDZ > -0.5 * APDAlCaseZ)
+    {
+      solidAlAPDCaseBottom = makePrism("AlAPDCaseBottom",
+                                       bottomZPlaneCoords,
+                                       crysRInner,
+                                       APDAlCaseROuter,
+                                       bottomZOffset);
+    }
   }
-  // If two APDs, subtract two of them.
   else
   {
-    G4SubtractionSolid* solidAlAPDCaseMidAPD =
-        new G4SubtractionSolid("APDAlCaseMidAPD",
-                            solidAlAPDCaseMid,
-                            solidAPD,
-                            0,
-                            translAPDCase + G4ThreeVector(-casingX / 2, 0, 0));
-    solidAlAPDCase =
-        new G4SubtractionSolid("APDAlCase",
-                            solidAlAPDCaseMidAPD,
-                            solidAPD,
-                            0,
-                            translAPDCase + G4ThreeVector(casingX / 2, 0, 0));
+    G4VSolid* solidAlAPDCaseFull = makePrism("AlAPDCaseFull",
+                                             APDAlCaseZPlaneCoords,
+                                             crysRInner,
+                                             APDAlCaseROuter,
+                                             caseZOffset);
+    // Subtract the crystal from the APD case.
+    G4SubtractionSolid* solidAlAPDCaseMid =
+      new G4SubtractionSolid("AlAPDCaseMid",
+                             solidAlAPDCaseFull,
+                             solidLayer2,
+                             0,
+                             translCrysAPDCase + G4ThreeVector(0., 0.,
+                               layer2ZOffset - caseZOffset));
+    // Subtract the APD(s) from the aluminum case.
+    // If one APD, subtract it centered in the aluminum case
+    if (nAPD == 1)
+    {
+      solidAlAPDCase = new G4SubtractionSolid("AlAPDCase",
+                                              solidAlAPDCaseMid,
+                                              solidAPD,
+                                              0,
+                                              translAPDCase);
+    }
+    // If two APDs, subtract two of them.
+    else
+    {
+      G4SubtractionSolid* solidAlAPDCaseMidAPD =
+          new G4SubtractionSolid("APDAlCaseMidAPD",
+                              solidAlAPDCaseMid,
+                              solidAPD,
+                              0,
+                              translAPDCase + G4ThreeVector(-casingX / 2, 0, 0));
+      solidAlAPDCase =
+          new G4SubtractionSolid("APDAlCase",
+                              solidAlAPDCaseMidAPD,
+                              solidAPD,
+                              0,
+                              translAPDCase + G4ThreeVector(casingX / 2, 0, 0));
+    }
   }
   // Solids for the coatings for the APD case
-  G4Polyhedra* solidAlCoating1 = new G4Polyhedra("AlCoating1",
-                                                 rotation,
-                                                 2*pi + rotation,
-                                                 crysNumSides,
-                                                 2,
-                                                 AlCoating1ZPlaneCoords,
-                                                 crysRInner,
-                                                 layer2ROuter);
-  G4Polyhedra* solidAlCoating2 = new G4Polyhedra("AlCoating1",
-                                                 rotation,
-                                                 2*pi + rotation,
-                                                 crysNumSides,
-                                                 2,
-                                                 AlCoating2ZPlaneCoords,
-                                                 crysRInner,
-                                                 layer2ROuter);
+  G4VSolid* solidAlCoating1 = makePrism("AlCoating1",
+                                        AlCoating1ZPlaneCoords,
+                                        crysRInner,
+                                        layer2ROuter,
+                                        coating1ZOffset);
+  G4VSolid* solidAlCoating2 = makePrism("AlCoating1",
+                                        AlCoating2ZPlaneCoords,
+                                        crysRInner,
+                                        layer2ROuter,
+                                        coating2ZOffset);
 
   // Define the logical volumes from the solids created above
   G4LogicalVolume* logicWorld = new G4LogicalVolume(solidWorld,
@@ -610,9 +794,34 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
   G4LogicalVolume* logicSilicon = new G4LogicalVolume(solidSilicon,
                                                       siliconMat,
                                                       "Silicon");
-  G4LogicalVolume* logicAlAPDCase = new G4LogicalVolume(solidAlAPDCase,
-                                                       APDAlCaseMat,
-                                                       "AlAPDCase");
+  G4LogicalVolume* logicAlAPDCase = 0;
+  G4LogicalVolume* logicAlAPDCaseRing = 0;
+  G4LogicalVolume* logicAlAPDCaseSlot = 0;
+  G4LogicalVolume* logicAlAPDCaseBottom = 0;
+  if (solidAlAPDCase)
+  {
+    logicAlAPDCase = new G4LogicalVolume(solidAlAPDCase,
+                                         APDAlCaseMat,
+                                         "AlAPDCase");
+  }
+  if (solidAlAPDCaseRing)
+  {
+    logicAlAPDCaseRing = new G4LogicalVolume(solidAlAPDCaseRing,
+                                             APDAlCaseMat,
+                                             "AlAPDCaseRing");
+  }
+  if (solidAlAPDCaseSlot)
+  {
+    logicAlAPDCaseSlot = new G4LogicalVolume(solidAlAPDCaseSlot,
+                                             APDAlCaseMat,
+                                             "AlAPDCaseSlot");
+  }
+  if (solidAlAPDCaseBottom)
+  {
+    logicAlAPDCaseBottom = new G4LogicalVolume(solidAlAPDCaseBottom,
+                                               APDAlCaseMat,
+                                               "AlAPDCaseBottom");
+  }
   G4LogicalVolume* logicAlCoating1 = new G4LogicalVolume(solidAlCoating1,
                                                          coating1Mat,
                                                          "AlCoating1");
@@ -634,7 +843,9 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
 
   // Place crystal and layers 
   G4VPhysicalVolume* physCrys = new G4PVPlacement(0,
-                                                  G4ThreeVector(),
+                                                  G4ThreeVector(0., 0.,
+                                                    crysZOffset -
+                                                    layer1ZOffset),
                                                   logicCrys,
                                                   "Crystal",
                                                   logicLayer1,
@@ -643,7 +854,9 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
                                                   checkOverlaps);
 
   G4VPhysicalVolume* physLayer1 = new G4PVPlacement(0,
-                                                    G4ThreeVector(),
+                                                    G4ThreeVector(0., 0.,
+                                                      layer1ZOffset -
+                                                      layer2ZOffset),
                                                     logicLayer1,
                                                     "Layer 1",
                                                     logicLayer2,
@@ -651,18 +864,25 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
                                                     0,
                                                     checkOverlaps);
   G4VPhysicalVolume* physLayer2 = new G4PVPlacement(0,
-                                                    G4ThreeVector(),
+                                                    G4ThreeVector(0., 0.,
+                                                      layer2ZOffset),
                                                     logicLayer2,
                                                     "Layer 2",
                                                     logicWorld,
                                                     false,
                                                     0,
                                                     checkOverlaps);
+  // The insert sits in the notch of layer 1, or inside the full layer 1 in
+  // decomposed mode. Layer 1 is placed at the origin of layer 2, so the
+  // translation is the same.
+  G4LogicalVolume* logicInsertMother = decomposed ? logicLayer1 : logicLayer2;
+  G4ThreeVector insertPos = translInsert - G4ThreeVector(0., 0.,
+    decomposed ? layer1ZOffset : layer2ZOffset);
   G4VPhysicalVolume* physLayer1Insert = new G4PVPlacement(0,
-                                                          translInsert,
+                                                          insertPos,
                                                           logicLayer1Insert,
                                                           "Layer 1 Insert",
-                                                          logicLayer2,
+                                                          logicInsertMother,
                                                           false,
                                                           0,
                                                           checkOverlaps);
@@ -693,7 +913,8 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
                                                     checkOverlaps);
   // Place coatings on aluminum APD case
   G4VPhysicalVolume* physAlCoating1 = new G4PVPlacement(0,
-                                                        G4ThreeVector(),
+                                                        G4ThreeVector(0., 0.,
+                                                          coating1ZOffset),
                                                         logicAlCoating1,
                                                         "AlCoating1",
                                                         logicWorld,
@@ -702,14 +923,22 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
                                                         checkOverlaps);
 
   G4VPhysicalVolume* physAlCoating2 = new G4PVPlacement(0,
-                                                        G4ThreeVector(),
+                                                        G4ThreeVector(0., 0.,
+                                                          coating2ZOffset),
                                                         logicAlCoating2,
                                                         "AlCoating2",
                                                         logicWorld,
                                                         false,
                                                         0,
                                                         checkOverlaps);
-  // Place APD(s) in the world volume
+  // Place APD(s) in the world volume, or in the slot of the aluminum case
+  // in decomposed mode
+  G4LogicalVolume* logicAPDMother = logicWorld;
+  if (decomposedCase)
+  {
+    logicAPDMother = logicAlAPDCaseSlot;
+    APDPlaceZ -= APDCasePlacementZ + slotZOffset;
+  }
   if (nAPD == 1)
   {
     G4VPhysicalVolume* physAPD =
@@ -717,7 +946,7 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
                           G4ThreeVector(0.0*mm, 0.0*mm, APDPlaceZ),
                           logicAPD,
                           "APD",
-                          logicWorld,
+                          logicAPDMother,
                           false,
                           0,
                           checkOverlaps);
@@ -729,7 +958,7 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
                           G4ThreeVector(-casingX / 2, 0.0*mm, APDPlaceZ),
                           logicAPD,
                           "APD",
-                          logicWorld,
+                          logicAPDMother,
                           false,
                           0,
                           checkOverlaps);
@@ -738,21 +967,82 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
                           G4ThreeVector(casingX / 2, 0.0*mm, APDPlaceZ),
                           logicAPD,
                           "APD",
-                          logicWorld,
+                          logicAPDMother,
                           false,
                           1,
                           checkOverlaps);
   }
-  // Place Al APD case in the world volume.
-  G4VPhysicalVolume* physAlAPDCase =
+  // Place Al APD case, or its pieces, in the world volume.
+  G4VPhysicalVolume* physAlAPDCase = 0;
+  G4VPhysicalVolume* physAlAPDCaseRing = 0;
+  G4VPhysicalVolume* physAlAPDCaseSlot = 0;
+  if (logicAlAPDCase)
+  {
+    physAlAPDCase = new G4PVPlacement(0,
+                                      G4ThreeVector(0., 0.,
+                                        APDCasePlacementZ + caseZOffset),
+                                      logicAlAPDCase,
+                                      "AlAPDCase",
+                                      logicWorld,
+                                      false,
+                                      0,
+                                      checkOverlaps);
+  }
+  if (logicAlAPDCaseRing)
+  {
+    physAlAPDCaseRing =
+      new G4PVPlacement(0,
+                        G4ThreeVector(0., 0., APDCasePlacementZ + ringZOffset),
+                        logicAlAPDCaseRing,
+                        "AlAPDCaseRing",
+                        logicWorld,
+                        false,
+                        0,
+                        checkOverlaps);
+  }
+  if (logicAlAPDCaseSlot)
+  {
+    physAlAPDCaseSlot =
+      new G4PVPlacement(0,
+                        G4ThreeVector(0., 0., APDCasePlacementZ + slotZOffset),
+                        logicAlAPDCaseSlot,
+                        "AlAPDCaseSlot",
+                        logicWorld,
+                        false,
+                        0,
+                        checkOverlaps);
+  }
+  if (logicAlAPDCaseBottom)
+  {
     new G4PVPlacement(0,
-                      G4ThreeVector(0.,0.,APDCasePlacementZ),
-                      logicAlAPDCase,
-                      "AlAPDCase",
+                      G4ThreeVector(0., 0.,
+                        APDCasePlacementZ + bottomZOffset),
+                      logicAlAPDCaseBottom,
+                      "AlAPDCaseBottom",
                       logicWorld,
                       false,
                       0,
                       checkOverlaps);
+  }
+
+  // Group the volumes in regions, with their own cuts and limits. The
+  // crystal and the APDs are placed in passive volumes, but are roots of
+  // their own regions.
+  setupRegion(singCrysPhysicsProfile::kCrystalRegion,
+              std::vector<G4LogicalVolume*>(1, logicCrys));
+  setupRegion(singCrysPhysicsProfile::kAPDRegion,
+              std::vector<G4LogicalVolume*>(1, logicAPD));
+  std::vector<G4LogicalVolume*> passiveVolumes;
+  passiveVolumes.push_back(logicLayer1);
+  passiveVolumes.push_back(logicLayer2);
+  passiveVolumes.push_back(logicLayer1Insert);
+  passiveVolumes.push_back(logicAlCoating1);
+  passiveVolumes.push_back(logicAlCoating2);
+  if (logicAlAPDCase) passiveVolumes.push_back(logicAlAPDCase);
+  if (logicAlAPDCaseRing) passiveVolumes.push_back(logicAlAPDCaseRing);
+  if (logicAlAPDCaseSlot) passiveVolumes.push_back(logicAlAPDCaseSlot);
+  if (logicAlAPDCaseBottom) passiveVolumes.push_back(logicAlAPDCaseBottom);
+  setupRegion(singCrysPhysicsProfile::kPassiveRegion, passiveVolumes);
 
   // Define the optical boundaries between physical volumes
   // Get a few parameters
@@ -834,6 +1124,8 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
   optSilicon->SetFinish(polished);
   optSilicon->SetType(surfaceType(siliconMatStr));
   optSilicon->SetMaterialPropertiesTable(generateSiSurfaceTable());
+  resampleTable(optSilicon->GetMaterialPropertiesTable(), "silicon surface");
+  surfaceTables.push_back(optSilicon->GetMaterialPropertiesTable());
   G4LogicalSurface* skinSilicon = new G4LogicalSkinSurface("skinSilicon",
     logicSilicon, optSilicon);
 
@@ -845,6 +1137,7 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
   optCasing->SetSigmaAlpha(0.0);
   optCasing->SetType(surfaceType(casingMatStr));
   optCasing->SetMaterialPropertiesTable(generateCeramicTable());
+  surfaceTables.push_back(optCasing->GetMaterialPropertiesTable());
   G4LogicalSkinSurface* skinCasing = new G4LogicalSkinSurface("optCasing",
     logicCasing, optCasing);
 
@@ -855,12 +1148,316 @@ G4VPhysicalVolume* singCrysDetectorConstruction::Construct()
   OpCoat2APDCaseSurface->SetType(surfaceType(APDAlCaseMatStr,
     coating2MatStr));
   OpCoat2APDCaseSurface->SetFinish(polished);
-  G4LogicalBorderSurface* Coat2APDCaseSurface = new
-  G4LogicalBorderSurface("Coating2APDCaseSurface", physAlCoating2,
-    physAlAPDCase, OpCoat2APDCaseSurface);
+  // In decomposed mode, coating 2 touches the ring (sides) and the slot
+  // (bottom) of the case.
+  if (physAlAPDCase)
+  {
+    new G4LogicalBorderSurface("Coating2APDCaseSurface", physAlCoating2,
+      physAlAPDCase, OpCoat2APDCaseSurface);
+  }
+  if (physAlAPDCaseRing)
+  {
+    new G4LogicalBorderSurface("Coating2APDCaseRingSurface", physAlCoating2,
+      physAlAPDCaseRing, OpCoat2APDCaseSurface);
+  }
+  if (physAlAPDCaseSlot)
+  {
+    new G4LogicalBorderSurface("Coating2APDCaseSlotSurface", physAlCoating2,
+      physAlAPDCaseSlot, OpCoat2APDCaseSurface);
+  }
+ 
+  // Remember the surfaces whose parameters can be changed between runs
+  insertSurfaces[0] = OpCrysLayer1InsSurface;
+  insertSurfaces[1] = OpLayer1InsCrysSurface;
+  crystalSurfaces[0] = OpCrysLayer1Surface;
+  crystalSurfaces[1] = OpLayer1CrysSurface;
+  siliconSurface = optSilicon;
+  casingSurface = optCasing;
+
+  // Track the optical photons in the crystal analytically. A cylinder has no
+  // faces to trace.
+  if (config["prismTransport"].as<G4bool>())
+  {
+    if (prismShape(0.) == kTubs)
+    {
+      G4cerr << "prismTransport does not apply to a cylindrical crystal. "
+        << "Using full tracking." << G4endl;
+    }
+    else
+    {
+      prismTransport = new singCrysPrismTransport("singCrys/prismTransport",
+        regions[singCrysPhysicsProfile::kCrystalRegion], crysNumSides,
+        crysRadLen, 0.5 * crysSizeZ, crysMat, layer1Mat, layer1InsertMat,
+        OpCrysLayer1Surface, OpCrysLayer1InsSurface);
+    }
+  }
  
   // Assign the sensitive detector to epoxy 
   logicEpoxy->SetSensitiveDetector(siliconSD);
+  if (crystalSD) logicCrys->SetSensitiveDetector(crystalSD);
+
+  // Check overlaps in volumes
+  if (config["checkOverlaps"].as<G4bool>())
+  {
+    singCrysOverlapChecker checker;
+    checker.Check(physWorld);
+  }
 
   return physWorld;
 }
+
+// Makes a region, with the current values of its options
+void singCrysDetectorConstruction::
+  setupRegion(singCrysPhysicsProfile::Region region,
+              const std::vector<G4LogicalVolume*>& roots)
+{
+  singCrysPhysicsProfile* profile = singCrysPhysicsProfile::GetInstance();
+  regionCuts[region]->SetProductionCut(profile->GetRegionCut(region));
+  G4double maxStep = profile->GetRegionMaxStep(region);
+  regionLimits[region]->SetMaxAllowedStep(maxStep > 0. ? maxStep : DBL_MAX);
+  regionLimits[region]->SetUserMinEkine(profile->GetRegionMinEkin(region));
+  regions[region] = new G4Region("singCrys/" +
+    singCrysPhysicsProfile::GetRegionName(region));
+  regions[region]->SetProductionCuts(regionCuts[region]);
+  regions[region]->SetUserLimits(regionLimits[region]);
+  for (size_t i = 0; i < roots.size(); i++)
+    regions[region]->AddRootLogicalVolume(roots[i]);
+}
+
+// Gives a material its properties table, unless it already has one
+void singCrysDetectorConstruction::setTable(G4Material* material,
+                                            G4String materialStr)
+{
+  if (opticalMaterials.count(material)) return;
+  G4MaterialPropertiesTable* table = generateTable(materialStr);
+  resampleTable(table, materialStr);
+  material->SetMaterialPropertiesTable(table);
+  opticalMaterials[material] = materialStr;
+}
+
+// Regenerates the properties tables and surface parameters from the current
+// options, and copies them into the existing objects
+void singCrysDetectorConstruction::UpdateOptics()
+{
+  // Before /run/initialize, there is nothing to update
+  if (opticalMaterials.empty())
+  {
+    G4cout << "The optical properties will be set at initialization."
+      << G4endl;
+    return;
+  }
+  // Materials
+  std::map<G4Material*, G4String>::iterator mat;
+  for (mat = opticalMaterials.begin(); mat != opticalMaterials.end(); mat++)
+  {
+    G4MaterialPropertiesTable* newTable = generateTable(mat->second);
+    resampleTable(newTable, mat->second);
+    copyProperties(mat->first->GetMaterialPropertiesTable(), newTable,
+                   mat->second);
+    delete newTable;
+  }
+
+  // Surfaces. Their properties are only used by G4OpBoundaryProcess, which
+  // reads them at every step.
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  G4OpticalSurfaceFinish insFinish = finishType((G4String)
+    config["crysLayer1InsSurfFinish"].as<std::string>());
+  G4double insSigAlpha = config["crysLayer1InsSurfSigAlpha"].as<G4double>();
+  G4OpticalSurfaceFinish crysFinish = finishType((G4String)
+    config["crysLayer1SurfFinish"].as<std::string>());
+  G4double crysSigAlpha = config["crysLayer1SurfSigAlpha"].as<G4double>();
+  for (G4int i = 0; i < 2; i++)
+  {
+    insertSurfaces[i]->SetFinish(insFinish);
+    insertSurfaces[i]->SetSigmaAlpha(insSigAlpha);
+    crystalSurfaces[i]->SetFinish(crysFinish);
+    crystalSurfaces[i]->SetSigmaAlpha(crysSigAlpha);
+  }
+  G4MaterialPropertiesTable* newTable = generateSiSurfaceTable();
+  resampleTable(newTable, "silicon surface");
+  copyProperties(siliconSurface->GetMaterialPropertiesTable(), newTable,
+                 "silicon surface");
+  delete newTable;
+  newTable = generateCeramicTable();
+  copyProperties(casingSurface->GetMaterialPropertiesTable(), newTable,
+                 "casing surface");
+  delete newTable;
+  G4cout << "Optical properties updated." << G4endl;
+}
+
+// Replaces the property vectors of a table by copies on uniform grids, if
+// 'opticalLUT' is set. Vectors with two points are already linear and have
+// a single bin, so they are kept.
+void singCrysDetectorConstruction::
+  resampleTable(G4MaterialPropertiesTable* table, G4String owner)
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  if (!config["opticalLUT"].as<G4bool>()) return;
+  G4int nBins = config["opticalLUTBins"].as<G4int>();
+
+  typedef std::map<G4String, G4MaterialPropertyVector*, std::less<G4String> >
+    VectorMap;
+  const VectorMap* vectors = table->GetPropertiesMap();
+  std::vector<G4String> keys;
+  for (VectorMap::const_iterator it = vectors->begin(); it != vectors->end();
+       it++)
+    if (it->second->GetVectorLength() > 2) keys.push_back(it->first);
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    G4MaterialPropertyVector* original = table->GetProperty(keys[i]);
+    singCrysUniformPropertyVector* uniform =
+      new singCrysUniformPropertyVector(original, nBins);
+    G4cout << "Resampled " << keys[i] << " of " << owner << " on " << nBins
+      << " bins. Maximum interpolation error: " << uniform->GetMaxError()
+      << " (" << 100. * uniform->GetMaxRelError() << "%)" << G4endl;
+    table->RemoveProperty(keys[i]);
+    table->AddProperty(keys[i], uniform);
+    delete original;
+  }
+}
+
+// Whether two property vectors have the same points
+static G4bool sameVector(G4MaterialPropertyVector* a,
+                         G4MaterialPropertyVector* b)
+{
+  if (a->GetVectorLength() != b->GetVectorLength()) return false;
+  for (size_t i = 0; i < a->GetVectorLength(); i++)
+    if (a->Energy(i) != b->Energy(i) || (*a)[i] != (*b)[i]) return false;
+  return true;
+}
+
+// Whether GEANT4 keeps tables or pointers made from a property vector when
+// the processes are built: RINDEX (G4Cerenkov, and GROUPVEL, computed from
+// it and cached by G4Track), FASTCOMPONENT and SLOWCOMPONENT
+// (G4Scintillation), and RAYLEIGH (G4OpRayleigh). The other vectors are read
+// at every step.
+static G4bool isTabulated(const G4String& key)
+{
+  return key == "RINDEX" || key == "GROUPVEL" || key == "FASTCOMPONENT" ||
+    key == "SLOWCOMPONENT" || key == "RAYLEIGH";
+}
+
+// Copies the properties of 'newTable' into 'table'. Vectors that changed
+// are moved, so 'newTable' can be deleted afterwards.
+void singCrysDetectorConstruction::
+  copyProperties(G4MaterialPropertiesTable* table,
+                 G4MaterialPropertiesTable* newTable, G4String owner)
+{
+  typedef std::map<G4String, G4MaterialPropertyVector*, std::less<G4String> >
+    VectorMap;
+  typedef std::map<G4String, G4double, std::less<G4String> > ConstMap;
+
+  // Vectors that are gone
+  const VectorMap* vectors = table->GetPropertiesMap();
+  std::vector<G4String> keys;
+  for (VectorMap::const_iterator it = vectors->begin(); it != vectors->end();
+       it++)
+    if (!newTable->GetProperty(it->first)) keys.push_back(it->first);
+  std::vector<G4String> kept;
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    // GROUPVEL is computed by GEANT4, so it is not in the new table
+    if (keys[i] == "GROUPVEL") continue;
+    if (isTabulated(keys[i]))
+    {
+      kept.push_back(keys[i]);
+      continue;
+    }
+    G4MaterialPropertyVector* old = table->GetProperty(keys[i]);
+    table->RemoveProperty(keys[i]);
+    delete old;
+  }
+  // New and changed vectors
+  const VectorMap* newVectors = newTable->GetPropertiesMap();
+  keys.clear();
+  for (VectorMap::const_iterator it = newVectors->begin();
+       it != newVectors->end(); it++)
+  {
+    G4MaterialPropertyVector* old = table->GetProperty(it->first);
+    if (old && sameVector(old, it->second)) continue;
+    if (isTabulated(it->first))
+    {
+      kept.push_back(it->first);
+      continue;
+    }
+    table->RemoveProperty(it->first);
+    table->AddProperty(it->first, it->second);
+    delete old;
+    keys.push_back(it->first);
+  }
+  for (size_t i = 0; i < keys.size(); i++)
+    newTable->RemoveProperty(keys[i]);
+  for (size_t i = 0; i < kept.size(); i++)
+  {
+    G4cerr << "Warning: " << kept[i] << " of " << owner << " changed, but "
+      << "GEANT4 tabulates it at initialization. It is not updated; restart "
+      << "the program to change it." << G4endl;
+  }
+
+  // Constant properties
+  const ConstMap* constants = table->GetPropertiesCMap();
+  keys.clear();
+  for (ConstMap::const_iterator it = constants->begin();
+       it != constants->end(); it++)
+    if (!newTable->ConstPropertyExists(it->first)) keys.push_back(it->first);
+  for (size_t i = 0; i < keys.size(); i++)
+    table->RemoveConstProperty(keys[i]);
+  const ConstMap* newConstants = newTable->GetPropertiesCMap();
+  for (ConstMap::const_iterator it = newConstants->begin();
+       it != newConstants->end(); it++)
+    table->AddConstProperty(it->first, it->second);
+}
+
+// Decides which solid to use for a prism of 'numSides' sides
+singCrysDetectorConstruction::PrismShape
+  singCrysDetectorConstruction::prismShape(G4double rInner) const
+{
+  if (!specializeSolids) return kPolyhedra;
+  if (tubsMinSides > 0 && numSides >= tubsMinSides) return kTubs;
+  // A square prism is a box, since the crystal is rotated so that its faces
+  // are parallel to the axes. A box cannot have a hole.
+  if (numSides == 4 && rInner == 0.) return kBox;
+  return kPolyhedra;
+}
+
+// Radius of the circle with the same area as the polygon, divided by the
+// apothem of the polygon
+G4double singCrysDetectorConstruction::tubsRadiusFactor() const
+{
+  return std::sqrt(numSides * std::tan(pi / numSides) / pi);
+}
+
+// Makes a prism with the same shape and placement as a G4Polyhedra with
+// the given parameters, or the cheapest solid that replaces it
+G4VSolid* singCrysDetectorConstruction::makePrism(G4String name,
+                                                  const G4double zPlanes[2],
+                                                  const G4double rInner[2],
+                                                  const G4double rOuter[2],
+                                                  G4double& zOffset)
+{
+  G4double zLow = std::min(zPlanes[0], zPlanes[1]);
+  G4double zHigh = std::max(zPlanes[0], zPlanes[1]);
+  switch (prismShape(rInner[0]))
+  {
+    case kBox:
+      zOffset = 0.5 * (zLow + zHigh);
+      return new G4Box(name, rOuter[0], rOuter[0], 0.5 * (zHigh - zLow));
+    case kTubs:
+    {
+      G4double factor = tubsRadiusFactor();
+      zOffset = 0.5 * (zLow + zHigh);
+      return new G4Tubs(name, rInner[0] * factor, rOuter[0] * factor,
+                        0.5 * (zHigh - zLow), 0., 2 * pi);
+    }
+    default:
+      zOffset = 0.;
+      return new G4Polyhedra(name,
+                             prismRotation,
+                             2*pi + prismRotation,
+                             numSides,
+                             2,
+                             zPlanes,
+                             rInner,
+                             rOuter);
+  }
+}
@@ -0,0 +1,104 @@
+/*!
+ * \file singCrysDetectorMessenger.cc
+ * \brief Implementation file for singCrysDetectorMessenger class. Handles UI
+ * commands specific to the singCrysDetectorConstruction class.
+ */
+
+#include "singCrysDetectorMessenger.hh"
+#include "singCrysDetectorConstruction.hh"
+#include "singCrysConfig.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcommand.hh"
+#include "G4UIparameter.hh"
+#include "G4UIcmdWithoutParameter.hh"
+
+#include <sstream>
+
+// Constructor: construct the necessary commands and directories
+singCrysDetectorMessenger::singCrysDetectorMessenger
+  (singCrysDetectorConstruction* DC) : G4UImessenger(),
+                                       DetectorConstruction(DC)
+{
+  // Define directory
+  geomDirectory = new G4UIdirectory("/singCrys/geom/");
+  geomDirectory->SetGuidance("Geometry control");
+
+  // Define command to change an option. The value is kept as a string and
+  // parsed by singCrysConfig.
+  setCmd = new G4UIcommand("/singCrys/geom/set", this);
+  setCmd->SetGuidance("Change a configuration option. The geometry is only");
+  setCmd->SetGuidance("changed by /singCrys/geom/rebuild.");
+  addOptionParameters(setCmd);
+
+  // Define command to rebuild the geometry
+  rebuildCmd = new G4UIcmdWithoutParameter("/singCrys/geom/rebuild", this);
+  rebuildCmd->SetGuidance("Build the geometry again from the current options");
+  rebuildCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  // Define commands to update the optical properties
+  opticsDirectory = new G4UIdirectory("/singCrys/optics/");
+  opticsDirectory->SetGuidance("Optical properties control");
+  opticsSetCmd = new G4UIcommand("/singCrys/optics/set", this);
+  opticsSetCmd->SetGuidance("Change a configuration option, and update the");
+  opticsSetCmd->SetGuidance("optical properties of materials and surfaces.");
+  opticsSetCmd->SetGuidance("RINDEX, FASTCOMPONENT, SLOWCOMPONENT, and");
+  opticsSetCmd->SetGuidance("RAYLEIGH are tabulated by GEANT4 at");
+  opticsSetCmd->SetGuidance("initialization and are not updated.");
+  addOptionParameters(opticsSetCmd);
+  reloadCmd = new G4UIcmdWithoutParameter("/singCrys/optics/reload", this);
+  reloadCmd->SetGuidance("Read the optical data files again");
+  reloadCmd->SetGuidance("RINDEX, FASTCOMPONENT, SLOWCOMPONENT, and");
+  reloadCmd->SetGuidance("RAYLEIGH are tabulated by GEANT4 at");
+  reloadCmd->SetGuidance("initialization and are not updated.");
+  reloadCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+// Adds the key and value parameters of a command that sets an option
+void singCrysDetectorMessenger::addOptionParameters(G4UIcommand* command)
+{
+  G4UIparameter* keyParam = new G4UIparameter("key", 's', false);
+  keyParam->SetGuidance("Name of the option, as in the configuration file");
+  command->SetParameter(keyParam);
+  G4UIparameter* valueParam = new G4UIparameter("value", 's', false);
+  valueParam->SetGuidance("New value of the option");
+  command->SetParameter(valueParam);
+  command->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+// Destructor: delete the dynamically allocated commands and directories
+singCrysDetectorMessenger::~singCrysDetectorMessenger()
+{
+  delete geomDirectory;
+  delete setCmd;
+  delete rebuildCmd;
+  delete opticsDirectory;
+  delete opticsSetCmd;
+  delete reloadCmd;
+}
+
+// Executes the UI commands
+void singCrysDetectorMessenger::
+  SetNewValue(G4UIcommand* command, G4String newVal)
+{
+  // Changes an option
+  if (command == setCmd || command == opticsSetCmd)
+  {
+    std::istringstream is(newVal);
+    std::string key, value;
+    is >> key >> value;
+    if (!singCrysConfig::GetInstance()->SetOption(key, value)) return;
+    G4cout << "Option " << key << " set to " << value << "." << G4endl;
+    if (command == opticsSetCmd) DetectorConstruction->UpdateOptics();
+  }
+  // Rebuilds the geometry
+  else if (command == rebuildCmd)
+  {
+    DetectorConstruction->Rebuild();
+  }
+  // Reads the optical properties again
+  else if (command == reloadCmd)
+  {
+    DetectorConstruction->UpdateOptics();
+  }
+}
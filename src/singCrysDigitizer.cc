@@ -0,0 +1,89 @@
+/*!
+ * \file singCrysDigitizer.cc
+ * \brief Implementation file for the singCrysDigitizer class. Turns the hits
+ * of an event into APD amplitudes.
+ */
+
+#include "singCrysDigitizer.hh"
+#include "singCrysSiliconHitsCollection.hh"
+#include "singCrysConfig.hh"
+#include "singCrysHitSchema.hh"
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace po = boost::program_options;
+
+// Constructor. Get the options and size the arrays.
+singCrysDigitizer::singCrysDigitizer() : sum(0.)
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  G4String modeStr = (G4String) config["digitize"].as<std::string>();
+  withSum = config["digitizeSum"].as<G4bool>();
+  gain = config["apdGain"].as<G4double>();
+  excessNoise = config["apdExcessNoise"].as<G4double>();
+  darkCounts = config["apdDarkCounts"].as<G4double>();
+  noise = config["apdNoise"].as<G4double>();
+  seed = config["digitizeSeed"].as<G4long>();
+  if (modeStr.compareTo("off") == 0) mode = kOff;
+  else if (modeStr.compareTo("on") == 0) mode = kOn;
+  else if (modeStr.compareTo("only") == 0) mode = kOnly;
+  else
+  {
+    G4cerr << "Unknown digitize mode " << modeStr << ". Using off." << G4endl;
+    mode = kOff;
+  }
+  // Each hit is a photoelectron in its APD
+  if (mode != kOff)
+    singCrysHitSchema::GetInstance()->Require(singCrysHitSchema::kAPD);
+  if (excessNoise < 1.)
+  {
+    G4cerr << "apdExcessNoise must be at least 1. Using 1." << G4endl;
+    excessNoise = 1.;
+  }
+  G4int nAPD = config["nAPD"].as<G4int>();
+  photoelectrons.resize(nAPD > 0 ? nAPD : 1);
+  normals.resize(2 * photoelectrons.size());
+  amplitudes.resize(photoelectrons.size());
+}
+
+// Counts the photoelectrons of each APD, and draws their amplification and
+// the noise
+void singCrysDigitizer::Digitize(G4int eventID,
+                                 const singCrysSiliconHitArena* arena)
+{
+  typedef singCrysSiliconHitArena A;
+  size_t nAPD = photoelectrons.size();
+  // The seeds are zero-terminated, so the event number is offset by one
+  long seeds[3] = {seed, (long) eventID + 1, 0};
+  engine.setSeeds(seeds, 0);
+
+  // Dark counts, then the photoelectrons of the hits
+  if (darkCounts > 0.)
+    CLHEP::RandPoisson::shootArray(&engine, nAPD, &photoelectrons[0],
+                                   darkCounts);
+  else
+    std::fill(photoelectrons.begin(), photoelectrons.end(), 0);
+  // The APD of each hit is recorded when digitizing (see the constructor)
+  if (arena && arena->Size() > 0 && arena->Has(A::kAPDNb))
+  {
+    const G4int* APD = arena->Column(A::kAPDNb);
+    for (size_t i = 0; i < arena->Size(); i++)
+    {
+      if (APD[i] >= 0 && APD[i] < (G4int) nAPD) photoelectrons[APD[i]]++;
+    }
+  }
+
+  // Avalanche with excess noise, then electronics noise
+  CLHEP::RandGauss::shootArray(&engine, normals.size(), &normals[0]);
+  G4double spread = std::sqrt(excessNoise - 1.);
+  sum = 0.;
+  for (size_t i = 0; i < nAPD; i++)
+  {
+    G4double n = photoelectrons[i];
+    G4double charge = gain * (n + spread * std::sqrt(n) * normals[i]);
+    if (charge < 0.) charge = 0.;
+    amplitudes[i] = charge + noise * normals[nAPD + i];
+    sum += amplitudes[i];
+  }
+}
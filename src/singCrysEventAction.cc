@@ -20,10 +20,24 @@
 #include "G4UImanager.hh"
 #include "G4ios.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4RunManager.hh"
 #include "singCrysConfig.hh"
+#include "singCrysCheckpoint.hh"
+#include "singCrysPrimaryGeneratorAction.hh"
 #include <boost/program_options.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
 
-#include "singCrysSiliconHit.hh"
+#include "singCrysSiliconHitsCollection.hh"
+#include "singCrysHitSchema.hh"
+#include "singCrysTrigger.hh"
+#include "singCrysHitSampler.hh"
+#include "singCrysPhotonTally.hh"
+#include "singCrysDigitizer.hh"
+#include "singCrysPulseShaper.hh"
+#include "singCrysDepositLibrary.hh"
 
 namespace po = boost::program_options;
 
@@ -38,6 +52,29 @@ singCrysEventAction::singCrysEventAction()
   G4SDManager* SDman = G4SDManager::GetSDMpointer();
   fSiHCID = SDman->GetCollectionID(HCname="SiliconHitsCollection");
   fVerboseLevel = 1;
+  fSchema = singCrysHitSchema::GetInstance();
+  // The trigger, digitizer, and pulse shaper add the hit fields they need to
+  // the schema, so they are made before the columns below and before the
+  // sensitive detector (at /run/initialize)
+  fTrigger = new singCrysTrigger();
+  fSampler = new singCrysHitSampler();
+  fPhotonTally = singCrysPhotonTally::GetInstance();
+  fDigitizer = new singCrysDigitizer();
+  fShaper = new singCrysPulseShaper();
+  G4bool writeHits = fDigitizer->GetMode() != singCrysDigitizer::kOnly;
+  nHitsEvent = 0;
+  totalEnergy = 0.;
+  sampleWeight = 0.;
+  nHitsAPD.assign(std::max(config["nAPD"].as<G4int>(), 1), 0);
+  // When resuming from a checkpoint, output is appended to the existing
+  // files.
+  G4bool resuming = singCrysCheckpoint::GetInstance()->IsResuming();
+  // Output flushing policy
+  nEventsProcessed = 0;
+  aidaCommitEvery = config["aidaCommitEvery"].as<G4int>();
+  memCeiling = config["outputMemCeiling"].as<G4double>();
+  memCheckEvery = config["memCheckEvery"].as<G4int>();
+  memThreshold = memCeiling;
 
 #ifdef AIDA_USE
   fTuple = 0;
@@ -45,51 +82,461 @@ singCrysEventAction::singCrysEventAction()
   singCrysAIDAManager* analysisManager =
       singCrysAIDAManager::getInstance();
   // Create a Tuple. It contains the event number, the index of the APD, the
-  // index of the deposit, and the energy of the deposit. 
+  // index of the deposit, and the energy of the deposit, plus the other
+  // fields of the hit schema.
+  std::string real = "double";
+  if (fSchema->GetPrecision() != singCrysHitSchema::kDouble) real = "float";
+  std::string columns = "int eventNumber";
+  if (fSchema->Has(singCrysHitSchema::kAPD)) columns += ", int APDID";
+  columns += ", int iDeposit";
+  if (fSchema->GetPrecision() == singCrysHitSchema::kQuantized)
+    columns += ", short Energy";
+  else
+    columns += ", " + real + " Energy";
+  if (fSchema->Has(singCrysHitSchema::kTime))
+    columns += ", " + real + " time";
+  if (fSchema->Has(singCrysHitSchema::kPosition))
+    columns += ", " + real + " xPos, " + real + " yPos, " + real + " zPos";
+  if (fSchema->Has(singCrysHitSchema::kMomentum))
+    columns += ", " + real + " xMomentum, " + real + " yMomentum, "
+      + real + " zMomentum";
+  if (fSchema->Has(singCrysHitSchema::kTrackID)) columns += ", int trackID";
   ITupleFactory* tFactory = analysisManager->getTupleFactory();
-  if (tFactory)
+  if (resuming && analysisManager->getTree())
   {
-    fTuple = tFactory->
-    create("MyTuple","MyTuple","int eventNumber, APDID, iDeposit, double Energy, xPos, yPos, zPos, xMomentum, yMomentum, zMomentum","");
+    fTuple = dynamic_cast<ITuple*>(analysisManager->getTree()->
+      find("MyTuple"));
+  }
+  if (tFactory && !fTuple && writeHits)
+  {
+    fTuple = tFactory->create("MyTuple", "MyTuple", columns, "");
+  }
+  // In the sampled output mode, a second tuple has a row for every event
+  fEventTuple = 0;
+  if (fSampler->IsSampled())
+  {
+    if (resuming && analysisManager->getTree())
+    {
+      fEventTuple = dynamic_cast<ITuple*>(analysisManager->getTree()->
+        find("EventTuple"));
+    }
+    if (tFactory && !fEventTuple)
+    {
+      fEventTuple = tFactory->create("EventTuple", "EventTuple",
+        "int eventNumber, int nHits, double totalEnergy, double sampleWeight",
+        "");
+    }
+  }
+  // With the digitizer, a tuple has a row per APD and event. The sum of the
+  // amplitudes has APDID -1.
+  fAPDTuple = 0;
+  if (fDigitizer->GetMode() != singCrysDigitizer::kOff)
+  {
+    if (resuming && analysisManager->getTree())
+    {
+      fAPDTuple = dynamic_cast<ITuple*>(analysisManager->getTree()->
+        find("APDTuple"));
+    }
+    if (tFactory && !fAPDTuple)
+    {
+      fAPDTuple = tFactory->create("APDTuple", "APDTuple",
+        "int eventNumber, int APDID, double amplitude", "");
+    }
+  }
+  // With the pulse shaper, a tuple has a row per APD and event
+  fPulseTuple = 0;
+  if (fShaper->IsEnabled())
+  {
+    if (resuming && analysisManager->getTree())
+    {
+      fPulseTuple = dynamic_cast<ITuple*>(analysisManager->getTree()->
+        find("PulseTuple"));
+    }
+    if (tFactory && !fPulseTuple)
+    {
+      fPulseTuple = tFactory->create("PulseTuple", "PulseTuple",
+        "int eventNumber, int APDID, double amplitude, double time", "");
+    }
+  }
+  // When resuming, remove the rows written after the last checkpoint, so
+  // that the events resumed are not written twice
+  const std::vector<G4long>& tupleRows =
+    singCrysCheckpoint::GetInstance()->GetTupleRows();
+  if (resuming && !tupleRows.empty())
+  {
+    ITuple* tuples[] = {fTuple, fEventTuple, fAPDTuple, fPulseTuple};
+    for (size_t i = 0; i < tupleRows.size() && i < 4; i++)
+    {
+      if (!tuples[i] && tupleRows[i] == 0) continue;
+      if (!tuples[i] ||
+          !analysisManager->truncate(tuples[i], (G4int) tupleRows[i]))
+      {
+        G4ExceptionDescription msg;
+        msg << "An AIDA tuple has " << (tuples[i] ? tuples[i]->rows() : 0)
+          << " rows, but the checkpoint recorded " << tupleRows[i]
+          << ". The job cannot be resumed.";
+        G4Exception("singCrysEventAction::singCrysEventAction()",
+                    "singCrysCheckpoint001", FatalException, msg);
+      }
+    }
+  }
+  colEvent = colDeposit = colAPD = colEnergy = colTime = colPos = colMom =
+    colTrack = -1;
+  if (fTuple)
+  {
+    colEvent = fTuple->findColumn("eventNumber");
+    colDeposit = fTuple->findColumn("iDeposit");
+    colEnergy = fTuple->findColumn("Energy");
+    if (fSchema->Has(singCrysHitSchema::kAPD))
+      colAPD = fTuple->findColumn("APDID");
+    if (fSchema->Has(singCrysHitSchema::kTime))
+      colTime = fTuple->findColumn("time");
+    if (fSchema->Has(singCrysHitSchema::kPosition))
+      colPos = fTuple->findColumn("xPos");
+    if (fSchema->Has(singCrysHitSchema::kMomentum))
+      colMom = fTuple->findColumn("xMomentum");
+    if (fSchema->Has(singCrysHitSchema::kTrackID))
+      colTrack = fTuple->findColumn("trackID");
   }
 #endif // AIDA_USE
 
 #ifdef ROOT_USE
   // Create a file and a tree
   G4String rootOutfile = (G4String) config["rootOutfile"].as<std::string>();
-  myFile = new TFile(rootOutfile, "recreate");
-  myTree = new TTree("ntp1", "Tree with vectors");
-  // Create branches, one for the event and APD ID, and one for the energy of
-  // the hits
-  myTree->Branch("eventID", &eventID);
-  myTree->Branch("APDID", &APDID);
-  myTree->Branch("energy", &energy);
-  myTree->Branch("xPos", &xPos);
-  myTree->Branch("yPos", &yPos);
-  myTree->Branch("zPos", &zPos);
-  myTree->Branch("xMomentum", &xPVec);
-  myTree->Branch("yMomentum", &yPVec);
-  myTree->Branch("zMomentum", &zPVec);
+  myTree = 0;
+  if (resuming)
+  {
+    // Reopen the file and continue the tree saved at the last checkpoint
+    myFile = new TFile(rootOutfile, "update");
+    myTree = (TTree*) myFile->Get("ntp1");
+    Long64_t nEntries = singCrysCheckpoint::GetInstance()->GetRootEntries();
+    Long64_t nFound = myTree ? myTree->GetEntries() : 0;
+    if (nFound < nEntries)
+    {
+      G4ExceptionDescription msg;
+      msg << rootOutfile << " has " << nFound << " entries, but the "
+        << "checkpoint recorded " << nEntries << ". The job cannot be "
+        << "resumed.";
+      G4Exception("singCrysEventAction::singCrysEventAction()",
+                  "singCrysCheckpoint002", FatalException, msg);
+    }
+    if (nFound > nEntries)
+    {
+      // Entries autosaved after the checkpoint would be written again. Copy
+      // the first ones to a new tree, and delete the old tree and all its
+      // cycles from the file.
+      G4cout << "Removing " << nFound - nEntries << " entries written to "
+        << rootOutfile << " after the checkpoint." << G4endl;
+      TTree* oldTree = myTree;
+      myTree = oldTree->CloneTree(nEntries);
+      oldTree->Delete("all");
+      myTree->AutoSave("SaveSelf");
+    }
+  }
+  else
+  {
+    myFile = new TFile(rootOutfile, "recreate");
+  }
+  G4bool existing = (myTree != 0);
+  if (!existing) myTree = new TTree("ntp1", "Tree with vectors");
+  // Create branches, one for the event ID, and one for each field of the
+  // hit schema
+  if (existing) myTree->SetBranchAddress("eventID", &eventID);
+  else myTree->Branch("eventID", &eventID);
+  if (writeHits)
+  {
+    if (fSchema->GetPrecision() == singCrysHitSchema::kDouble)
+      AddHitBranches(doubleHits, existing);
+    else
+      AddHitBranches(floatHits, existing);
+  }
+  // Amplitudes of the APDs, and their sum
+  amplitudeSum = 0.;
+  if (fDigitizer->GetMode() != singCrysDigitizer::kOff)
+  {
+    AddBranch("amplitude", &amplitudes, existing);
+    if (fDigitizer->HasSum())
+    {
+      if (existing) myTree->SetBranchAddress("amplitudeSum", &amplitudeSum);
+      else myTree->Branch("amplitudeSum", &amplitudeSum);
+    }
+  }
+  // In the sampled output mode, every event has its sums and the weight of
+  // the sampled hits
+  if (fSampler->IsSampled())
+  {
+    if (existing)
+    {
+      myTree->SetBranchAddress("nHits", &nHitsEvent);
+      myTree->SetBranchAddress("totalEnergy", &totalEnergy);
+      myTree->SetBranchAddress("sampleWeight", &sampleWeight);
+    }
+    else
+    {
+      myTree->Branch("nHits", &nHitsEvent);
+      myTree->Branch("totalEnergy", &totalEnergy);
+      myTree->Branch("sampleWeight", &sampleWeight);
+    }
+    if (fSchema->Has(singCrysHitSchema::kAPD))
+      AddBranch("nHitsAPD", &nHitsAPD, existing);
+  }
+  // Amplitudes and times of the shaped pulses
+  if (fShaper->IsEnabled())
+  {
+    AddBranch("pulseAmplitude", &pulseAmplitudes, existing);
+    AddBranch("pulseTime", &pulseTimes, existing);
+  }
+  // Photon fates of every event, indexed as singCrysPhotonTally::Fate
+  if (fPhotonTally->IsEnabled())
+  {
+    AddBranch("photonFates", &photonFates, existing);
+    if (!existing)
+    {
+      std::string names;
+      for (G4int i = 0; i < singCrysPhotonTally::kNFates; i++)
+      {
+        if (i > 0) names += " ";
+        names += singCrysPhotonTally::
+          GetFateName((singCrysPhotonTally::Fate) i);
+      }
+      myTree->GetUserInfo()->Add(new TNamed("photonFates", names.c_str()));
+    }
+  }
+  if (writeHits && fSchema->GetPrecision() == singCrysHitSchema::kQuantized)
+  {
+    AddBranch("energyCode", &energyCode, existing);
+    // Record how to decode the energies in the file itself
+    if (!existing)
+    {
+      std::ostringstream decoding;
+      decoding << "energy (MeV) = " << singCrysHitSchema::quantMinEnergy
+        << " + energyCode * " << (singCrysHitSchema::quantMaxEnergy
+        - singCrysHitSchema::quantMinEnergy) << " / 65535";
+      myTree->GetUserInfo()->
+        Add(new TNamed("energyCode", decoding.str().c_str()));
+    }
+  }
+  // Write baskets to disk every 'rootAutoFlush' MB of data, rather than
+  // keeping the whole run in memory. Negative values are in bytes for ROOT.
+  myTree->SetBasketSize("*", config["rootBasketSize"].as<G4int>());
+  myTree->SetAutoFlush(-(Long64_t)
+    (config["rootAutoFlush"].as<G4double>() * 1024 * 1024));
+  myTree->SetAutoSave(-(Long64_t)
+    (config["rootAutoSave"].as<G4double>() * 1024 * 1024));
 #endif // ROOT_USE
 }
 
 // Destructor: Writes data to file and cleans up analysis interface.
 singCrysEventAction::~singCrysEventAction()
 {
+  // Report how many events the trigger kept
+  G4cout << "Output: " << fTrigger->Summary() << G4endl;
 #ifdef AIDA_USE
   singCrysAIDAManager::dispose();
 #endif // AIDA_USE
   
 #ifdef ROOT_USE
+  if (fTrigger->IsActive())
+  {
+    myTree->GetUserInfo()->
+      Add(new TNamed("trigger", fTrigger->Summary().c_str()));
+  }
   myFile->Write();
   myFile->Close();
   delete myFile;
 #endif
+  delete fTrigger;
+  delete fSampler;
+  delete fDigitizer;
+  delete fShaper;
+}
+
+#ifdef ROOT_USE
+// Creates a new branch, or sets the address of an existing one
+template <typename T>
+void singCrysEventAction::AddBranch(const char* name, std::vector<T>* vec,
+                                    G4bool existing)
+{
+  if (existing)
+  {
+    branchAddresses[name] = vec;
+    myTree->SetBranchAddress(name, (std::vector<T>**) &branchAddresses[name]);
+  }
+  else
+  {
+    myTree->Branch(name, vec);
+  }
+}
+
+// Creates the branches for the fields in the hit schema
+template <typename Real>
+void singCrysEventAction::AddHitBranches(HitVectors<Real>& vecs,
+                                         G4bool existing)
+{
+  if (fSchema->Has(singCrysHitSchema::kAPD))
+    AddBranch("APDID", &vecs.APDID, existing);
+  if (fSchema->GetPrecision() != singCrysHitSchema::kQuantized)
+    AddBranch("energy", &vecs.energy, existing);
+  if (fSchema->Has(singCrysHitSchema::kTime))
+    AddBranch("time", &vecs.time, existing);
+  if (fSchema->Has(singCrysHitSchema::kPosition))
+  {
+    AddBranch("xPos", &vecs.xPos, existing);
+    AddBranch("yPos", &vecs.yPos, existing);
+    AddBranch("zPos", &vecs.zPos, existing);
+  }
+  if (fSchema->Has(singCrysHitSchema::kMomentum))
+  {
+    AddBranch("xMomentum", &vecs.xPVec, existing);
+    AddBranch("yMomentum", &vecs.yPVec, existing);
+    AddBranch("zMomentum", &vecs.zPVec, existing);
+  }
+  if (fSchema->Has(singCrysHitSchema::kTrackID))
+    AddBranch("trackID", &vecs.trackID, existing);
+}
+
+// Copies the selected values of a column to a vector
+template <typename Out, typename In>
+static void CopyColumn(std::vector<Out>& vec, const In* column, size_t n,
+                       const std::vector<size_t>* selected)
+{
+  if (!selected)
+  {
+    vec.assign(column, column + n);
+    return;
+  }
+  vec.resize(selected->size());
+  for (size_t i = 0; i < selected->size(); i++)
+    vec[i] = column[(*selected)[i]];
+}
+
+// Copies the columns of the arena to the vectors. The arena stores the same
+// floating point type as the vectors, so without a selection these are
+// plain contiguous copies.
+template <typename Real>
+void singCrysEventAction::FillHits(HitVectors<Real>& vecs,
+                                   const singCrysSiliconHitArena* arena,
+                                   const std::vector<size_t>* selected)
+{
+  typedef singCrysSiliconHitArena A;
+  size_t n = arena->Size();
+  if (n == 0) return;
+  if (arena->Has(A::kAPDNb))
+    CopyColumn(vecs.APDID, arena->Column(A::kAPDNb), n, selected);
+  const Real* edep = arena->Column<Real>(A::kEdep);
+  if (fSchema->GetPrecision() == singCrysHitSchema::kQuantized)
+  {
+    size_t nOut = selected ? selected->size() : n;
+    energyCode.resize(nOut);
+    for (size_t i = 0; i < nOut; i++)
+      energyCode[i] = singCrysHitSchema::
+        QuantizeEnergy(edep[selected ? (*selected)[i] : i]);
+  }
+  else
+  {
+    CopyColumn(vecs.energy, edep, n, selected);
+  }
+  if (arena->Has(A::kTime))
+    CopyColumn(vecs.time, arena->Column<Real>(A::kTime), n, selected);
+  if (arena->Has(A::kXPos))
+  {
+    CopyColumn(vecs.xPos, arena->Column<Real>(A::kXPos), n, selected);
+    CopyColumn(vecs.yPos, arena->Column<Real>(A::kYPos), n, selected);
+    CopyColumn(vecs.zPos, arena->Column<Real>(A::kZPos), n, selected);
+  }
+  if (arena->Has(A::kXPVec))
+  {
+    CopyColumn(vecs.xPVec, arena->Column<Real>(A::kXPVec), n, selected);
+    CopyColumn(vecs.yPVec, arena->Column<Real>(A::kYPVec), n, selected);
+    CopyColumn(vecs.zPVec, arena->Column<Real>(A::kZPVec), n, selected);
+  }
+  if (arena->Has(A::kTrackID))
+    CopyColumn(vecs.trackID, arena->Column(A::kTrackID), n, selected);
+}
+#endif // ROOT_USE
+
+#ifdef AIDA_USE
+// Fills a floating point column as double or float
+void singCrysEventAction::FillTupleColumn(G4int column, G4double value)
+{
+  if (fSchema->GetPrecision() == singCrysHitSchema::kDouble)
+    fTuple->fill(column, value);
+  else
+    fTuple->fill(column, (float) value);
+}
+#endif // AIDA_USE
+
+// Counts the hits of the event, per APD, and sums their energy
+void singCrysEventAction::SumHits(const singCrysSiliconHitArena* arena)
+{
+  typedef singCrysSiliconHitArena A;
+  nHitsEvent = 0;
+  totalEnergy = 0.;
+  std::fill(nHitsAPD.begin(), nHitsAPD.end(), 0);
+  if (!arena) return;
+  nHitsEvent = arena->Size();
+  for (size_t i = 0; i < arena->Size(); i++)
+  {
+    totalEnergy += arena->Get(A::kEdep, i);
+    G4int APD = arena->Get(A::kAPDNb, i);
+    if (APD < 0) continue;
+    if (APD >= (G4int) nHitsAPD.size()) nHitsAPD.resize(APD + 1, 0);
+    nHitsAPD[APD]++;
+  }
+}
+
+// Returns the resident memory of the process in MB, or 0 if unknown
+G4double singCrysEventAction::ResidentMemory()
+{
+  // Second field of /proc/self/statm is the resident set size in pages
+  std::ifstream statm("/proc/self/statm");
+  G4double size, resident;
+  if (!(statm >> size >> resident)) return 0.;
+  return resident * sysconf(_SC_PAGESIZE) / (1024. * 1024.);
+}
+
+// Writes the output collected so far to file
+void singCrysEventAction::FlushOutput()
+{
+#ifdef AIDA_USE
+  if (!singCrysAIDAManager::getInstance()->commit())
+    G4cerr << "Commit failed: AIDA file not updated!" << G4endl;
+#endif // AIDA_USE
+
+#ifdef ROOT_USE
+  // Writes the baskets and the tree header, so the file can be read back
+  myTree->AutoSave("SaveSelf");
+#endif // ROOT_USE
+  singCrysDepositLibrary::GetInstance()->Flush();
+}
+
+// Flushes the output and records the progress in a checkpoint
+void singCrysEventAction::WriteCheckpoint()
+{
+  FlushOutput();
+  const singCrysPrimaryGeneratorAction* PGA =
+    dynamic_cast<const singCrysPrimaryGeneratorAction*>
+    (G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+  G4ThreeVector gunPos = PGA ? PGA->getGunPos() : G4ThreeVector();
+  G4long nRootEntries = 0;
+#ifdef ROOT_USE
+  nRootEntries = myTree->GetEntries();
+#endif // ROOT_USE
+  // Rows of the AIDA tuples, in the order the constructor truncates them
+  std::vector<G4long> nTupleRows;
+#ifdef AIDA_USE
+  ITuple* tuples[] = {fTuple, fEventTuple, fAPDTuple, fPulseTuple};
+  for (size_t i = 0; i < 4; i++)
+    nTupleRows.push_back(tuples[i] ? tuples[i]->rows() : 0);
+#endif // AIDA_USE
+  singCrysCheckpoint::GetInstance()->Write(gunPos, nRootEntries, nTupleRows,
+    singCrysDepositLibrary::GetInstance()->GetLength());
 }
 
 // Actions to be carried out at the beginning of each event
 void singCrysEventAction::BeginOfEventAction(const G4Event*)
 {
+  if (fPhotonTally->IsEnabled()) fPhotonTally->BeginEvent();
 }
 
 // Actions to be carried out at the end of each event: process hits and write
@@ -99,10 +546,14 @@ void singCrysEventAction::EndOfEventAction(const G4Event* evt)
   // Get event number. Print it if modulo a user-specified number
   po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
   G4int printEvery = config["printEvery"].as<G4int>();
-  G4int evtID = evt->GetEventID();
+  // Events done before resuming from a checkpoint are counted as well
+  singCrysCheckpoint* checkpoint = singCrysCheckpoint::GetInstance();
+  G4int evtID = evt->GetEventID() + checkpoint->GetEventOffset();
   if (evtID % printEvery == 0)
   {
     G4cout << evtID << " events completed." << G4endl;
+    if (fPhotonTally->IsEnabled())
+      G4cout << "Photon fates: " << fPhotonTally->EventSummary() << G4endl;
   }
   // Get hits collection
   G4HCofThisEvent * HCE = evt->GetHCofThisEvent();
@@ -112,84 +563,147 @@ void singCrysEventAction::EndOfEventAction(const G4Event* evt)
     SiHC = (singCrysSiliconHitsCollection*)(HCE->GetHC(fSiHCID));
   }
 
+  // Apply the trigger. Rejected events are only counted, unless the
+  // prescale keeps them.
+  G4bool write = fTrigger->Accept(SiHC ? SiHC->GetArena() : 0);
+  // In the sampled output mode, sum up the event, and choose the hits whose
+  // fields are written
+  const std::vector<size_t>* selected = 0;
+  if (write && fSampler->IsSampled())
+  {
+    const singCrysSiliconHitArena* arena = SiHC ? SiHC->GetArena() : 0;
+    SumHits(arena);
+    sampleWeight = fSampler->Sample(evtID, arena ? arena->Size() : 0);
+    selected = &fSampler->GetSelected();
+  }
+  // Turn the hits into APD amplitudes
+  if (write && fDigitizer->GetMode() != singCrysDigitizer::kOff)
+    fDigitizer->Digitize(evtID, SiHC ? SiHC->GetArena() : 0);
+  // Shape the pulses of the APDs
+  if (write && fShaper->IsEnabled())
+    fShaper->Shape(SiHC ? SiHC->GetArena() : 0);
+
   G4int nHits; // Number of hits
 #ifdef AIDA_USE
   // Fill the tuple
 
   // Make sure there aren't going to be any issues with NULL pointers
-  if (fTuple)
+  if (fTuple && write)
   {
     if (SiHC)
     {
       G4int hitID = 0;
       // Get the number of hits
       nHits = SiHC->entries();
-      // Loop through all of the hits.
-      for (G4int i = 0; i < nHits; i++)
+      // Loop through all of the hits, or the sampled ones.
+      G4int nRows = selected ? (G4int) selected->size() : nHits;
+      for (G4int row = 0; row < nRows; row++)
       {
+        G4int i = selected ? (G4int) (*selected)[row] : row;
         // If there is a nonzero energy deposit, store information about the
         // hit in the tuple. 
-        singCrysSiliconHit* hit = (*SiHC)[i];
-        G4int APDNb = hit->GetAPDNb();
-        G4double eDep = hit->GetEdep();
-        G4ThreeVector position = hit->GetPos();
-        G4ThreeVector momentum = hit->GetPVec();
+        singCrysSiliconHit hit = (*SiHC)[i];
+        G4double eDep = hit.GetEdep();
         if (eDep > 0.)
         {
-          fTuple->fill(0, evtID);
-          fTuple->fill(1, APDNb);
-          fTuple->fill(2, hitID);
-          fTuple->fill(3, eDep);
-          fTuple->fill(4, position.x());
-          fTuple->fill(5, position.y());
-          fTuple->fill(6, position.z());
-          fTuple->fill(7, momentum.x());
-          fTuple->fill(8, momentum.y());
-          fTuple->fill(9, momentum.z());
+          fTuple->fill(colEvent, evtID);
+          fTuple->fill(colDeposit, selected ? i : hitID);
+          if (colAPD >= 0) fTuple->fill(colAPD, hit.GetAPDNb());
+          if (fSchema->GetPrecision() == singCrysHitSchema::kQuantized)
+            fTuple->fill(colEnergy, (short)
+              (singCrysHitSchema::QuantizeEnergy(eDep) - 32768));
+          else
+            FillTupleColumn(colEnergy, eDep);
+          if (colTime >= 0) FillTupleColumn(colTime, hit.GetTime());
+          if (colPos >= 0)
+          {
+            G4ThreeVector position = hit.GetPos();
+            FillTupleColumn(colPos, position.x());
+            FillTupleColumn(colPos + 1, position.y());
+            FillTupleColumn(colPos + 2, position.z());
+          }
+          if (colMom >= 0)
+          {
+            G4ThreeVector momentum = hit.GetPVec();
+            FillTupleColumn(colMom, momentum.x());
+            FillTupleColumn(colMom + 1, momentum.y());
+            FillTupleColumn(colMom + 2, momentum.z());
+          }
+          if (colTrack >= 0) fTuple->fill(colTrack, hit.GetTrackID());
           fTuple->addRow();
           hitID++;
         }
       }
     }
   }
+  if (fEventTuple && write && fSampler->IsSampled())
+  {
+    fEventTuple->fill(0, evtID);
+    fEventTuple->fill(1, nHitsEvent);
+    fEventTuple->fill(2, totalEnergy);
+    fEventTuple->fill(3, sampleWeight);
+    fEventTuple->addRow();
+  }
+  if (fAPDTuple && write)
+  {
+    const std::vector<G4double>& amplitude = fDigitizer->GetAmplitudes();
+    for (size_t i = 0; i < amplitude.size(); i++)
+    {
+      fAPDTuple->fill(0, evtID);
+      fAPDTuple->fill(1, (G4int) i);
+      fAPDTuple->fill(2, amplitude[i]);
+      fAPDTuple->addRow();
+    }
+    if (fDigitizer->HasSum())
+    {
+      fAPDTuple->fill(0, evtID);
+      fAPDTuple->fill(1, -1);
+      fAPDTuple->fill(2, fDigitizer->GetSum());
+      fAPDTuple->addRow();
+    }
+  }
+  if (fPulseTuple && write)
+  {
+    for (size_t i = 0; i < fShaper->GetAmplitudes().size(); i++)
+    {
+      fPulseTuple->fill(0, evtID);
+      fPulseTuple->fill(1, (G4int) i);
+      fPulseTuple->fill(2, fShaper->GetAmplitudes()[i]);
+      fPulseTuple->fill(3, fShaper->GetTimes()[i]);
+      fPulseTuple->addRow();
+    }
+  }
 #endif // AIDA_USE
   
 #ifdef ROOT_USE
-  APDID.clear();
-  energy.clear();
-  xPos.clear();
-  yPos.clear();
-  zPos.clear();
-  xPVec.clear();
-  yPVec.clear();
-  zPVec.clear();
+  doubleHits.clear();
+  floatHits.clear();
+  energyCode.clear();
   eventID = evtID;
-  if (SiHC)
+  if (fPhotonTally->IsEnabled()) photonFates = fPhotonTally->GetEventCounts();
+  if (SiHC && write)
   {
     // Get the number of hits
     nHits = SiHC->entries();
     G4cout << nHits << " hits" << G4endl;
-    // Loop through all of the hits.
-    for (G4int i = 0; i < nHits; i++)
-    {
-      // Get the energy deposit from the hit. If it is nonzero, store
-      // the data in the appropriate vectors, to be added to the file.
-      singCrysSiliconHit* hit = (*SiHC)[i];
-      G4int APDNb = hit->GetAPDNb();
-      G4double eDep = hit->GetEdep();
-      G4ThreeVector position = hit->GetPos();
-      G4ThreeVector momentum = hit->GetPVec();
-      if (eDep > 0.)
-      {
-        APDID.push_back(APDNb);
-        energy.push_back(eDep);
-        xPos.push_back(position.x());
-        yPos.push_back(position.y());
-        zPos.push_back(position.z());
-        xPVec.push_back(momentum.x());
-        yPVec.push_back(momentum.y());
-        zPVec.push_back(momentum.z());
-      }
+    // Copy the hits to the vectors, to be added to the file. The sensitive
+    // detector only records hits with a nonzero energy deposit.
+    if (fDigitizer->GetMode() != singCrysDigitizer::kOnly)
+    {
+      if (fSchema->GetPrecision() == singCrysHitSchema::kDouble)
+        FillHits(doubleHits, SiHC->GetArena(), selected);
+      else
+        FillHits(floatHits, SiHC->GetArena(), selected);
+    }
+    if (fDigitizer->GetMode() != singCrysDigitizer::kOff)
+    {
+      amplitudes = fDigitizer->GetAmplitudes();
+      amplitudeSum = fDigitizer->GetSum();
+    }
+    if (fShaper->IsEnabled())
+    {
+      pulseAmplitudes = fShaper->GetAmplitudes();
+      pulseTimes = fShaper->GetTimes();
     }
     // After all hits have been processed, add the event ID and energy vector
     // to the tree.
@@ -197,4 +711,38 @@ void singCrysEventAction::EndOfEventAction(const G4Event* evt)
   }
 #endif // ROOT_USE
 
+  // Commit the AIDA tree periodically, so that rows do not pile up in
+  // memory until the end of the job.
+  nEventsProcessed++;
+#ifdef AIDA_USE
+  if (aidaCommitEvery > 0 && nEventsProcessed % aidaCommitEvery == 0)
+  {
+    if (!singCrysAIDAManager::getInstance()->commit())
+      G4cerr << "Commit failed: AIDA file not updated!" << G4endl;
+  }
+#endif // AIDA_USE
+  // Force everything out to disk if the process is above the memory ceiling.
+  // If flushing does not bring it below, the memory is not held by the
+  // output, and the next flush waits until the memory grows further.
+  if (memCeiling > 0 && memCheckEvery > 0
+      && nEventsProcessed % memCheckEvery == 0
+      && ResidentMemory() > memThreshold)
+  {
+    FlushOutput();
+    G4double memory = ResidentMemory();
+    if (memory > memCeiling && memThreshold == memCeiling)
+    {
+      G4cerr << "Warning: memory use is still above 'outputMemCeiling' ("
+        << memCeiling << " MB) after flushing the output. The output is "
+        << "flushed again when it exceeds " << memory << " MB." << G4endl;
+    }
+    memThreshold = std::max(memCeiling, memory);
+  }
+
+  // Write a checkpoint if one is due. On SIGINT/SIGTERM, stop after this
+  // event; the run manager then writes the final checkpoint.
+  checkpoint->EventDone();
+  if (checkpoint->IsEnabled() && checkpoint->IsDue()) WriteCheckpoint();
+  if (singCrysCheckpoint::StopRequested())
+    G4RunManager::GetRunManager()->AbortRun(true);
 }
@@ -0,0 +1,56 @@
+/*!
+ * \file singCrysHitSampler.cc
+ * \brief Implementation file for the singCrysHitSampler class. Chooses the
+ * events and hits whose details are written in the sampled output mode.
+ */
+
+#include "singCrysHitSampler.hh"
+#include "singCrysConfig.hh"
+#include <boost/program_options.hpp>
+#include <algorithm>
+
+namespace po = boost::program_options;
+
+// Constructor. Get the options.
+singCrysHitSampler::singCrysHitSampler()
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  G4String mode = (G4String) config["outputMode"].as<std::string>();
+  fraction = config["sampleFraction"].as<G4double>();
+  maxPhotons = config["samplePhotons"].as<G4int>();
+  seed = config["sampleSeed"].as<G4long>();
+  if (mode.compareTo("full") == 0) sampled = false;
+  else if (mode.compareTo("sampled") == 0) sampled = true;
+  else
+  {
+    G4cerr << "Unknown output mode " << mode << ". Using full." << G4endl;
+    sampled = false;
+  }
+  if (sampled && (fraction <= 0. || fraction > 1.))
+  {
+    G4cerr << "sampleFraction must be in (0, 1]. Using 1." << G4endl;
+    fraction = 1.;
+  }
+}
+
+// Samples the event, then a reservoir of hits (algorithm R)
+G4double singCrysHitSampler::Sample(G4int eventID, size_t nHits)
+{
+  selected.clear();
+  if (nHits == 0) return 0.;
+  // The seeds are zero-terminated, so the event number is offset by one
+  long seeds[3] = {seed, (long) eventID + 1, 0};
+  engine.setSeeds(seeds, 0);
+  if (fraction < 1. && engine.flat() >= fraction) return 0.;
+
+  size_t nKeep = nHits;
+  if (maxPhotons > 0 && nHits > (size_t) maxPhotons) nKeep = maxPhotons;
+  for (size_t i = 0; i < nKeep; i++) selected.push_back(i);
+  for (size_t i = nKeep; i < nHits; i++)
+  {
+    size_t j = (size_t) (engine.flat() * (i + 1));
+    if (j < nKeep) selected[j] = i;
+  }
+  std::sort(selected.begin(), selected.end());
+  return (G4double) nHits / (nKeep * fraction);
+}
@@ -0,0 +1,77 @@
+/*!
+ * \file singCrysHitSchema.cc
+ * \brief Implementation file for the singCrysHitSchema class. Selects which
+ * hit fields are recorded and with which precision.
+ */
+
+#include "singCrysHitSchema.hh"
+#include "singCrysConfig.hh"
+#include "G4SystemOfUnits.hh"
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <vector>
+
+namespace po = boost::program_options;
+
+// Initialize static members
+const G4double singCrysHitSchema::quantMinEnergy = 1.3 * eV;
+const G4double singCrysHitSchema::quantMaxEnergy = 3.6 * eV;
+
+// Constructor. Parse the field list and the precision.
+singCrysHitSchema::singCrysHitSchema() : fields(0), precision(kDouble)
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  std::string fieldStr = config["hitFields"].as<std::string>();
+  G4String precisionStr = (G4String) config["hitPrecision"].as<std::string>();
+
+  // Split the comma separated list of fields
+  std::vector<std::string> names;
+  boost::split(names, fieldStr, boost::is_any_of(", "),
+               boost::token_compress_on);
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    G4String name = names[i];
+    if (name.compareTo("") == 0) continue;
+    else if (name.compareTo("energy") == 0) fields |= kEnergy;
+    else if (name.compareTo("APDID") == 0) fields |= kAPD;
+    else if (name.compareTo("time") == 0) fields |= kTime;
+    else if (name.compareTo("position") == 0) fields |= kPosition;
+    else if (name.compareTo("momentum") == 0) fields |= kMomentum;
+    else if (name.compareTo("trackID") == 0) fields |= kTrackID;
+    else G4cerr << "Unknown hit field " << name << ". Ignored." << G4endl;
+  }
+  // The energy is used to select hits, so it is always recorded.
+  fields |= kEnergy;
+
+  if (precisionStr.compareTo("double") == 0) precision = kDouble;
+  else if (precisionStr.compareTo("float") == 0) precision = kFloat;
+  else if (precisionStr.compareTo("quantized") == 0) precision = kQuantized;
+  else
+  {
+    G4cerr << "Unknown hit precision " << precisionStr << ". Using double."
+      << G4endl;
+    precision = kDouble;
+  }
+}
+
+// Returns the pointer to the singleton class.
+singCrysHitSchema* singCrysHitSchema::GetInstance()
+{
+  static singCrysHitSchema pInstance;
+  return &pInstance;
+}
+
+// Maps the energy band linearly onto 0-65535, clamping outside values
+unsigned short singCrysHitSchema::QuantizeEnergy(G4double energy)
+{
+  G4double frac = (energy - quantMinEnergy) / (quantMaxEnergy - quantMinEnergy);
+  if (frac <= 0.) return 0;
+  if (frac >= 1.) return 65535;
+  return (unsigned short) (frac * 65535. + 0.5);
+}
+
+// Inverse of QuantizeEnergy
+G4double singCrysHitSchema::DequantizeEnergy(unsigned short code)
+{
+  return quantMinEnergy + code * (quantMaxEnergy - quantMinEnergy) / 65535.;
+}
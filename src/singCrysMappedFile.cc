@@ -0,0 +1,53 @@
+/*!
+ * \file singCrysMappedFile.cc
+ * \brief Implementation file for the singCrysMappedFile class. Maps a file
+ * into memory.
+ */
+
+#include "singCrysMappedFile.hh"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Constructor: opens, measures, and maps the file. The descriptor is not
+// needed once the file is mapped.
+singCrysMappedFile::singCrysMappedFile(const G4String& filename)
+: data(0), size(0), ok(false)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+  {
+    size = st.st_size;
+    if (size == 0)
+    {
+      // mmap does not accept empty mappings
+      ok = true;
+    }
+    else
+    {
+      void* mapped = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED)
+      {
+        data = (const char*) mapped;
+        ok = true;
+        // The file is read once from start to end
+        madvise(mapped, size, MADV_SEQUENTIAL);
+      }
+      else
+      {
+        size = 0;
+      }
+    }
+  }
+  close(fd);
+}
+
+// Destructor: unmaps the file
+singCrysMappedFile::~singCrysMappedFile()
+{
+  if (data) munmap((void*) data, size);
+}
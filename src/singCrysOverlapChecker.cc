@@ -0,0 +1,282 @@
+/*!
+ * \file singCrysOverlapChecker.cc
+ * \brief Implementation file for the singCrysOverlapChecker class. Checks the
+ * geometry for overlapping volumes.
+ */
+
+#include "singCrysOverlapChecker.hh"
+#include "singCrysConfig.hh"
+#include "singCrysHash.hh"
+
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4UIsession.hh"
+#include "G4UImanager.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4Version.hh"
+
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <ctime>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+namespace po = boost::program_options;
+
+/*!
+ * \class singCrysPipeSession
+ * \brief UI session used in the overlap checking child processes. Sends
+ * G4cout and G4cerr unbuffered to a pipe read by the parent.
+ */
+class singCrysPipeSession : public G4UIsession
+{
+  public:
+    //! Constructor
+    /*!
+     * \param pipeFd File descriptor of the write end of the pipe
+     */
+    singCrysPipeSession(int pipeFd) : fd(pipeFd) {}
+    //! Writes G4cout to the pipe
+    virtual G4int ReceiveG4cout(const G4String& coutString)
+    {
+      WriteAll(coutString);
+      return 0;
+    }
+    //! Writes G4cerr to the pipe
+    virtual G4int ReceiveG4cerr(const G4String& cerrString)
+    {
+      WriteAll(cerrString);
+      return 0;
+    }
+
+  private:
+    //! Writes a whole string, retrying on short writes
+    void WriteAll(const std::string& str)
+    {
+      size_t done = 0;
+      while (done < str.size())
+      {
+        ssize_t n = write(fd, str.data() + done, str.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        done += n;
+      }
+    }
+    //! Write end of the pipe
+    int fd;
+};
+
+// Constructor. Get the options.
+singCrysOverlapChecker::singCrysOverlapChecker()
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  resolution = config["overlapResolution"].as<G4int>();
+  tolerance = config["overlapTolerance"].as<G4double>() * mm;
+  jobs = config["overlapJobs"].as<G4int>();
+  cacheDir = config["overlapCacheDir"].as<std::string>();
+  // 0 jobs: one per processor
+  if (jobs <= 0) jobs = (G4int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (jobs <= 0) jobs = 1;
+}
+
+// Checks the geometry, unless it is in the cache
+G4bool singCrysOverlapChecker::Check(G4VPhysicalVolume* world)
+{
+  placements.clear();
+  std::vector<G4LogicalVolume*> visited;
+  CollectPlacements(world->GetLogicalVolume(), visited);
+
+  // Look for the geometry in the cache
+  std::string cacheFile;
+  if (!cacheDir.empty())
+  {
+    cacheFile = cacheDir + "/overlaps-" + GeometryHash() + ".ok";
+    if (std::ifstream(cacheFile.c_str()))
+    {
+      G4cout << "Overlap check skipped: this geometry passed before ("
+        << cacheFile << ")." << G4endl;
+      return true;
+    }
+  }
+
+  // Check. Forking is not worth it for a single job.
+  time_t start = time(NULL);
+  G4int nJobs = std::min(jobs, (G4int) placements.size());
+  G4bool ok;
+  if (nJobs <= 1) ok = CheckShare(0, 1) == 0;
+  else ok = CheckInChildren(nJobs);
+  G4cout << "Checked " << placements.size() << " placements for overlaps in "
+    << difftime(time(NULL), start) << " s with " << std::max(nJobs, 1)
+    << " job(s): " << (ok ? "no overlaps." : "OVERLAPS FOUND.") << G4endl;
+
+  // Remember geometries without overlaps
+  if (ok && !cacheFile.empty())
+  {
+    mkdir(cacheDir.c_str(), 0755);
+    std::ofstream outf(cacheFile.c_str());
+    outf << "resolution = " << resolution << "\n"
+         << "tolerance = " << tolerance / mm << " mm\n"
+         << "placements = " << placements.size() << "\n";
+    if (!outf)
+    {
+      G4cerr << "Warning: could not write overlap cache file " << cacheFile
+        << G4endl;
+    }
+  }
+  return ok;
+}
+
+// Depth-first walk through the volume tree
+void singCrysOverlapChecker::
+  CollectPlacements(G4LogicalVolume* logical,
+                    std::vector<G4LogicalVolume*>& visited)
+{
+  if (std::find(visited.begin(), visited.end(), logical) != visited.end())
+    return;
+  visited.push_back(logical);
+  for (G4int i = 0; i < logical->GetNoDaughters(); i++)
+  {
+    G4VPhysicalVolume* daughter = logical->GetDaughter(i);
+    placements.push_back(daughter);
+    CollectPlacements(daughter->GetLogicalVolume(), visited);
+  }
+}
+
+// Hashes the solids, placements, and options. StreamInfo gives all the
+// parameters of a solid, including the constituents of boolean solids.
+std::string singCrysOverlapChecker::GeometryHash() const
+{
+  singCrysHash hash;
+  hash.Add((G4int) G4VERSION_NUMBER);
+  hash.Add(resolution);
+  hash.Add(tolerance);
+  for (size_t i = 0; i < placements.size(); i++)
+  {
+    G4VPhysicalVolume* pv = placements[i];
+    std::ostringstream solid;
+    solid.precision(17);
+    pv->GetLogicalVolume()->GetSolid()->StreamInfo(solid);
+    hash.Add(solid.str());
+    hash.Add(std::string(pv->GetName()));
+    hash.Add(std::string(pv->GetMotherLogical()->GetName()));
+    hash.Add(pv->GetCopyNo());
+    G4ThreeVector translation = pv->GetTranslation();
+    hash.Add(translation.x());
+    hash.Add(translation.y());
+    hash.Add(translation.z());
+    const G4RotationMatrix* rotation = pv->GetRotation();
+    if (rotation)
+    {
+      hash.Add(rotation->xx()); hash.Add(rotation->xy());
+      hash.Add(rotation->xz()); hash.Add(rotation->yx());
+      hash.Add(rotation->yy()); hash.Add(rotation->yz());
+      hash.Add(rotation->zx()); hash.Add(rotation->zy());
+      hash.Add(rotation->zz());
+    }
+  }
+  return hash.Hex();
+}
+
+// Checks every nJobs-th placement, starting at 'job'
+G4int singCrysOverlapChecker::CheckShare(G4int job, G4int nJobs)
+{
+  G4int nOverlaps = 0;
+  for (size_t i = job; i < placements.size(); i += nJobs)
+    if (placements[i]->CheckOverlaps(resolution, tolerance, true))
+      nOverlaps++;
+  return nOverlaps;
+}
+
+// Forks the children, collects their output, and waits for them
+G4bool singCrysOverlapChecker::CheckInChildren(G4int nJobs)
+{
+  // Make sure pending G4cout output is not inherited by the children
+  G4cout.flush();
+  std::vector<pid_t> pids;
+  std::vector<int> fds;
+  for (G4int job = 0; job < nJobs; job++)
+  {
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0) break;
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      close(pipeFds[0]);
+      close(pipeFds[1]);
+      break;
+    }
+    if (pid == 0)
+    {
+      // Child: send the output to the parent, check, and report the result
+      // in the exit status. _exit skips the exit handlers of the parent.
+      close(pipeFds[0]);
+      singCrysPipeSession session(pipeFds[1]);
+      G4UImanager::GetUIpointer()->SetCoutDestination(&session);
+      G4int nOverlaps = CheckShare(job, nJobs);
+      _exit(nOverlaps > 0 ? 1 : 0);
+    }
+    close(pipeFds[1]);
+    pids.push_back(pid);
+    fds.push_back(pipeFds[0]);
+  }
+  // Check whatever could not be given to a child here
+  G4bool ok = true;
+  for (G4int job = pids.size(); job < nJobs; job++)
+    if (CheckShare(job, nJobs) > 0) ok = false;
+
+  // Read all pipes until they are closed. They are read together, so that
+  // no child blocks on a full pipe.
+  std::vector<std::string> output(fds.size());
+  std::vector<struct pollfd> polls(fds.size());
+  for (size_t i = 0; i < fds.size(); i++)
+  {
+    polls[i].fd = fds[i];
+    polls[i].events = POLLIN;
+  }
+  size_t open = fds.size();
+  char buf[4096];
+  while (open > 0)
+  {
+    if (poll(&polls[0], polls.size(), -1) < 0)
+    {
+      if (errno == EINTR) continue;
+      break;
+    }
+    for (size_t i = 0; i < polls.size(); i++)
+    {
+      if (polls[i].fd < 0 || !polls[i].revents) continue;
+      ssize_t n = read(polls[i].fd, buf, sizeof(buf));
+      if (n > 0)
+      {
+        output[i].append(buf, n);
+      }
+      else if (n == 0 || errno != EINTR)
+      {
+        close(polls[i].fd);
+        polls[i].fd = -1;
+        open--;
+      }
+    }
+  }
+
+  // Collect the results, and print the output of each child in turn
+  for (size_t i = 0; i < pids.size(); i++)
+  {
+    int status = 0;
+    while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR) {}
+    G4cout << output[i];
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    if (!WIFEXITED(status))
+    {
+      G4cerr << "Overlap check job " << i << " did not finish." << G4endl;
+    }
+  }
+  return ok;
+}
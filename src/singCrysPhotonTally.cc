@@ -0,0 +1,122 @@
+/*!
+ * \file singCrysPhotonTally.cc
+ * \brief Implementation file for the singCrysPhotonTally class. Counts where
+ * the optical photons end up.
+ */
+
+#include "singCrysPhotonTally.hh"
+#include "singCrysConfig.hh"
+#include "G4SystemOfUnits.hh"
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+// Constructor. Get the option and size the counters.
+singCrysPhotonTally::singCrysPhotonTally() :
+  eventCounts(kNFates, 0),
+  runCounts(kNFates, 0),
+  runBounces(kNFates, 0.),
+  runLengths(kNFates, 0.)
+{
+  enabled = (*singCrysConfig::GetInstance()->GetMap())
+    ["photonFates"].as<G4bool>();
+}
+
+// Returns the pointer to the singleton class.
+singCrysPhotonTally* singCrysPhotonTally::GetInstance()
+{
+  static singCrysPhotonTally pInstance;
+  return &pInstance;
+}
+
+// Returns the name of a fate
+const char* singCrysPhotonTally::GetFateName(Fate fate)
+{
+  static const char* names[kNFates] = {"detected", "crystal", "wrapping",
+    "aluminum", "casing", "silicon", "epoxy", "escaped", "other"};
+  return names[fate];
+}
+
+// Resets the event counters
+void singCrysPhotonTally::BeginEvent()
+{
+  std::fill(eventCounts.begin(), eventCounts.end(), 0);
+}
+
+// Resets the run counters
+void singCrysPhotonTally::BeginRun()
+{
+  std::fill(runCounts.begin(), runCounts.end(), 0);
+  std::fill(runBounces.begin(), runBounces.end(), 0.);
+  std::fill(runLengths.begin(), runLengths.end(), 0.);
+}
+
+// Counts a photon in the event and in the run
+void singCrysPhotonTally::Record(Fate fate, G4int bounces, G4double length)
+{
+  eventCounts[fate]++;
+  runCounts[fate]++;
+  runBounces[fate] += bounces;
+  runLengths[fate] += length;
+}
+
+// Lists the nonzero counts of the event
+std::string singCrysPhotonTally::EventSummary() const
+{
+  std::ostringstream summary;
+  for (G4int i = 0; i < kNFates; i++)
+  {
+    if (eventCounts[i] == 0) continue;
+    if (!summary.str().empty()) summary << " ";
+    summary << GetFateName((Fate) i) << "=" << eventCounts[i];
+  }
+  return summary.str();
+}
+
+// Lists the fractions of the run
+std::string singCrysPhotonTally::RunSummary() const
+{
+  G4double total = 0.;
+  for (G4int i = 0; i < kNFates; i++) total += runCounts[i];
+  std::ostringstream summary;
+  summary << "photon fates (%):";
+  for (G4int i = 0; i < kNFates; i++)
+  {
+    summary << " " << GetFateName((Fate) i) << "="
+      << (total > 0. ? 100. * runCounts[i] / total : 0.);
+  }
+  return summary.str();
+}
+
+// Prints the counts, fractions, mean bounces and mean path lengths
+void singCrysPhotonTally::PrintRun() const
+{
+  G4double total = 0., bounces = 0., length = 0.;
+  for (G4int i = 0; i < kNFates; i++)
+  {
+    total += runCounts[i];
+    bounces += runBounces[i];
+    length += runLengths[i];
+  }
+  G4cout << "Photon fates:" << G4endl
+    << "  " << std::setw(10) << std::left << "fate" << std::right
+    << std::setw(12) << "photons" << std::setw(10) << "%"
+    << std::setw(10) << "bounces" << std::setw(14) << "length (mm)"
+    << G4endl;
+  for (G4int i = 0; i <= kNFates; i++)
+  {
+    // The last line is the total
+    G4double n = i < kNFates ? runCounts[i] : total;
+    G4double b = i < kNFates ? runBounces[i] : bounces;
+    G4double l = i < kNFates ? runLengths[i] : length;
+    G4cout << "  " << std::setw(10) << std::left
+      << (i < kNFates ? GetFateName((Fate) i) : "total") << std::right
+      << std::setw(12) << (G4long) n
+      << std::setw(10) << std::setprecision(3)
+      << (total > 0. ? 100. * n / total : 0.)
+      << std::setw(10) << (n > 0. ? b / n : 0.)
+      << std::setw(14) << (n > 0. ? l / n / mm : 0.) << G4endl;
+  }
+  G4cout << std::setprecision(6);
+}
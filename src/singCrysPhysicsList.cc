@@ -19,13 +19,27 @@
 #include "G4OpAbsorption.hh"
 #include "G4OpRayleigh.hh"
 #include "G4OpBoundaryProcess.hh"
+#include "G4FastSimulationManagerProcess.hh"
 
 #include "G4LossTableManager.hh"
 #include "G4EmSaturation.hh"
 //TODO: Mie scattering?
 
+#include "G4Material.hh"
+#include "G4Version.hh"
+
 #include "singCrysConfig.hh"
+#include "singCrysPhysicsProfile.hh"
+#include "singCrysHash.hh"
+#include "singCrysDepositLibrary.hh"
+#include "singCrysScintillation.hh"
 #include <boost/program_options.hpp>
+#include <cstdio>
+#include <sstream>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 // Constructor
 singCrysPhysicsList::singCrysPhysicsList()
@@ -37,8 +51,12 @@ singCrysPhysicsList::singCrysPhysicsList()
 //  theMieHGScatteringProcess = NULL;
   theBoundaryProcess = NULL;
 
-  // default cut value
-  defaultCutValue = 0.01*mm;
+  // default cut value, from the physics profile
+  defaultCutValue = singCrysPhysicsProfile::GetInstance()->GetCut();
+
+  tableCacheDir = (*singCrysConfig::GetInstance()->GetMap())
+    ["physicsTableCacheDir"].as<std::string>();
+  storeTables = false;
 
 }
 
@@ -111,11 +129,14 @@ void singCrysPhysicsList::ConstructBaryons()
 // Construct all physics processes
 void singCrysPhysicsList::ConstructProcess()
 {
+  // Report the settings used
+  singCrysPhysicsProfile::GetInstance()->Print();
   // Define transportation process
   AddTransportation();
   ConstructGeneral();
   ConstructEM();
   ConstructOp();
+  ConstructUserLimits();
 }
 
 #include "G4Decay.hh"
@@ -161,6 +182,11 @@ void singCrysPhysicsList::ConstructGeneral()
 // Helper function to construct all electromagnetic physics
 void singCrysPhysicsList::ConstructEM()
 {
+  // Whether muons and hadrons get EM processes. Without them, they are still
+  // tracked, with transportation and decay only: they lose no energy in
+  // matter.
+  G4bool muonHadronEM = singCrysPhysicsProfile::GetInstance()->
+    UseMuonHadronEM();
   theParticleIterator->reset();
   while ( (*theParticleIterator)() )
   {
@@ -190,7 +216,7 @@ void singCrysPhysicsList::ConstructEM()
       pmanager->AddProcess(new G4eBremsstrahlung(),   -1, 3, 3);
       pmanager->AddProcess(new G4eplusAnnihilation(),  0,-1, 4);
     }
-    else if (particleName == "mu+" || particleName == "mu-")
+    else if (muonHadronEM && (particleName == "mu+" || particleName == "mu-"))
     {
       // Muons
      pmanager->AddProcess(new G4MuMultipleScattering(),-1, 1, 1);
@@ -200,7 +226,7 @@ void singCrysPhysicsList::ConstructEM()
      pmanager->AddRestProcess(new G4MuonMinusCaptureAtRest);
 
     }
-    else
+    else if (muonHadronEM)
     {
       if ((particle->GetPDGCharge() != 0.0) && 
           (particle->GetParticleName() != "chargedgeantino"))
@@ -216,10 +242,25 @@ void singCrysPhysicsList::ConstructEM()
 // Helper function to construct all optical physics
 void singCrysPhysicsList::ConstructOp()
 {
-  theCerenkovProcess           = new G4Cerenkov("Cerenkov");
-  theScintillationProcess      = new G4Scintillation("Scintillation");
+  // Cerenkov light and Rayleigh scattering are optional
+  // No light is made at all when only the deposits are recorded
+  singCrysPhysicsProfile* profile = singCrysPhysicsProfile::GetInstance();
+  G4bool makeLight = !singCrysDepositLibrary::GetInstance()->IsEnabled();
+  if (!makeLight)
+    G4cout << "Writing the deposit library: no optical photons are made."
+      << G4endl;
+  // Scintillation photons may be made in batches
+  G4bool batchScintillation = (*singCrysConfig::GetInstance()->GetMap())
+    ["batchScintillation"].as<G4bool>();
+  if (profile->UseCerenkov() && makeLight)
+    theCerenkovProcess         = new G4Cerenkov("Cerenkov");
+  if (makeLight && batchScintillation)
+    theScintillationProcess    = new singCrysScintillation("Scintillation");
+  else if (makeLight)
+    theScintillationProcess    = new G4Scintillation("Scintillation");
   theAbsorptionProcess         = new G4OpAbsorption();
-  theRayleighScatteringProcess = new G4OpRayleigh();
+  if (profile->UseRayleigh())
+    theRayleighScatteringProcess = new G4OpRayleigh();
 //  theMieHGScatteringProcess    = new G4OpMieHG();
   theBoundaryProcess           = new G4OpBoundaryProcess();
 
@@ -229,12 +270,25 @@ void singCrysPhysicsList::ConstructOp()
 
   SetVerbose(optVerbosity); // Set verbosity
 
-  theCerenkovProcess->SetMaxNumPhotonsPerStep(20);
-  theCerenkovProcess->SetMaxBetaChangePerStep(10.0);
-  theCerenkovProcess->SetTrackSecondariesFirst(true);
+  // Optical photons in the crystal may be tracked by singCrysPrismTransport
+  G4FastSimulationManagerProcess* fastSimProcess = 0;
+  if (config["prismTransport"].as<G4bool>())
+    fastSimProcess = new G4FastSimulationManagerProcess();
 
-  theScintillationProcess->SetScintillationYieldFactor(1.);
-  theScintillationProcess->SetTrackSecondariesFirst(true);
+  if (theCerenkovProcess)
+  {
+    theCerenkovProcess->
+      SetMaxNumPhotonsPerStep(profile->GetCerenkovMaxPhotons());
+    theCerenkovProcess->
+      SetMaxBetaChangePerStep(profile->GetCerenkovMaxBetaChange());
+    theCerenkovProcess->SetTrackSecondariesFirst(true);
+  }
+
+  if (theScintillationProcess)
+  {
+    theScintillationProcess->SetScintillationYieldFactor(1.);
+    theScintillationProcess->SetTrackSecondariesFirst(true);
+  }
 
   // Comment back in to implement Birks correction
  // G4EmSaturation* emSaturation = G4LossTableManager::Instance()->EmSaturation();
@@ -246,12 +300,13 @@ void singCrysPhysicsList::ConstructOp()
     G4ParticleDefinition* particle = theParticleIterator->value();
     G4ProcessManager* pmanager = particle->GetProcessManager();
     G4String particleName = particle->GetParticleName();
-    if (theCerenkovProcess->IsApplicable(*particle))
+    if (theCerenkovProcess && theCerenkovProcess->IsApplicable(*particle))
     {
       pmanager->AddProcess(theCerenkovProcess);
       pmanager->SetProcessOrdering(theCerenkovProcess, idxPostStep);
     }
-    if (theScintillationProcess->IsApplicable(*particle))
+    if (theScintillationProcess &&
+        theScintillationProcess->IsApplicable(*particle))
     {
       pmanager->AddProcess(theScintillationProcess);
       pmanager->SetProcessOrderingToLast(theScintillationProcess, idxAtRest);
@@ -261,20 +316,54 @@ void singCrysPhysicsList::ConstructOp()
     {
       G4cout << "AddDiscreteProcess to OpticalPhoton " << G4endl;
       pmanager->AddDiscreteProcess(theAbsorptionProcess);
-      pmanager->AddDiscreteProcess(theRayleighScatteringProcess);
+      if (theRayleighScatteringProcess)
+        pmanager->AddDiscreteProcess(theRayleighScatteringProcess);
 //      pmanager->AddDiscreteProcess(theMieHGScatteringProcess);
       pmanager->AddDiscreteProcess(theBoundaryProcess);
+      if (fastSimProcess) pmanager->AddDiscreteProcess(fastSimProcess);
     }
   }
 }
 
+#include "G4StepLimiter.hh"
+#include "G4UserSpecialCuts.hh"
+
+// Helper function to enforce user limits on charged particles. The limits
+// themselves are G4UserLimits of the regions, set by
+// singCrysDetectorConstruction.
+void singCrysPhysicsList::ConstructUserLimits()
+{
+  singCrysPhysicsProfile* profile = singCrysPhysicsProfile::GetInstance();
+  G4bool maxStep = false;
+  G4bool minEkin = false;
+  for (G4int i = 0; i < singCrysPhysicsProfile::kNRegions; i++)
+  {
+    singCrysPhysicsProfile::Region region = (singCrysPhysicsProfile::Region) i;
+    if (profile->GetRegionMaxStep(region) > 0.) maxStep = true;
+    if (profile->GetRegionMinEkin(region) > 0.) minEkin = true;
+  }
+  G4StepLimiter* stepLimiter = maxStep ? new G4StepLimiter() : 0;
+  G4UserSpecialCuts* specialCuts = minEkin ? new G4UserSpecialCuts() : 0;
+  theParticleIterator->reset();
+  while ( (*theParticleIterator)() )
+  {
+    G4ParticleDefinition* particle = theParticleIterator->value();
+    if (particle->GetPDGCharge() == 0.0) continue;
+    G4ProcessManager* pmanager = particle->GetProcessManager();
+    if (stepLimiter) pmanager->AddDiscreteProcess(stepLimiter);
+    if (specialCuts) pmanager->AddDiscreteProcess(specialCuts);
+  }
+}
+
 // Function to set verbosity for all physics processes
 void singCrysPhysicsList::SetVerbose(G4int verbose)
 {
-  theCerenkovProcess->SetVerboseLevel(verbose);
-  theScintillationProcess->SetVerboseLevel(verbose);
+  if (theCerenkovProcess) theCerenkovProcess->SetVerboseLevel(verbose);
+  if (theScintillationProcess)
+    theScintillationProcess->SetVerboseLevel(verbose);
   theAbsorptionProcess->SetVerboseLevel(verbose);
-  theRayleighScatteringProcess->SetVerboseLevel(verbose);
+  if (theRayleighScatteringProcess)
+    theRayleighScatteringProcess->SetVerboseLevel(verbose);
 //  theMieHGScatteringProcess->SetVerboseLevel(verbose);
   theBoundaryProcess->SetVerboseLevel(verbose);
 }
@@ -285,4 +374,98 @@ void singCrysPhysicsList::SetCuts()
   SetCutsWithDefault();
   // Print them!
   if (verboseLevel > 0) DumpCutValuesTable();
+
+  // Retrieve the physics tables if this configuration is in the cache, or
+  // store them once they are built.
+  if (tableCacheDir.empty()) return;
+  tableDir = tableCacheDir + "/physics-" + TableHash();
+  struct stat info;
+  if (stat(tableDir.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+  {
+    G4cout << "Retrieving physics tables from " << tableDir << G4endl;
+    SetPhysicsTableRetrieved(tableDir);
+  }
+  else storeTables = true;
+}
+
+// Hashes the physics settings, the cuts, and the materials
+std::string singCrysPhysicsList::TableHash() const
+{
+  singCrysPhysicsProfile* profile = singCrysPhysicsProfile::GetInstance();
+  singCrysHash hash;
+  hash.Add((G4int) G4VERSION_NUMBER);
+  hash.Add(std::string(profile->GetName()));
+  hash.Add((G4int) profile->UseCerenkov());
+  hash.Add(profile->GetCerenkovMaxPhotons());
+  hash.Add(profile->GetCerenkovMaxBetaChange());
+  hash.Add((G4int) profile->UseRayleigh());
+  hash.Add((G4int) profile->UseMuonHadronEM());
+  hash.Add(defaultCutValue);
+  for (G4int i = 0; i < singCrysPhysicsProfile::kNRegions; i++)
+  {
+    singCrysPhysicsProfile::Region region = (singCrysPhysicsProfile::Region) i;
+    hash.Add(profile->GetRegionCut(region));
+    hash.Add((G4int) (profile->GetRegionMinEkin(region) > 0.));
+    hash.Add((G4int) (profile->GetRegionMaxStep(region) > 0.));
+  }
+  const G4MaterialTable* materials = G4Material::GetMaterialTable();
+  for (size_t i = 0; i < materials->size(); i++)
+  {
+    const G4Material* material = (*materials)[i];
+    hash.Add(std::string(material->GetName()));
+    hash.Add(material->GetDensity());
+    hash.Add((G4int) material->GetState());
+    hash.Add(material->GetTemperature());
+    hash.Add(material->GetPressure());
+    hash.Add(material->GetIonisation()->GetMeanExcitationEnergy());
+    const G4double* fractions = material->GetFractionVector();
+    for (size_t j = 0; j < material->GetNumberOfElements(); j++)
+    {
+      const G4Element* element = material->GetElement(j);
+      hash.Add(std::string(element->GetName()));
+      hash.Add(element->GetZ());
+      hash.Add(element->GetA());
+      hash.Add(fractions[j]);
+    }
+  }
+  return hash.Hex();
+}
+
+// Stores the tables in a temporary directory, and renames it. If another job
+// stored the same tables in the meantime, the rename fails and the copy is
+// deleted.
+void singCrysPhysicsList::StoreTableCache()
+{
+  if (!storeTables) return;
+  storeTables = false;
+  mkdir(tableCacheDir.c_str(), 0755);
+  std::ostringstream tmpName;
+  tmpName << tableDir << ".tmp" << getpid();
+  std::string tmpDir = tmpName.str();
+  G4bool ok = mkdir(tmpDir.c_str(), 0755) == 0 &&
+    StorePhysicsTable(tmpDir);
+  if (ok && std::rename(tmpDir.c_str(), tableDir.c_str()) == 0)
+  {
+    G4cout << "Stored physics tables in " << tableDir << G4endl;
+    return;
+  }
+  if (!ok)
+  {
+    G4cerr << "Warning: could not store the physics tables in " << tmpDir
+      << G4endl;
+  }
+  // Delete the temporary directory and its files
+  DIR* dir = opendir(tmpDir.c_str());
+  if (dir)
+  {
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+      std::string file = entry->d_name;
+      if (file != "." && file != "..")
+        std::remove((tmpDir + "/" + file).c_str());
+    }
+    closedir(dir);
+  }
+  rmdir(tmpDir.c_str());
 }
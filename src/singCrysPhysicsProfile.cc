@@ -0,0 +1,106 @@
+/*!
+ * \file singCrysPhysicsProfile.cc
+ * \brief Implementation file for the singCrysPhysicsProfile class. Selects
+ * the processes and parameters of the physics list.
+ */
+
+#include "singCrysPhysicsProfile.hh"
+#include "singCrysConfig.hh"
+#include "G4SystemOfUnits.hh"
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+// Constructor. Get the settings of the selected profile.
+singCrysPhysicsProfile::singCrysPhysicsProfile()
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  name = (G4String) config["physicsProfile"].as<std::string>();
+  if (name.compareTo("fast") != 0 && name.compareTo("standard") != 0 &&
+      name.compareTo("reference") != 0)
+  {
+    G4cerr << "Unknown physics profile " << name << ". Using standard."
+      << G4endl;
+    name = "standard";
+  }
+  std::string prefix = "profile." + name + ".";
+  cerenkov = config[prefix + "cerenkov"].as<G4bool>();
+  cerenkovMaxPhotons = config[prefix + "cerenkovMaxPhotons"].as<G4int>();
+  cerenkovMaxBetaChange =
+    config[prefix + "cerenkovMaxBetaChange"].as<G4double>();
+  rayleigh = config[prefix + "rayleigh"].as<G4bool>();
+  muonHadronEM = config[prefix + "muonHadronEM"].as<G4bool>();
+  cut = config[prefix + "cut"].as<G4double>() * mm;
+  crystalMaxStep = config[prefix + "crystalMaxStep"].as<G4double>() * mm;
+}
+
+// Returns the pointer to the singleton class.
+singCrysPhysicsProfile* singCrysPhysicsProfile::GetInstance()
+{
+  static singCrysPhysicsProfile pInstance;
+  return &pInstance;
+}
+
+// Prints the settings
+void singCrysPhysicsProfile::Print() const
+{
+  G4cout << "Physics profile '" << name << "':" << G4endl
+    << "  Cerenkov light:           " << (cerenkov ? "on" : "off");
+  if (cerenkov)
+  {
+    G4cout << " (at most " << cerenkovMaxPhotons << " photons and "
+      << cerenkovMaxBetaChange << "% beta change per step)";
+  }
+  G4cout << G4endl
+    << "  Rayleigh scattering:      " << (rayleigh ? "on" : "off") << G4endl
+    << "  EM for muons and hadrons: " << (muonHadronEM ? "on" : "off")
+    << G4endl
+    << "  Production cut:           " << cut / mm << " mm" << G4endl
+    << "  Max. step in crystal:     ";
+  if (crystalMaxStep > 0.) G4cout << crystalMaxStep / mm << " mm" << G4endl;
+  else G4cout << "none" << G4endl;
+  for (G4int i = 0; i < kNRegions; i++)
+  {
+    Region region = (Region) i;
+    G4cout << "  Region " << GetRegionName(region) << ": cut "
+      << GetRegionCut(region) / mm << " mm, max. step ";
+    if (GetRegionMaxStep(region) > 0.)
+      G4cout << GetRegionMaxStep(region) / mm << " mm";
+    else G4cout << "none";
+    G4cout << ", min. kinetic energy ";
+    if (GetRegionMinEkin(region) > 0.)
+      G4cout << GetRegionMinEkin(region) / keV << " keV" << G4endl;
+    else G4cout << "none" << G4endl;
+  }
+}
+
+// Returns the name of a region
+G4String singCrysPhysicsProfile::GetRegionName(Region region)
+{
+  static const char* names[kNRegions] = {"crystal", "APD", "passive"};
+  return names[region];
+}
+
+// Returns the production cut of a region
+G4double singCrysPhysicsProfile::GetRegionCut(Region region) const
+{
+  G4double regionCut = (*singCrysConfig::GetInstance()->GetMap())
+    ["region." + GetRegionName(region) + ".cut"].as<G4double>() * mm;
+  return regionCut > 0. ? regionCut : cut;
+}
+
+// Returns the maximum step in a region
+G4double singCrysPhysicsProfile::GetRegionMaxStep(Region region) const
+{
+  G4double maxStep = (*singCrysConfig::GetInstance()->GetMap())
+    ["region." + GetRegionName(region) + ".maxStep"].as<G4double>() * mm;
+  if (maxStep <= 0. && region == kCrystalRegion) maxStep = crystalMaxStep;
+  return maxStep;
+}
+
+// Returns the minimum kinetic energy in a region
+G4double singCrysPhysicsProfile::GetRegionMinEkin(Region region) const
+{
+  return (*singCrysConfig::GetInstance()->GetMap())
+    ["region." + GetRegionName(region) + ".minEkin"].as<G4double>() * keV;
+}
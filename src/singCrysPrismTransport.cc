@@ -0,0 +1,507 @@
+/*!
+ * \file singCrysPrismTransport.cc
+ * \brief Implementation file for the singCrysPrismTransport class. Tracks
+ * optical photons through the crystal analytically.
+ */
+
+#include "singCrysPrismTransport.hh"
+#include "singCrysPhysicsProfile.hh"
+#include "G4FastTrack.hh"
+#include "G4FastStep.hh"
+#include "G4Material.hh"
+#include "G4MaterialPropertiesTable.hh"
+#include "G4OpticalSurface.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4RandomDirection.hh"
+#include "G4LogicalVolume.hh"
+#include "G4AffineTransform.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4GeometryTolerance.hh"
+#include "Randomize.hh"
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+  //! Distance from a face at which photons are handed back to GEANT4
+  const G4double kHandBackDistance = 1. * nm;
+
+  //! Value of a property at an energy, or a default if it is missing
+  G4double PropertyValue(G4MaterialPropertiesTable* table, const char* name,
+                         G4double energy, G4double missing)
+  {
+    if (!table) return missing;
+    G4MaterialPropertyVector* property = table->GetProperty(name);
+    return property ? property->Value(energy) : missing;
+  }
+
+  //! Direction drawn from a Lambertian distribution about a normal, as
+  //! G4LambertianRand does
+  G4ThreeVector LambertianDirection(const G4ThreeVector& normal)
+  {
+    G4ThreeVector direction;
+    G4double cosAngle;
+    do
+    {
+      direction = G4RandomDirection();
+      cosAngle = normal * direction;
+      if (cosAngle < 0.)
+      {
+        direction = -direction;
+        cosAngle = -cosAngle;
+      }
+    } while (!(G4UniformRand() < cosAngle));
+    return direction;
+  }
+}
+
+// Constructor. Make the faces of the prism in its own frame.
+singCrysPrismTransport::singCrysPrismTransport(const G4String& name,
+  G4Envelope* regionEnvelope, G4int nSides, G4double apothem, G4double halfZ,
+  G4Material* crystalMat, G4Material* layer1, G4Material* insert,
+  G4OpticalSurface* layer1Surface, G4OpticalSurface* insertSurface) :
+  G4VFastSimulationModel(name, regionEnvelope),
+  envelope(regionEnvelope),
+  crystal(crystalMat),
+  maxInteractions(1000000)
+{
+  rayleigh = singCrysPhysicsProfile::GetInstance()->UseRayleigh();
+  // The sides start with +y, which faces the insert
+  for (G4int i = 0; i < nSides; i++)
+  {
+    G4double phi = 0.5 * pi + twopi * i / nSides;
+    Face face;
+    face.normal = G4ThreeVector(std::cos(phi), std::sin(phi), 0.);
+    face.distance = apothem;
+    face.outside = i == 0 ? insert : layer1;
+    face.surface = i == 0 ? insertSurface : layer1Surface;
+    faces.push_back(face);
+  }
+  // Layer 1 covers the +z end, and the APDs are at the -z end
+  Face top = {G4ThreeVector(0., 0., 1.), halfZ, layer1, layer1Surface};
+  Face bottom = {G4ThreeVector(0., 0., -1.), halfZ, 0, 0};
+  faces.push_back(top);
+  faces.push_back(bottom);
+}
+
+// Destructor
+singCrysPrismTransport::~singCrysPrismTransport()
+{}
+
+// Applies to optical photons
+G4bool singCrysPrismTransport::IsApplicable(const G4ParticleDefinition&
+                                            particle)
+{
+  return &particle == G4OpticalPhoton::OpticalPhotonDefinition();
+}
+
+// Triggers unless the photon sits at a face left to GEANT4, heading out
+G4bool singCrysPrismTransport::ModelTrigger(const G4FastTrack& fastTrack)
+{
+  G4ThreeVector position = fastTrack.GetPrimaryTrackLocalPosition();
+  G4ThreeVector direction = fastTrack.GetPrimaryTrackLocalDirection();
+  G4double energy = fastTrack.GetPrimaryTrack()->GetKineticEnergy();
+  for (size_t i = 0; i < faces.size(); i++)
+  {
+    const Face& face = faces[i];
+    if (face.normal * direction <= 0.) continue;
+    if (face.distance - face.normal * position > 2. * kHandBackDistance)
+      continue;
+    G4double rindex2;
+    if (!IsAnalytic(face, energy, rindex2)) return false;
+  }
+  return true;
+}
+
+// Whether the model reproduces G4OpBoundaryProcess at a face
+G4bool singCrysPrismTransport::IsAnalytic(const Face& face, G4double energy,
+                                          G4double& rindex2) const
+{
+  // Only dielectric_dielectric surfaces of the unified model, polished or
+  // ground. Painted surfaces and metals are left to GEANT4.
+  if (!face.surface || !face.outside) return false;
+  if (face.surface->GetType() != dielectric_dielectric) return false;
+  if (face.surface->GetModel() != unified) return false;
+  G4OpticalSurfaceFinish finish = face.surface->GetFinish();
+  if (finish != polished && finish != ground) return false;
+  // Surfaces that absorb or let photons straight through are left to
+  // GEANT4, so that photons are only absorbed there by G4OpBoundaryProcess
+  G4MaterialPropertiesTable* surfaceTable =
+    face.surface->GetMaterialPropertiesTable();
+  if (surfaceTable && (surfaceTable->GetProperty("REFLECTIVITY") ||
+                       surfaceTable->GetProperty("REALRINDEX") ||
+                       surfaceTable->GetProperty("TRANSMITTANCE")))
+    return false;
+  // Without a refractive index beyond the face, GEANT4 kills the photon
+  G4MaterialPropertiesTable* table =
+    face.outside->GetMaterialPropertiesTable();
+  G4MaterialPropertyVector* rindex = table ? table->GetProperty("RINDEX") : 0;
+  if (!rindex) return false;
+  rindex2 = rindex->Value(energy);
+  return true;
+}
+
+// Hands the photon to Transport(), and proposes its final state
+void singCrysPrismTransport::DoIt(const G4FastTrack& fastTrack,
+                                  G4FastStep& fastStep)
+{
+  const G4Track* track = fastTrack.GetPrimaryTrack();
+  Photon photon;
+  photon.position = fastTrack.GetPrimaryTrackLocalPosition();
+  photon.momentum = fastTrack.GetPrimaryTrackLocalDirection();
+  photon.polarization = fastTrack.GetInverseAffineTransformation()->
+    TransformAxis(track->GetPolarization());
+  photon.energy = track->GetKineticEnergy();
+  photon.time = track->GetGlobalTime();
+  photon.length = 0.;
+  Outcome outcome = Transport(photon);
+
+  fastStep.ProposePrimaryTrackFinalPosition(photon.position);
+  fastStep.ProposePrimaryTrackFinalTime(photon.time);
+  fastStep.ProposePrimaryTrackPathLength(photon.length);
+  if (outcome != kHandedBack)
+  {
+    fastStep.KillPrimaryTrack();
+    return;
+  }
+  fastStep.ProposePrimaryTrackFinalMomentumDirection(photon.momentum);
+  fastStep.ProposePrimaryTrackFinalPolarization(photon.polarization);
+}
+
+// Whether a volume belongs to the crystal region
+G4bool singCrysPrismTransport::Covers(const G4LogicalVolume* volume) const
+{
+  return volume->GetRegion() == envelope;
+}
+
+// Moves the photon from face to face until it is absorbed or handed back
+singCrysPrismTransport::Outcome
+  singCrysPrismTransport::Transport(Photon& photon) const
+{
+  G4ThreeVector& position = photon.position;
+  G4ThreeVector& momentum = photon.momentum;
+  G4ThreeVector& polarization = photon.polarization;
+  G4double energy = photon.energy;
+  G4double startTime = photon.time;
+  G4double length = 0.;
+
+  // Properties of the crystal at the energy of the photon. They are looked
+  // up for each photon, since they can be changed between runs.
+  G4MaterialPropertiesTable* table = crystal->GetMaterialPropertiesTable();
+  G4double rindex1 = PropertyValue(table, "RINDEX", energy, 1.);
+  G4double absLength = PropertyValue(table, "ABSLENGTH", energy, DBL_MAX);
+  G4double rayLength = rayleigh ?
+    PropertyValue(table, "RAYLEIGH", energy, DBL_MAX) : DBL_MAX;
+  G4double speed = PropertyValue(table, "GROUPVEL", energy,
+                                 c_light / rindex1);
+
+  Outcome outcome = kBulkAbsorbed;
+  G4int interaction = 0;
+  for (; interaction < maxInteractions; interaction++)
+  {
+    // Nearest face along the direction of the photon. It is inside all of
+    // the planes, so there is always one ahead of it.
+    size_t next = 0;
+    G4double toFace = DBL_MAX;
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+      G4double cosAngle = faces[i].normal * momentum;
+      if (cosAngle <= 0.) continue;
+      G4double distance = (faces[i].distance - faces[i].normal * position)
+        / cosAngle;
+      if (distance < toFace)
+      {
+        toFace = std::max(distance, 0.);
+        next = i;
+      }
+    }
+
+    // Absorption and Rayleigh scattering on the way
+    G4double toAbsorption = -absLength * std::log(G4UniformRand());
+    G4double toScattering = -rayLength * std::log(G4UniformRand());
+    if (std::min(toAbsorption, toScattering) < toFace)
+    {
+      G4double distance = std::min(toAbsorption, toScattering);
+      position += distance * momentum;
+      length += distance;
+      if (toAbsorption < toScattering)
+      {
+        outcome = kBulkAbsorbed;
+        break;
+      }
+      RayleighScatter(momentum, polarization);
+      continue;
+    }
+
+    position += toFace * momentum;
+    length += toFace;
+    const Face& face = faces[next];
+    G4double rindex2;
+    if (face.outside == crystal)
+    {
+      // GEANT4 does nothing between identical materials. The photon is
+      // handed back just outside the face.
+      position += kHandBackDistance * face.normal;
+      outcome = kHandedBack;
+      break;
+    }
+    else if (IsAnalytic(face, energy, rindex2))
+    {
+      if (!DielectricDielectric(face, rindex1, rindex2, energy, momentum,
+                                polarization))
+        continue;
+      // Refracted photons are handed back just outside the face, in the
+      // volume beyond it
+      position += kHandBackDistance * face.normal;
+      outcome = kHandedBack;
+      break;
+    }
+    else
+    {
+      // Hand the photon back just inside the face, unchanged
+      position -= kHandBackDistance * face.normal;
+      outcome = kHandedBack;
+      break;
+    }
+  }
+
+  // Only a crystal without absorption can trap a photon for good
+  if (interaction == maxInteractions)
+  {
+    G4cerr << "Optical photon still in the crystal after " << maxInteractions
+      << " interactions. Killing it." << G4endl;
+    outcome = kBulkAbsorbed;
+  }
+  photon.time = startTime + length / speed;
+  photon.length += length;
+  return outcome;
+}
+
+// Port of G4OpBoundaryProcess::DielectricDielectric() (GEANT4 9.6) for a
+// polished or ground surface of the unified model. Its normal points into
+// the crystal, and the materials are swapped when a refracted photon turns
+// back into the crystal at a facet.
+G4bool singCrysPrismTransport::DielectricDielectric(const Face& face,
+  G4double rindex1, G4double rindex2, G4double energy,
+  G4ThreeVector& momentum, G4ThreeVector& polarization) const
+{
+  G4OpticalSurface* surface = face.surface;
+  G4MaterialPropertiesTable* table = surface->GetMaterialPropertiesTable();
+  G4bool polishedFinish = surface->GetFinish() == polished;
+  G4double sigmaAlpha = surface->GetSigmaAlpha();
+  // The reflection constants are properties of the energy, as in
+  // G4OpBoundaryProcess
+  G4double probSpike = PropertyValue(table, "SPECULARSPIKECONSTANT", energy,
+                                     0.);
+  G4double probLobe = PropertyValue(table, "SPECULARLOBECONSTANT", energy, 0.);
+  G4double probBack = PropertyValue(table, "BACKSCATTERCONSTANT", energy, 0.);
+  G4double tolerance =
+    G4GeometryTolerance::GetInstance()->GetSurfaceTolerance();
+
+  G4ThreeVector globalNormal = -face.normal;
+  G4bool swap = false;
+  G4bool through = false;
+  G4bool done = false;
+  do
+  {
+    if (through)
+    {
+      swap = !swap;
+      through = false;
+      globalNormal = -globalNormal;
+      std::swap(rindex1, rindex2);
+    }
+
+    G4ThreeVector facetNormal = polishedFinish ? globalNormal :
+      FacetNormal(momentum, globalNormal, sigmaAlpha);
+    G4double cost1 = -momentum * facetNormal;
+    G4double sint1, sint2;
+    if (std::abs(cost1) < 1. - tolerance)
+    {
+      sint1 = std::sqrt(1. - cost1 * cost1);
+      sint2 = sint1 * rindex1 / rindex2;
+    }
+    else
+    {
+      sint1 = 0.;
+      sint2 = 0.;
+    }
+
+    G4ThreeVector newMomentum, newPolarization;
+    G4bool refracted = false;
+    // Reflection: 0 specular about the facet, 1 Lambertian, 2 backscatter
+    G4int reflection = -1;
+    G4ThreeVector aTrans, aParal;
+    G4double e1Perp = 0., e1Parl = 0., e2Perp = 0., e2Parl = 0.;
+    if (sint2 >= 1.)
+    {
+      // Total internal reflection
+      if (swap) swap = !swap;
+      reflection = 0;
+    }
+    else
+    {
+      G4double cost2 = std::sqrt(1. - sint2 * sint2);
+      if (cost1 <= 0.) cost2 = -cost2;
+      if (sint1 > 0.)
+      {
+        aTrans = momentum.cross(facetNormal).unit();
+        e1Perp = polarization * aTrans;
+        e1Parl = (polarization - e1Perp * aTrans).mag();
+      }
+      else
+      {
+        // Normal incidence
+        aTrans = polarization;
+        e1Perp = 0.;
+        e1Parl = 1.;
+      }
+      G4double s1 = rindex1 * cost1;
+      e2Perp = 2. * s1 * e1Perp / (rindex1 * cost1 + rindex2 * cost2);
+      e2Parl = 2. * s1 * e1Parl / (rindex2 * cost1 + rindex1 * cost2);
+      G4double e2Total = e2Perp * e2Perp + e2Parl * e2Parl;
+      G4double s2 = rindex2 * cost2 * e2Total;
+      G4double transCoeff = cost1 != 0. ? s2 / s1 : 0.;
+
+      if (G4UniformRand() >= transCoeff)
+      {
+        // Fresnel reflection
+        if (swap) swap = !swap;
+        reflection = 0;
+      }
+      else
+      {
+        // Fresnel refraction
+        through = true;
+        refracted = true;
+        if (sint1 > 0.)
+        {
+          G4double alpha = cost1 - cost2 * (rindex2 / rindex1);
+          newMomentum = (momentum + alpha * facetNormal).unit();
+          aParal = newMomentum.cross(aTrans).unit();
+          G4double e2Abs = std::sqrt(e2Total);
+          newPolarization = (e2Parl / e2Abs) * aParal
+            + (e2Perp / e2Abs) * aTrans;
+        }
+        else
+        {
+          newMomentum = momentum;
+          newPolarization = polarization;
+        }
+      }
+    }
+
+    if (reflection == 0 && !polishedFinish)
+    {
+      // ChooseReflection() of the unified model
+      G4double random = G4UniformRand();
+      if (random < probSpike) facetNormal = globalNormal;
+      else if (random > probSpike + probLobe)
+        reflection = random < probSpike + probLobe + probBack ? 2 : 1;
+    }
+    if (reflection == 1)
+    {
+      newMomentum = LambertianDirection(globalNormal);
+      facetNormal = (newMomentum - momentum).unit();
+      newPolarization = -polarization
+        + (2. * (polarization * facetNormal)) * facetNormal;
+    }
+    else if (reflection == 2)
+    {
+      newMomentum = -momentum;
+      newPolarization = -polarization;
+    }
+    else if (reflection == 0)
+    {
+      newMomentum = momentum - (2. * (momentum * facetNormal)) * facetNormal;
+      if (sint2 >= 1.)
+      {
+        newPolarization = -polarization
+          + (2. * (polarization * facetNormal)) * facetNormal;
+      }
+      else if (sint1 > 0.)
+      {
+        G4double parl = rindex2 * e2Parl / rindex1 - e1Parl;
+        G4double perp = e2Perp - e1Perp;
+        G4double e2Abs = std::sqrt(parl * parl + perp * perp);
+        aParal = newMomentum.cross(aTrans).unit();
+        newPolarization = (parl / e2Abs) * aParal + (perp / e2Abs) * aTrans;
+      }
+      else
+      {
+        newPolarization = rindex2 > rindex1 ? -polarization : polarization;
+      }
+    }
+
+    momentum = newMomentum.unit();
+    polarization = newPolarization.unit();
+    if (refracted) done = (momentum * globalNormal <= 0.);
+    else done = (momentum * globalNormal >= -tolerance);
+  } while (!done);
+
+  // The photon leaves the crystal if it heads out of the face
+  return momentum * face.normal > 0.;
+}
+
+// Facet normal drawn from p(alpha) = g(alpha; 0, sigma alpha) sin(alpha), as
+// G4OpBoundaryProcess::GetFacetNormal() does for the unified model
+G4ThreeVector singCrysPrismTransport::FacetNormal(const G4ThreeVector&
+  momentum, const G4ThreeVector& normal, G4double sigmaAlpha) const
+{
+  if (sigmaAlpha == 0.) return normal;
+  G4double fMax = std::min(1., 4. * sigmaAlpha);
+  G4ThreeVector facetNormal;
+  do
+  {
+    G4double alpha;
+    do
+    {
+      alpha = G4RandGauss::shoot(0., sigmaAlpha);
+    } while (G4UniformRand() * fMax > std::sin(alpha) || alpha >= halfpi);
+    G4double phi = G4UniformRand() * twopi;
+    facetNormal = G4ThreeVector(std::sin(alpha) * std::cos(phi),
+                                std::sin(alpha) * std::sin(phi),
+                                std::cos(alpha));
+    facetNormal.rotateUz(normal);
+  } while (momentum * facetNormal >= 0.);
+  return facetNormal;
+}
+
+// Port of G4OpRayleigh::PostStepDoIt() (GEANT4 9.6)
+void singCrysPrismTransport::RayleighScatter(G4ThreeVector& momentum,
+                                             G4ThreeVector& polarization) const
+{
+  G4ThreeVector newMomentum, newPolarization;
+  G4double cosTheta;
+  do
+  {
+    // Direction of the scattered photon, relative to the old one
+    G4double cosScatter = G4UniformRand();
+    G4double sinScatter = std::sqrt(1. - cosScatter * cosScatter);
+    if (G4UniformRand() < 0.5) cosScatter = -cosScatter;
+    G4double phi = twopi * G4UniformRand();
+    newMomentum = G4ThreeVector(sinScatter * std::cos(phi),
+                                sinScatter * std::sin(phi), cosScatter);
+    newMomentum.rotateUz(momentum);
+    newMomentum = newMomentum.unit();
+    // The new polarization is in the plane of the new direction and the old
+    // polarization
+    newPolarization = polarization - (newMomentum * polarization) * newMomentum;
+    if (newPolarization.mag() == 0.)
+    {
+      phi = twopi * G4UniformRand();
+      newPolarization = G4ThreeVector(std::cos(phi), std::sin(phi), 0.);
+      newPolarization.rotateUz(newMomentum);
+    }
+    else
+    {
+      newPolarization = newPolarization.unit();
+      if (G4UniformRand() < 0.5) newPolarization = -newPolarization;
+    }
+    // Dipole distribution, cos^2 of the angle between the polarizations
+    cosTheta = newPolarization * polarization;
+  } while (cosTheta * cosTheta < G4UniformRand());
+  momentum = newMomentum;
+  polarization = newPolarization;
+}
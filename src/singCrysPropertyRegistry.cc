@@ -0,0 +1,285 @@
+/*!
+ * \file singCrysPropertyRegistry.cc
+ * \brief Implementation file for the singCrysPropertyRegistry class. Parses
+ * the optical data files once and caches them.
+ */
+
+#include "singCrysPropertyRegistry.hh"
+#include "singCrysConfig.hh"
+#include "singCrysHash.hh"
+#include "singCrysMappedFile.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace po = boost::program_options;
+
+// Version of the cache format and of the parsing. Changing it invalidates
+// the cache files.
+static const G4int cacheVersion = 1;
+// First bytes of a cache file
+static const char cacheMagic[8] = {'s', 'c', 'P', 'r', 'o', 'p', 0, 0};
+
+// Constructor. Get the cache directory.
+singCrysPropertyRegistry::singCrysPropertyRegistry()
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  cacheDir = config["propertyCacheDir"].as<std::string>();
+}
+
+// Returns the pointer to the singleton class.
+singCrysPropertyRegistry* singCrysPropertyRegistry::GetInstance()
+{
+  static singCrysPropertyRegistry pInstance;
+  return &pInstance;
+}
+
+// Splits "file:x,y" into the path and the (1-based) columns. Without a
+// column suffix, columns 1 and 2 are used.
+static void splitColumns(const G4String& spec, std::string& path,
+                         G4int& xCol, G4int& yCol)
+{
+  path = spec;
+  xCol = 1;
+  yCol = 2;
+  size_t colon = spec.rfind(':');
+  if (colon == std::string::npos) return;
+  int x = 0, y = 0;
+  char end = 0;
+  if (std::sscanf(spec.c_str() + colon + 1, "%d,%d%c", &x, &y, &end) == 2 &&
+      x > 0 && y > 0)
+  {
+    path = spec.substr(0, colon);
+    xCol = x;
+    yCol = y;
+  }
+}
+
+// Parses a number between 'begin' and 'end'. strtod needs a terminated
+// string, and the mapped file is not terminated, so the token is copied.
+static G4bool parseNumber(const char* begin, const char* end, G4double& value)
+{
+  char buf[64];
+  size_t len = end - begin;
+  if (len == 0 || len >= sizeof(buf)) return false;
+  std::memcpy(buf, begin, len);
+  buf[len] = 0;
+  char* parsedEnd = 0;
+  value = std::strtod(buf, &parsedEnd);
+  return parsedEnd == buf + len;
+}
+
+// Whether a character separates fields
+static inline G4bool isSeparator(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == ',' || c == ';';
+}
+
+// Looks up the contents of a file by their hash, parsing them only if they
+// are neither in memory nor in the cache
+const singCrysPropertyData* singCrysPropertyRegistry::
+  Get(const G4String& filename)
+{
+  std::string path;
+  G4int xCol, yCol;
+  splitColumns(filename, path, xCol, yCol);
+  singCrysMappedFile file(path);
+  if (!file.IsOpen())
+  {
+    G4ExceptionDescription msg;
+    msg << path << " cannot be read.";
+    G4Exception("singCrysPropertyRegistry::Get()", "singCrysData001",
+                FatalException, msg);
+  }
+  singCrysHash hash;
+  hash.Add(cacheVersion);
+  hash.Add(xCol);
+  hash.Add(yCol);
+  hash.Add(file.Begin(), file.Size());
+  std::string key = hash.Hex();
+
+  // In memory
+  std::map<std::string, singCrysPropertyData>::iterator it =
+    entries.find(key);
+  if (it != entries.end()) return &it->second;
+
+  // In the cache, or parsed
+  singCrysPropertyData& data = entries[key];
+  std::string cacheFile;
+  if (!cacheDir.empty()) cacheFile = cacheDir + "/props-" + key + ".bin";
+  if (cacheFile.empty() || !ReadCache(cacheFile, data))
+  {
+    Parse(path, file.Begin(), file.End(), xCol, yCol, data);
+    if (!cacheFile.empty()) WriteCache(cacheFile, data);
+  }
+  return &data;
+}
+
+// Parses the file line by line, and checks the entries
+void singCrysPropertyRegistry::Parse(const G4String& filename,
+                                     const char* begin, const char* end,
+                                     G4int xCol, G4int yCol,
+                                     singCrysPropertyData& data)
+{
+  G4ExceptionDescription msg;
+  G4int declared = -1;
+  std::vector<G4double> wavelengths;
+  std::vector<G4double> fields;
+  G4int lineNb = 0;
+  for (const char* line = begin; line < end; )
+  {
+    const char* eol = std::find(line, end, '\n');
+    const char* stop = std::find(line, eol, '#');
+    lineNb++;
+    // Split the line, up to any comment, into numbers
+    fields.clear();
+    const char* p = line;
+    while (true)
+    {
+      while (p < stop && isSeparator(*p)) p++;
+      if (p >= stop) break;
+      const char* tokenEnd = p;
+      while (tokenEnd < stop && !isSeparator(*tokenEnd)) tokenEnd++;
+      G4double value;
+      if (!parseNumber(p, tokenEnd, value))
+      {
+        msg << filename << ", line " << lineNb << ": '"
+          << std::string(p, tokenEnd) << "' is not a number.";
+        G4Exception("singCrysPropertyRegistry::Parse()", "singCrysData002",
+                    FatalException, msg);
+      }
+      fields.push_back(value);
+      p = tokenEnd;
+    }
+    line = eol < end ? eol + 1 : end;
+    if (fields.empty()) continue;
+    // A single number before any entry is the number of entries
+    if (declared < 0 && wavelengths.empty() && fields.size() == 1)
+    {
+      declared = (G4int) fields[0];
+      if (declared <= 0 || declared != fields[0])
+      {
+        msg << filename << ", line " << lineNb << ": the number of entries "
+          << fields[0] << " is not a positive integer.";
+        G4Exception("singCrysPropertyRegistry::Parse()", "singCrysData003",
+                    FatalException, msg);
+      }
+      wavelengths.reserve(declared);
+      data.values.reserve(declared);
+      continue;
+    }
+    if ((G4int) fields.size() < std::max(xCol, yCol))
+    {
+      msg << filename << ", line " << lineNb << ": " << fields.size()
+        << " columns, but column " << std::max(xCol, yCol) << " is used.";
+      G4Exception("singCrysPropertyRegistry::Parse()", "singCrysData004",
+                  FatalException, msg);
+    }
+    wavelengths.push_back(fields[xCol - 1]);
+    data.values.push_back(fields[yCol - 1]);
+  }
+  G4int nEntries = (G4int) wavelengths.size();
+  if (nEntries == 0 || (declared >= 0 && nEntries != declared))
+  {
+    msg << filename << " has " << nEntries << " entries";
+    if (declared >= 0) msg << " instead of " << declared;
+    msg << ".";
+    G4Exception("singCrysPropertyRegistry::Parse()", "singCrysData005",
+                FatalException, msg);
+  }
+
+  // Check the values
+  G4bool warned = false;
+  for (G4int i = 0; i < nEntries; i++)
+  {
+    if (!(wavelengths[i] > 0.) || !(data.values[i] >= 0.))
+    {
+      msg << filename << ", entry " << i + 1 << " (" << wavelengths[i] << " "
+        << data.values[i] << "): the wavelength is not positive or the value"
+        << " is negative.";
+      G4Exception("singCrysPropertyRegistry::Parse()", "singCrysData006",
+                  FatalException, msg);
+    }
+    if (i > 0 && (wavelengths[i] - wavelengths[i - 1]) *
+                 (wavelengths[1] - wavelengths[0]) <= 0.)
+    {
+      msg << filename << ": the wavelengths are not strictly monotonic at"
+        << " entry " << i + 1 << ".";
+      G4Exception("singCrysPropertyRegistry::Parse()", "singCrysData007",
+                  FatalException, msg);
+    }
+    if ((wavelengths[i] < 100. || wavelengths[i] > 2000.) && !warned)
+    {
+      msg << filename << " has a wavelength of " << wavelengths[i]
+        << " nm. Are the wavelengths in nm?";
+      G4Exception("singCrysPropertyRegistry::Parse()", "singCrysData008",
+                  JustWarning, msg);
+      msg.str("");
+      warned = true;
+    }
+  }
+
+  // Convert the wavelengths to increasing energies
+  if (nEntries > 1 && wavelengths[1] > wavelengths[0])
+  {
+    std::reverse(wavelengths.begin(), wavelengths.end());
+    std::reverse(data.values.begin(), data.values.end());
+  }
+  data.energies.resize(nEntries);
+  for (G4int i = 0; i < nEntries; i++)
+    data.energies[i] = hbarc * twopi / (wavelengths[i] * nm);
+}
+
+// Reads the header, the number of entries, and the arrays
+G4bool singCrysPropertyRegistry::ReadCache(const std::string& cacheFile,
+                                           singCrysPropertyData& data)
+{
+  std::ifstream inf(cacheFile.c_str(), std::ios::binary);
+  if (!inf) return false;
+  char magic[sizeof(cacheMagic)];
+  uint64_t nEntries = 0;
+  inf.read(magic, sizeof(magic));
+  inf.read((char*) &nEntries, sizeof(nEntries));
+  if (!inf || !std::equal(magic, magic + sizeof(magic), cacheMagic) ||
+      nEntries == 0 || nEntries > (1ULL << 32))
+    return false;
+  data.energies.resize(nEntries);
+  data.values.resize(nEntries);
+  inf.read((char*) &data.energies[0], nEntries * sizeof(G4double));
+  inf.read((char*) &data.values[0], nEntries * sizeof(G4double));
+  return (bool) inf;
+}
+
+// Writes the cache file under a temporary name, and renames it, so that
+// other jobs never read a partial file
+void singCrysPropertyRegistry::WriteCache(const std::string& cacheFile,
+                                          const singCrysPropertyData& data)
+{
+  mkdir(cacheDir.c_str(), 0755);
+  std::ostringstream tmpName;
+  tmpName << cacheFile << ".tmp" << getpid();
+  std::ofstream outf(tmpName.str().c_str(), std::ios::binary);
+  uint64_t nEntries = data.energies.size();
+  outf.write(cacheMagic, sizeof(cacheMagic));
+  outf.write((const char*) &nEntries, sizeof(nEntries));
+  outf.write((const char*) &data.energies[0], nEntries * sizeof(G4double));
+  outf.write((const char*) &data.values[0], nEntries * sizeof(G4double));
+  outf.close();
+  if (!outf || std::rename(tmpName.str().c_str(), cacheFile.c_str()) != 0)
+  {
+    G4cerr << "Warning: could not write property cache file " << cacheFile
+      << G4endl;
+    std::remove(tmpName.str().c_str());
+  }
+}
@@ -0,0 +1,146 @@
+/*!
+ * \file singCrysPulseShaper.cc
+ * \brief Implementation file for the singCrysPulseShaper class. Makes the
+ * pulse of each APD from the arrival times of its hits.
+ */
+
+#include "singCrysPulseShaper.hh"
+#include "singCrysSiliconHitsCollection.hh"
+#include "singCrysConfig.hh"
+#include "singCrysHitSchema.hh"
+#include "G4SystemOfUnits.hh"
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace po = boost::program_options;
+
+// Constructor. Get the options, size the histograms, and sample the kernel.
+singCrysPulseShaper::singCrysPulseShaper()
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  enabled = config["pulseShape"].as<G4bool>();
+  binWidth = config["pulseBinWidth"].as<G4double>() * ns;
+  G4double window = config["pulseWindow"].as<G4double>() * ns;
+  G4double tau = config["pulseShapingTime"].as<G4double>() * ns;
+  G4int order = config["pulseShapingOrder"].as<G4int>();
+  cfdFraction = config["cfdFraction"].as<G4double>();
+  if (binWidth <= 0.)
+  {
+    G4cerr << "pulseBinWidth must be positive. Using 1 ns." << G4endl;
+    binWidth = 1. * ns;
+  }
+  if (order < 0)
+  {
+    G4cerr << "pulseShapingOrder must not be negative. Using 0." << G4endl;
+    order = 0;
+  }
+  if (cfdFraction <= 0. || cfdFraction >= 1.)
+  {
+    G4cerr << "cfdFraction must be in (0, 1). Using 0.2." << G4endl;
+    cfdFraction = 0.2;
+  }
+  nBins = std::max((G4int) (window / binWidth), 1);
+  G4int nAPD = std::max(config["nAPD"].as<G4int>(), 1);
+  amplitudes.assign(nAPD, 0.);
+  times.assign(nAPD, -1.);
+  if (!enabled) return;
+  // The arrival times of the hits are histogrammed per APD
+  singCrysHitSchema::GetInstance()->Require(singCrysHitSchema::kAPD);
+  singCrysHitSchema::GetInstance()->Require(singCrysHitSchema::kTime);
+  counts.assign((size_t) nAPD * nBins, 0.);
+  pulse.assign(nBins, 0.);
+  firstBin.assign(nAPD, nBins);
+  lastBin.assign(nAPD, -1);
+
+  // Sample the kernel up to where it has decayed to 1e-4 of its peak, past
+  // the peak, or to the end of the window
+  if (tau <= 0.) tau = binWidth;
+  for (G4int i = 0; i < nBins; i++)
+  {
+    G4double t = (i + 0.5) * binWidth;
+    G4double value = order > 0 ?
+      std::pow(t / (order * tau), order) * std::exp(order - t / tau) :
+      std::exp(-t / tau);
+    kernel.push_back(value);
+    if (t > order * tau && value < 1e-4) break;
+  }
+}
+
+// Histograms the arrival times per APD, then shapes and analyzes each pulse
+void singCrysPulseShaper::Shape(const singCrysSiliconHitArena* arena)
+{
+  typedef singCrysSiliconHitArena A;
+  if (!enabled) return;
+  size_t nAPD = amplitudes.size();
+  // Only the bins filled in the last event need to be cleared
+  for (size_t a = 0; a < nAPD; a++)
+  {
+    if (lastBin[a] >= firstBin[a])
+      std::fill(counts.begin() + a * nBins + firstBin[a],
+                counts.begin() + a * nBins + lastBin[a] + 1, 0.);
+    firstBin[a] = nBins;
+    lastBin[a] = -1;
+  }
+  // The time and APD of each hit are recorded when shaping
+  if (arena && arena->Has(A::kTime) && arena->Has(A::kAPDNb))
+  {
+    for (size_t i = 0; i < arena->Size(); i++)
+    {
+      G4int a = arena->Get(A::kAPDNb, i);
+      G4double t = arena->Get(A::kTime, i);
+      if (a < 0 || a >= (G4int) nAPD || t < 0.) continue;
+      G4int bin = (G4int) (t / binWidth);
+      if (bin >= nBins) continue;
+      counts[a * nBins + bin] += 1.;
+      firstBin[a] = std::min(firstBin[a], bin);
+      lastBin[a] = std::max(lastBin[a], bin);
+    }
+  }
+  for (size_t a = 0; a < nAPD; a++)
+  {
+    amplitudes[a] = 0.;
+    times[a] = -1.;
+    if (lastBin[a] < 0) continue;
+    Convolve(&counts[a * nBins], firstBin[a], lastBin[a]);
+    Analyze(firstBin[a], amplitudes[a], times[a]);
+  }
+}
+
+// Adds the kernel, scaled by each nonzero bin, to the pulse. Only the bins
+// between the first and last filled ones are visited.
+void singCrysPulseShaper::Convolve(const G4double* hist, G4int first,
+                                   G4int last)
+{
+  std::fill(pulse.begin() + first, pulse.end(), 0.);
+  const G4double* k = &kernel[0];
+  G4int nKernel = kernel.size();
+  for (G4int j = first; j <= last; j++)
+  {
+    G4double w = hist[j];
+    if (w == 0.) continue;
+    G4double* out = &pulse[j];
+    G4int n = std::min(nKernel, nBins - j);
+    for (G4int m = 0; m < n; m++) out[m] += w * k[m];
+  }
+}
+
+// Finds the maximum, then walks down the leading edge to the constant
+// fraction of it
+void singCrysPulseShaper::Analyze(G4int first, G4double& amplitude,
+                                  G4double& time) const
+{
+  G4int peak = std::max_element(pulse.begin() + first, pulse.end())
+    - pulse.begin();
+  amplitude = pulse[peak];
+  time = -1.;
+  if (amplitude <= 0.) return;
+  G4double threshold = cfdFraction * amplitude;
+  G4int i = peak;
+  while (i > first && pulse[i - 1] >= threshold) i--;
+  // The pulse is 0 before the first bin, so the crossing is in the bin
+  // before 'i' at the latest
+  G4double below = i > first ? pulse[i - 1] : 0.;
+  G4double fraction = (threshold - below) / (pulse[i] - below);
+  time = (i - 0.5 + fraction) * binWidth / ns;
+}
@@ -0,0 +1,108 @@
+/*!
+ * \file singCrysRunAction.cc
+ * \brief Implementation file for the singCrysRun and singCrysRunAction
+ * classes. Summarize the hits of each run.
+ */
+
+#include "singCrysRunAction.hh"
+#include "singCrysSiliconHitsCollection.hh"
+#include "singCrysPhotonTally.hh"
+
+#include "G4Event.hh"
+#include "G4HCofThisEvent.hh"
+#include "G4SDManager.hh"
+
+#include <cmath>
+#include <sstream>
+
+// Constructor
+singCrysRun::singCrysRun(G4int HCID) : G4Run(),
+  fSiHCID(HCID),
+  nEventsWithHits(0),
+  sumHits(0.),
+  sumHits2(0.)
+{}
+
+// Adds the number of hits of the event
+void singCrysRun::RecordEvent(const G4Event* evt)
+{
+  G4Run::RecordEvent(evt);
+  G4HCofThisEvent* HCE = evt->GetHCofThisEvent();
+  if (!HCE || fSiHCID < 0) return;
+  singCrysSiliconHitsCollection* SiHC =
+    (singCrysSiliconHitsCollection*)(HCE->GetHC(fSiHCID));
+  if (!SiHC) return;
+  G4double nHits = SiHC->entries();
+  if (nHits > 0) nEventsWithHits++;
+  sumHits += nHits;
+  sumHits2 += nHits * nHits;
+}
+
+// Constructor: get the hits collection
+singCrysRunAction::singCrysRunAction()
+{
+  G4SDManager* SDman = G4SDManager::GetSDMpointer();
+  fSiHCID = SDman->GetCollectionID("SiliconHitsCollection");
+  cpuStart = 0;
+  gettimeofday(&wallStart, NULL);
+}
+
+// Destructor
+singCrysRunAction::~singCrysRunAction()
+{}
+
+// Makes the run
+G4Run* singCrysRunAction::GenerateRun()
+{
+  return new singCrysRun(fSiHCID);
+}
+
+// Starts the timers and the photon fate counts
+void singCrysRunAction::BeginOfRunAction(const G4Run*)
+{
+  singCrysPhotonTally* tally = singCrysPhotonTally::GetInstance();
+  if (tally->IsEnabled()) tally->BeginRun();
+  cpuStart = std::clock();
+  gettimeofday(&wallStart, NULL);
+}
+
+// Makes the summary
+void singCrysRunAction::EndOfRunAction(const G4Run* run)
+{
+  const singCrysRun* singCrysThisRun = dynamic_cast<const singCrysRun*>(run);
+  if (!singCrysThisRun) return;
+  G4int nEvents = run->GetNumberOfEvent();
+  G4double mean = 0., rms = 0., fraction = 0.;
+  if (nEvents > 0)
+  {
+    mean = singCrysThisRun->GetSumHits() / nEvents;
+    G4double variance = singCrysThisRun->GetSumHits2() / nEvents - mean * mean;
+    rms = variance > 0. ? std::sqrt(variance) : 0.;
+    fraction = (G4double) singCrysThisRun->GetEventsWithHits() / nEvents;
+  }
+  struct timeval wallEnd;
+  gettimeofday(&wallEnd, NULL);
+  G4double wall = (wallEnd.tv_sec - wallStart.tv_sec)
+    + 1e-6 * (wallEnd.tv_usec - wallStart.tv_usec);
+  std::ostringstream summary;
+  summary << "run " << run->GetRunID() << ": " << nEvents << " events, "
+    << mean << " +- " << (nEvents > 0 ? rms / std::sqrt((G4double) nEvents)
+                                      : 0.)
+    << " hits/event (RMS " << rms << "), " << fraction * 100.
+    << "% with hits, "
+    << (G4double) (std::clock() - cpuStart) / CLOCKS_PER_SEC << " s CPU, "
+    << wall << " s wall";
+  singCrysPhotonTally* tally = singCrysPhotonTally::GetInstance();
+  if (tally->IsEnabled()) summary << ", " << tally->RunSummary();
+  G4cout << "Summary of " << summary.str() << G4endl;
+  if (tally->IsEnabled()) tally->PrintRun();
+  summaries.push_back(summary.str());
+}
+
+// Returns and forgets the summaries
+std::vector<std::string> singCrysRunAction::TakeSummaries()
+{
+  std::vector<std::string> taken;
+  taken.swap(summaries);
+  return taken;
+}
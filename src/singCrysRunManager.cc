@@ -0,0 +1,65 @@
+/*!
+ * \file singCrysRunManager.cc
+ * \brief Implementation file for the singCrysRunManager class. Run manager
+ * that supports checkpointing and resuming.
+ */
+
+#include "singCrysRunManager.hh"
+#include "singCrysCheckpoint.hh"
+#include "singCrysEventAction.hh"
+#include "singCrysPrimaryGeneratorAction.hh"
+#include "singCrysPhysicsList.hh"
+
+// Constructor
+singCrysRunManager::singCrysRunManager() : G4RunManager()
+{}
+
+// Destructor
+singCrysRunManager::~singCrysRunManager()
+{}
+
+// Starts a run, skipping the events that are already in the checkpoint
+void singCrysRunManager::BeamOn(G4int n_event, const char* macroFile,
+                                G4int n_select)
+{
+  // After SIGINT/SIGTERM, do not start anything new.
+  if (singCrysCheckpoint::StopRequested())
+  {
+    G4cout << "Stop requested. Skipping /run/beamOn " << n_event << G4endl;
+    return;
+  }
+  singCrysCheckpoint* checkpoint = singCrysCheckpoint::GetInstance();
+  singCrysPrimaryGeneratorAction* PGA =
+    dynamic_cast<singCrysPrimaryGeneratorAction*>(userPrimaryGeneratorAction);
+  G4ThreeVector gunPos = PGA ? PGA->getGunPos() : G4ThreeVector();
+  G4int done = checkpoint->BeginRun(n_event, gunPos);
+  if (done >= n_event)
+  {
+    G4cout << "Run of " << n_event << " events already done in checkpoint. "
+      << "Skipping." << G4endl;
+    return;
+  }
+  if (done > 0)
+  {
+    G4cout << "Resuming run: " << done << " of " << n_event
+      << " events already done." << G4endl;
+  }
+  G4RunManager::BeamOn(n_event - done, macroFile, n_select);
+
+  // Flush the output and record the finished (or interrupted) run.
+  singCrysEventAction* eventAction =
+    dynamic_cast<singCrysEventAction*>(userEventAction);
+  if (eventAction && (checkpoint->IsEnabled()
+                      || singCrysCheckpoint::StopRequested()))
+    eventAction->WriteCheckpoint();
+}
+
+// Prepares a run. The physics tables have been built (or retrieved) by the
+// kernel at this point.
+void singCrysRunManager::RunInitialization()
+{
+  G4RunManager::RunInitialization();
+  singCrysPhysicsList* singCrysPhysics =
+    dynamic_cast<singCrysPhysicsList*>(physicsList);
+  if (singCrysPhysics) singCrysPhysics->StoreTableCache();
+}
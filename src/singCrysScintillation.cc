@@ -0,0 +1,365 @@
+/*!
+ * \file singCrysScintillation.cc
+ * \brief Implementation file for the singCrysScintillation class. Makes the
+ * scintillation photons of a step in batches.
+ */
+
+#include "singCrysScintillation.hh"
+#include "singCrysConfig.hh"
+#include "singCrysDetectorConstruction.hh"
+#include "singCrysPrismTransport.hh"
+#include "singCrysPhotonTally.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4DynamicParticle.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4Material.hh"
+#include "G4MaterialPropertiesTable.hh"
+#include "G4EmSaturation.hh"
+#include "G4Poisson.hh"
+#include "G4RunManager.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4NavigationHistory.hh"
+#include "G4AffineTransform.hh"
+#include "G4PhysicalConstants.hh"
+#include "Randomize.hh"
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace po = boost::program_options;
+
+// Constructor. Get the number of bins of the tables.
+singCrysScintillation::singCrysScintillation(const G4String& processName) :
+  G4Scintillation(processName)
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  nBins = config["scintCDFBins"].as<G4int>();
+  if (nBins < 1)
+  {
+    G4cerr << "scintCDFBins must be positive. Using 1024." << G4endl;
+    nBins = 1024;
+  }
+}
+
+// Destructor
+singCrysScintillation::~singCrysScintillation()
+{}
+
+// Resizes the arrays of the batch
+void singCrysScintillation::Batch::Resize(size_t n)
+{
+  energy.resize(n);
+  time.resize(n);
+  x.resize(n);
+  y.resize(n);
+  z.resize(n);
+  px.resize(n);
+  py.resize(n);
+  pz.resize(n);
+  sx.resize(n);
+  sy.resize(n);
+  sz.resize(n);
+  length.assign(n, 0.);
+  alive.assign(n, 1);
+}
+
+// The spectra may have changed since the last run
+void singCrysScintillation::BuildPhysicsTable(const G4ParticleDefinition&
+                                              particle)
+{
+  G4Scintillation::BuildPhysicsTable(particle);
+  fastCDFs.clear();
+  slowCDFs.clear();
+}
+
+// Tabulates the inverse of the cumulative distribution of a spectrum
+const std::vector<G4double>& singCrysScintillation::
+  InverseCDF(const G4Material* material, G4MaterialPropertyVector* spectrum,
+             G4bool fast)
+{
+  std::vector<std::vector<G4double> >& cdfs = fast ? fastCDFs : slowCDFs;
+  size_t index = material->GetIndex();
+  if (cdfs.size() <= index) cdfs.resize(index + 1);
+  std::vector<G4double>& table = cdfs[index];
+  if (!table.empty()) return table;
+
+  // Cumulative integral by the trapezoidal rule, as G4Scintillation
+  // integrates the spectrum
+  size_t n = spectrum->GetVectorLength();
+  std::vector<G4double> integral(n, 0.);
+  for (size_t i = 1; i < n; i++)
+  {
+    integral[i] = integral[i - 1]
+      + 0.5 * ((*spectrum)[i] + (*spectrum)[i - 1])
+      * (spectrum->Energy(i) - spectrum->Energy(i - 1));
+  }
+  // Energies at equally spaced values of the integral, interpolated
+  // linearly between the points of the spectrum
+  table.resize(nBins + 1);
+  size_t k = 0;
+  for (G4int j = 0; j <= nBins; j++)
+  {
+    G4double target = integral[n - 1] * j / nBins;
+    while (k + 2 < n && integral[k + 1] < target) k++;
+    G4double width = integral[k + 1] - integral[k];
+    G4double fraction = width > 0. ? (target - integral[k]) / width : 0.;
+    table[j] = spectrum->Energy(k)
+      + fraction * (spectrum->Energy(k + 1) - spectrum->Energy(k));
+  }
+  return table;
+}
+
+// Emission time with a finite rise time, as G4Scintillation::sample_time()
+// draws it: the decay exponential is the envelope of the bi-exponential,
+// and the ratio of the two is 1 - exp(-t / rise time)
+G4double singCrysScintillation::RiseDecayTime(G4double riseTime,
+                                              G4double decayTime) const
+{
+  while (true)
+  {
+    G4double t = -decayTime * std::log(1. - G4UniformRand());
+    if (G4UniformRand() <= 1. - std::exp(-t / riseTime)) return t;
+  }
+}
+
+// Fills the batch from begin to end with photons of one component
+void singCrysScintillation::Sample(const G4Track& aTrack, const G4Step& aStep,
+  const std::vector<G4double>& cdf, G4double decayTime, G4double riseTime,
+  size_t begin, size_t end)
+{
+  size_t n = end - begin;
+  // Six uniform numbers per photon, drawn at once, one array per quantity
+  uniforms.resize(6 * n);
+  CLHEP::HepRandom::getTheEngine()->flatArray(6 * n, &uniforms[0]);
+  const G4double* uEnergy = &uniforms[0];
+  const G4double* uCosTheta = uEnergy + n;
+  const G4double* uPhi = uCosTheta + n;
+  const G4double* uPolarization = uPhi + n;
+  const G4double* uPosition = uPolarization + n;
+  const G4double* uTime = uPosition + n;
+
+  G4double* energy = &batch.energy[begin];
+  G4double* time = &batch.time[begin];
+  G4double* x = &batch.x[begin];
+  G4double* y = &batch.y[begin];
+  G4double* z = &batch.z[begin];
+  G4double* px = &batch.px[begin];
+  G4double* py = &batch.py[begin];
+  G4double* pz = &batch.pz[begin];
+  G4double* sx = &batch.sx[begin];
+  G4double* sy = &batch.sy[begin];
+  G4double* sz = &batch.sz[begin];
+
+  // Energies from the inverse cumulative distribution
+  const G4double* table = &cdf[0];
+  for (size_t i = 0; i < n; i++)
+  {
+    G4double bin = uEnergy[i] * nBins;
+    G4int k = std::min((G4int) bin, nBins - 1);
+    energy[i] = table[k] + (bin - k) * (table[k + 1] - table[k]);
+  }
+
+  // Isotropic directions. As in G4Scintillation, the polarization is
+  // perpendicular to the direction at a random angle from the direction of
+  // increasing theta, (cos theta cos phi, cos theta sin phi, -sin theta),
+  // towards that of increasing phi, (-sin phi, cos phi, 0).
+  for (size_t i = 0; i < n; i++)
+  {
+    G4double cosTheta = 1. - 2. * uCosTheta[i];
+    G4double sinTheta = std::sqrt((1. - cosTheta) * (1. + cosTheta));
+    G4double phi = twopi * uPhi[i];
+    G4double cosPhi = std::cos(phi);
+    G4double sinPhi = std::sin(phi);
+    G4double psi = twopi * uPolarization[i];
+    G4double cosPsi = std::cos(psi);
+    G4double sinPsi = std::sin(psi);
+    px[i] = sinTheta * cosPhi;
+    py[i] = sinTheta * sinPhi;
+    pz[i] = cosTheta;
+    sx[i] = cosPsi * cosTheta * cosPhi - sinPsi * sinPhi;
+    sy[i] = cosPsi * cosTheta * sinPhi + sinPsi * cosPhi;
+    sz[i] = -cosPsi * sinTheta;
+  }
+
+  // Uniformly along the step for charged particles, at its end otherwise
+  const G4StepPoint* pre = aStep.GetPreStepPoint();
+  G4ThreeVector x0 = pre->GetPosition();
+  G4ThreeVector delta = aStep.GetDeltaPosition();
+  G4double t0 = pre->GetGlobalTime();
+  G4double flightTime = aStep.GetStepLength() * 2.
+    / (pre->GetVelocity() + aStep.GetPostStepPoint()->GetVelocity());
+  G4bool charged = aTrack.GetDefinition()->GetPDGCharge() != 0.;
+  for (size_t i = 0; i < n; i++)
+  {
+    G4double along = charged ? uPosition[i] : 1.;
+    x[i] = x0.x() + along * delta.x();
+    y[i] = x0.y() + along * delta.y();
+    z[i] = x0.z() + along * delta.z();
+    time[i] = t0 + along * flightTime;
+  }
+
+  // Emission times
+  if (riseTime == 0.)
+  {
+    for (size_t i = 0; i < n; i++)
+      time[i] -= decayTime * std::log(uTime[i]);
+  }
+  else
+  {
+    for (size_t i = 0; i < n; i++)
+      time[i] += RiseDecayTime(riseTime, decayTime);
+  }
+}
+
+// Makes the photons of a step, as G4Scintillation does
+G4VParticleChange* singCrysScintillation::PostStepDoIt(const G4Track& aTrack,
+                                                       const G4Step& aStep)
+{
+  aParticleChange.Initialize(aTrack);
+  const G4Material* material = aTrack.GetMaterial();
+  G4MaterialPropertiesTable* table = material->GetMaterialPropertiesTable();
+  if (!table) return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
+  G4MaterialPropertyVector* fastSpectrum = table->GetProperty("FASTCOMPONENT");
+  G4MaterialPropertyVector* slowSpectrum = table->GetProperty("SLOWCOMPONENT");
+  // A spectrum needs two points to be integrated. Shorter ones are skipped.
+  if (fastSpectrum && fastSpectrum->GetVectorLength() < 2) fastSpectrum = 0;
+  if (slowSpectrum && slowSpectrum->GetVectorLength() < 2) slowSpectrum = 0;
+  if (!fastSpectrum && !slowSpectrum)
+    return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
+
+  // Number of photons
+  G4double yield = table->GetConstProperty("SCINTILLATIONYIELD")
+    * GetScintillationYieldFactor();
+  G4double resolutionScale = table->GetConstProperty("RESOLUTIONSCALE");
+  G4EmSaturation* saturation = GetSaturation();
+  G4double meanPhotons = yield * (saturation ?
+    saturation->VisibleEnergyDeposition(&aStep) :
+    aStep.GetTotalEnergyDeposit());
+  G4int nPhotons;
+  if (meanPhotons > 10.)
+  {
+    G4double sigma = resolutionScale * std::sqrt(meanPhotons);
+    nPhotons = G4int(G4RandGauss::shoot(meanPhotons, sigma) + 0.5);
+  }
+  else nPhotons = G4int(G4Poisson(meanPhotons));
+  if (nPhotons <= 0)
+  {
+    aParticleChange.SetNumberOfSecondaries(0);
+    return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
+  }
+
+  // Split between the fast and slow components
+  G4int nFast = fastSpectrum ? nPhotons : 0;
+  if (fastSpectrum && slowSpectrum)
+  {
+    G4double ratio = GetScintillationExcitationRatio();
+    if (ratio == 1.) ratio = table->GetConstProperty("YIELDRATIO");
+    nFast = G4int(std::min(ratio, 1.) * nPhotons);
+  }
+  batch.Resize(nPhotons);
+  if (nFast > 0)
+  {
+    G4double riseTime = GetFiniteRiseTime() ?
+      table->GetConstProperty("FASTSCINTILLATIONRISETIME") : 0.;
+    Sample(aTrack, aStep, InverseCDF(material, fastSpectrum, true),
+           table->GetConstProperty("FASTTIMECONSTANT"), riseTime, 0, nFast);
+  }
+  if (nPhotons > nFast)
+  {
+    G4double riseTime = GetFiniteRiseTime() ?
+      table->GetConstProperty("SLOWSCINTILLATIONRISETIME") : 0.;
+    Sample(aTrack, aStep, InverseCDF(material, slowSpectrum, false),
+           table->GetConstProperty("SLOWTIMECONSTANT"), riseTime, nFast,
+           nPhotons);
+  }
+
+  // Photons made in the crystal are transported there without tracks
+  const singCrysDetectorConstruction* detector =
+    static_cast<const singCrysDetectorConstruction*>(
+      G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+  singCrysPrismTransport* transport = detector->GetPrismTransport();
+  const G4StepPoint* pre = aStep.GetPreStepPoint();
+  G4bool transported = transport &&
+    transport->Covers(pre->GetPhysicalVolume()->GetLogicalVolume());
+  G4int nAlive = nPhotons;
+  if (transported)
+  {
+    singCrysPhotonTally* tally = singCrysPhotonTally::GetInstance();
+    const G4AffineTransform& toLocal =
+      pre->GetTouchableHandle()->GetHistory()->GetTopTransform();
+    G4AffineTransform toGlobal = toLocal.Inverse();
+    for (G4int i = 0; i < nPhotons; i++)
+    {
+      singCrysPrismTransport::Photon photon;
+      photon.position = toLocal.TransformPoint(G4ThreeVector(batch.x[i],
+        batch.y[i], batch.z[i]));
+      photon.momentum = toLocal.TransformAxis(G4ThreeVector(batch.px[i],
+        batch.py[i], batch.pz[i]));
+      photon.polarization = toLocal.TransformAxis(G4ThreeVector(batch.sx[i],
+        batch.sy[i], batch.sz[i]));
+      photon.energy = batch.energy[i];
+      photon.time = batch.time[i];
+      photon.length = 0.;
+      singCrysPrismTransport::Outcome outcome = transport->Transport(photon);
+      if (outcome != singCrysPrismTransport::kHandedBack)
+      {
+        batch.alive[i] = 0;
+        nAlive--;
+        if (tally->IsEnabled())
+        {
+          tally->Record(singCrysPhotonTally::kCrystal, 0, photon.length);
+        }
+        continue;
+      }
+      G4ThreeVector position = toGlobal.TransformPoint(photon.position);
+      G4ThreeVector momentum = toGlobal.TransformAxis(photon.momentum);
+      G4ThreeVector polarization = toGlobal.TransformAxis(photon.polarization);
+      batch.x[i] = position.x();
+      batch.y[i] = position.y();
+      batch.z[i] = position.z();
+      batch.px[i] = momentum.x();
+      batch.py[i] = momentum.y();
+      batch.pz[i] = momentum.z();
+      batch.sx[i] = polarization.x();
+      batch.sy[i] = polarization.y();
+      batch.sz[i] = polarization.z();
+      batch.time[i] = photon.time;
+      batch.length[i] = photon.length;
+    }
+  }
+
+  // Make tracks of the remaining photons
+  aParticleChange.SetNumberOfSecondaries(nAlive);
+  if (nAlive > 0 && GetTrackSecondariesFirst() &&
+      aTrack.GetTrackStatus() == fAlive)
+    aParticleChange.ProposeTrackStatus(fSuspend);
+  for (G4int i = 0; i < nPhotons; i++)
+  {
+    if (!batch.alive[i]) continue;
+    G4DynamicParticle* photon =
+      new G4DynamicParticle(G4OpticalPhoton::OpticalPhoton(),
+        G4ThreeVector(batch.px[i], batch.py[i], batch.pz[i]));
+    photon->SetPolarization(batch.sx[i], batch.sy[i], batch.sz[i]);
+    photon->SetKineticEnergy(batch.energy[i]);
+    G4Track* secondary = new G4Track(photon, batch.time[i],
+      G4ThreeVector(batch.x[i], batch.y[i], batch.z[i]));
+    // The path in the crystal counts in the length of the track, as when
+    // singCrysPrismTransport is called from a fast simulation step
+    secondary->AddTrackLength(batch.length[i]);
+    // Photons handed back by the transport may be outside the crystal, so
+    // they are located from scratch
+    if (!transported) secondary->SetTouchableHandle(pre->GetTouchableHandle());
+    secondary->SetParentID(aTrack.GetTrackID());
+    aParticleChange.AddSecondary(secondary);
+  }
+  return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
+}
+
+// Particles at rest scintillate as in a step
+G4VParticleChange* singCrysScintillation::AtRestDoIt(const G4Track& aTrack,
+                                                     const G4Step& aStep)
+{
+  return PostStepDoIt(aTrack, aStep);
+}
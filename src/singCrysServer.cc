@@ -0,0 +1,154 @@
+/*!
+ * \file singCrysServer.cc
+ * \brief Implementation file for the singCrysServer class. Runs UI commands
+ * received over a Unix domain socket.
+ */
+
+#include "singCrysServer.hh"
+#include "singCrysRunAction.hh"
+#include "singCrysCheckpoint.hh"
+
+#include "G4UImanager.hh"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Constructor
+singCrysServer::singCrysServer(const std::string& path,
+                               singCrysRunAction* action) :
+  socketPath(path),
+  runAction(action),
+  listenFd(-1)
+{}
+
+// Destructor: close and remove the socket
+singCrysServer::~singCrysServer()
+{
+  if (listenFd >= 0)
+  {
+    close(listenFd);
+    unlink(socketPath.c_str());
+  }
+}
+
+// Opens the socket and serves one client at a time
+G4bool singCrysServer::Serve()
+{
+  struct sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path))
+  {
+    G4cerr << "Socket path " << socketPath << " is too long." << G4endl;
+    return false;
+  }
+  std::strcpy(address.sun_path, socketPath.c_str());
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socketPath.c_str());
+  if (listenFd < 0
+      || bind(listenFd, (struct sockaddr*) &address, sizeof(address)) != 0
+      || listen(listenFd, 4) != 0)
+  {
+    G4cerr << "Could not open socket " << socketPath << ": "
+      << std::strerror(errno) << G4endl;
+    return false;
+  }
+  // A client that disconnects early must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+  G4cout << "Serving on " << socketPath << G4endl;
+
+  G4bool shutdown = false;
+  while (!shutdown && WaitReadable(listenFd))
+  {
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0) continue;
+    shutdown = HandleClient(fd);
+    close(fd);
+  }
+  G4cout << "Server stopped." << G4endl;
+  return true;
+}
+
+// Reads lines from the client and executes them
+G4bool singCrysServer::HandleClient(int fd)
+{
+  std::string pending;
+  char buf[4096];
+  while (WaitReadable(fd))
+  {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    pending.append(buf, n);
+    size_t end;
+    while ((end = pending.find('\n')) != std::string::npos)
+    {
+      std::string line = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      // Strip the whitespace (and the carriage return of Windows clients)
+      size_t first = line.find_first_not_of(" \t\r");
+      if (first == std::string::npos || line[first] == '#') continue;
+      line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+      if (line == "exit") return false;
+      if (line == "shutdown")
+      {
+        WriteAll(fd, "ok\n");
+        return true;
+      }
+      Execute(fd, line);
+    }
+  }
+  // A stop was requested
+  return true;
+}
+
+// Executes a command and replies with the run summaries and the status
+void singCrysServer::Execute(int fd, const std::string& command)
+{
+  G4int status = G4UImanager::GetUIpointer()->ApplyCommand(command);
+  std::ostringstream reply;
+  std::vector<std::string> summaries = runAction->TakeSummaries();
+  for (size_t i = 0; i < summaries.size(); i++)
+    reply << "summary " << summaries[i] << "\n";
+  if (status == 0) reply << "ok\n";
+  else reply << "error " << status << "\n";
+  WriteAll(fd, reply.str());
+}
+
+// Writes a string, retrying on short writes
+G4bool singCrysServer::WriteAll(int fd, const std::string& str)
+{
+  size_t done = 0;
+  while (done < str.size())
+  {
+    ssize_t n = write(fd, str.data() + done, str.size() - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    done += n;
+  }
+  return true;
+}
+
+// Polls once a second, so that SIGINT and SIGTERM are noticed even if the
+// system call is restarted after the signal
+G4bool singCrysServer::WaitReadable(int fd)
+{
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while (!singCrysCheckpoint::StopRequested())
+  {
+    pfd.revents = 0;
+    int n = poll(&pfd, 1, 1000);
+    if (n > 0) return true;
+    if (n < 0 && errno != EINTR) return false;
+  }
+  return false;
+}
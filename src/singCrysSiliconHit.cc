@@ -13,14 +13,13 @@
 
 #include <iomanip>
 
-G4Allocator<singCrysSiliconHit> singCrysSiliconHitAllocator;
-
 // Constructor
 singCrysSiliconHit::singCrysSiliconHit()
   : G4VHit(),
     fTrackID(-1),
     fAPDNb(-1),
     fEdep(0.),
+    fTime(0.),
     fPos(G4ThreeVector()),
     fPVec(G4ThreeVector())
 {
@@ -39,6 +38,7 @@ singCrysSiliconHit::singCrysSiliconHit(const singCrysSiliconHit& right)
   fTrackID = right.fTrackID;
   fAPDNb = right.fAPDNb;
   fEdep = right.fEdep;
+  fTime = right.fTime;
   fPos = right.fPos;
   fPVec = right.fPVec;
 }
@@ -51,6 +51,7 @@ const singCrysSiliconHit& singCrysSiliconHit::
   fTrackID = right.fTrackID;
   fAPDNb = right.fAPDNb;
   fEdep = right.fEdep;
+  fTime = right.fTime;
   fPos = right.fPos;
   fPVec = right.fPVec;
   return *this;
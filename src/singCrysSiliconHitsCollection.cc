@@ -0,0 +1,91 @@
+/*!
+ * \file singCrysSiliconHitsCollection.cc
+ * \brief Implementation file for the singCrysSiliconHitArena and
+ * singCrysSiliconHitsCollection classes. Stores the silicon hits of an event
+ * column by column.
+ */
+
+#include "singCrysSiliconHitsCollection.hh"
+#include "singCrysHitSchema.hh"
+
+// Constructor. Decide which columns to store from the hit schema.
+singCrysSiliconHitArena::singCrysSiliconHitArena()
+  : nHits(0),
+    capacity(0)
+{
+  singCrysHitSchema* schema = singCrysHitSchema::GetInstance();
+  useFloat = schema->GetPrecision() != singCrysHitSchema::kDouble;
+  G4bool pos = schema->Has(singCrysHitSchema::kPosition);
+  G4bool mom = schema->Has(singCrysHitSchema::kMomentum);
+  realUsed[kEdep] = true;
+  realUsed[kTime] = schema->Has(singCrysHitSchema::kTime);
+  realUsed[kXPos] = realUsed[kYPos] = realUsed[kZPos] = pos;
+  realUsed[kXPVec] = realUsed[kYPVec] = realUsed[kZPVec] = mom;
+  intUsed[kTrackID] = schema->Has(singCrysHitSchema::kTrackID);
+  intUsed[kAPDNb] = schema->Has(singCrysHitSchema::kAPD);
+}
+
+// Reserves the next row, growing the columns if they are full. The row
+// still holds the values of an earlier event until it is set.
+size_t singCrysSiliconHitArena::Append()
+{
+  if (nHits == capacity) Grow();
+  return nHits++;
+}
+
+// Doubles the capacity of every stored column
+void singCrysSiliconHitArena::Grow()
+{
+  capacity = capacity ? 2 * capacity : 1024;
+  for (G4int c = 0; c < kNReal; c++)
+  {
+    if (!realUsed[c]) continue;
+    if (useFloat) floatColumns[c].resize(capacity, 0.);
+    else doubleColumns[c].resize(capacity, 0.);
+  }
+  for (G4int c = 0; c < kNInt; c++)
+    if (intUsed[c]) intColumns[c].resize(capacity, -1);
+}
+
+// Constructor
+singCrysSiliconHitsCollection::
+  singCrysSiliconHitsCollection(G4String detName, G4String colName,
+                                const singCrysSiliconHitArena* hitArena)
+  : G4VHitsCollection(detName, colName),
+    arena(hitArena)
+{
+}
+
+// Destructor
+singCrysSiliconHitsCollection::~singCrysSiliconHitsCollection()
+{
+}
+
+// Assembles a hit from the columns
+singCrysSiliconHit singCrysSiliconHitsCollection::operator[](size_t i) const
+{
+  typedef singCrysSiliconHitArena A;
+  singCrysSiliconHit hit;
+  hit.SetEdep(arena->Get(A::kEdep, i));
+  hit.SetTime(arena->Get(A::kTime, i));
+  hit.SetTrackID(arena->Get(A::kTrackID, i));
+  hit.SetAPDNb(arena->Get(A::kAPDNb, i));
+  hit.SetPos(G4ThreeVector(arena->Get(A::kXPos, i), arena->Get(A::kYPos, i),
+                           arena->Get(A::kZPos, i)));
+  hit.SetPVec(G4ThreeVector(arena->Get(A::kXPVec, i),
+                            arena->Get(A::kYPVec, i),
+                            arena->Get(A::kZPVec, i)));
+  return hit;
+}
+
+// Draw all hits
+void singCrysSiliconHitsCollection::DrawAllHits()
+{
+  for (size_t i = 0; i < arena->Size(); i++) (*this)[i].Draw();
+}
+
+// Print all hits
+void singCrysSiliconHitsCollection::PrintAllHits()
+{
+  for (size_t i = 0; i < arena->Size(); i++) (*this)[i].Print();
+}
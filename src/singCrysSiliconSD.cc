@@ -28,9 +28,11 @@ singCrysSiliconSD::~singCrysSiliconSD()
 // Initializes the hits collection associated with the detector
 void singCrysSiliconSD::Initialize(G4HCofThisEvent* hce)
 {
-  // Create hits collection
+  // Forget the hits of the previous event, which have been written out by
+  // now, and create a hits collection viewing the arena
+  fArena.Reset();
   fHitsCollection = new singCrysSiliconHitsCollection(SensitiveDetectorName,
-    collectionName[0]);
+    collectionName[0], &fArena);
 
   // Add this collection in hce
   G4int hcID
@@ -45,18 +47,33 @@ G4bool singCrysSiliconSD::ProcessHits(G4Step* aStep,
   // energy deposit
   G4double edep = aStep->GetTotalEnergyDeposit();
   if (edep == 0.) return false;
-  // Define a new hit and pass it the appropriate values. Argument in
-  // 'GetCopyNumber' specifies the mother volume.
-  singCrysSiliconHit* newHit = new singCrysSiliconHit();
-  newHit->SetTrackID (aStep->GetTrack()->GetTrackID());
-  newHit->SetAPDNb(aStep->GetPreStepPoint()->GetTouchableHandle()
-                                           ->GetCopyNumber(1));
-  newHit->SetEdep(edep);
-  newHit->SetPos(aStep->GetPostStepPoint()->GetPosition());
-  newHit->SetPVec(aStep->GetTrack()->GetMomentum());
-
-  fHitsCollection->insert(newHit);
-  newHit->Print();
+  // Add a new hit and pass it the values of the columns in the arena,
+  // i.e. the fields of the hit schema. Argument in 'GetCopyNumber'
+  // specifies the mother volume.
+  typedef singCrysSiliconHitArena A;
+  size_t i = fArena.Append();
+  fArena.Set(A::kEdep, i, edep);
+  if (fArena.Has(A::kTrackID))
+    fArena.Set(A::kTrackID, i, aStep->GetTrack()->GetTrackID());
+  if (fArena.Has(A::kAPDNb))
+    fArena.Set(A::kAPDNb, i, aStep->GetPreStepPoint()->GetTouchableHandle()
+                                                      ->GetCopyNumber(1));
+  if (fArena.Has(A::kTime))
+    fArena.Set(A::kTime, i, aStep->GetPostStepPoint()->GetGlobalTime());
+  if (fArena.Has(A::kXPos))
+  {
+    G4ThreeVector position = aStep->GetPostStepPoint()->GetPosition();
+    fArena.Set(A::kXPos, i, position.x());
+    fArena.Set(A::kYPos, i, position.y());
+    fArena.Set(A::kZPos, i, position.z());
+  }
+  if (fArena.Has(A::kXPVec))
+  {
+    G4ThreeVector momentum = aStep->GetTrack()->GetMomentum();
+    fArena.Set(A::kXPVec, i, momentum.x());
+    fArena.Set(A::kYPVec, i, momentum.y());
+    fArena.Set(A::kZPVec, i, momentum.z());
+  }
   return true;
 }
 
@@ -68,6 +85,6 @@ void singCrysSiliconSD::EndOfEvent(G4HCofThisEvent*)
     G4int nofHits = fHitsCollection->entries();
     G4cout << "\n---------> In this event there are " << nofHits
            << " hits in the tracker chambers: " << G4endl;
-    for (G4int i = 0; i < nofHits; i++) (*fHitsCollection)[i]->Print();
+    fHitsCollection->PrintAllHits();
   }
 }
@@ -0,0 +1,107 @@
+/*!
+ * \file singCrysSteppingAction.cc
+ * \brief Implementation file for the singCrysSteppingAction class. Follows
+ * the optical photons to find where they end up.
+ */
+
+#include "singCrysSteppingAction.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4OpBoundaryProcess.hh"
+#include "G4ProcessManager.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+
+// Constructor
+singCrysSteppingAction::singCrysSteppingAction() :
+  boundary(0),
+  currentTrack(0),
+  currentTrackID(-1),
+  bounces(0)
+{}
+
+// Destructor
+singCrysSteppingAction::~singCrysSteppingAction()
+{}
+
+// Counts the bounces and records the fate of optical photons
+void singCrysSteppingAction::UserSteppingAction(const G4Step* step)
+{
+  const G4Track* track = step->GetTrack();
+  if (track->GetDefinition() != G4OpticalPhoton::OpticalPhotonDefinition())
+    return;
+  // Tracks are followed one at a time, so a new track starts a new count
+  if (track != currentTrack || track->GetTrackID() != currentTrackID)
+  {
+    currentTrack = track;
+    currentTrackID = track->GetTrackID();
+    bounces = 0;
+  }
+
+  G4StepPoint* postPoint = step->GetPostStepPoint();
+  G4OpBoundaryProcessStatus status = Undefined;
+  if (postPoint->GetStepStatus() == fGeomBoundary)
+  {
+    if (!boundary) boundary = FindBoundaryProcess();
+    if (boundary) status = boundary->GetStatus();
+    switch (status)
+    {
+      case FresnelReflection:
+      case TotalInternalReflection:
+      case LambertianReflection:
+      case LobeReflection:
+      case SpikeReflection:
+      case BackScattering:
+        bounces++;
+        break;
+      default:
+        break;
+    }
+  }
+  if (track->GetTrackStatus() != fStopAndKill) return;
+
+  singCrysPhotonTally::Fate fate;
+  if (status == Detection) fate = singCrysPhotonTally::kDetected;
+  else if (!postPoint->GetPhysicalVolume())
+    fate = singCrysPhotonTally::kEscaped;
+  else if (status == Absorption)
+    fate = VolumeFate(postPoint->GetPhysicalVolume());
+  else fate = VolumeFate(step->GetPreStepPoint()->GetPhysicalVolume());
+  singCrysPhotonTally::GetInstance()->Record(fate, bounces,
+    track->GetTrackLength());
+}
+
+// Finds the boundary process in the process list of the optical photon
+G4OpBoundaryProcess* singCrysSteppingAction::FindBoundaryProcess()
+{
+  G4ProcessManager* pm =
+    G4OpticalPhoton::OpticalPhotonDefinition()->GetProcessManager();
+  if (!pm) return 0;
+  G4ProcessVector* processes = pm->GetProcessList();
+  for (G4int i = 0; i < processes->entries(); i++)
+  {
+    G4OpBoundaryProcess* process =
+      dynamic_cast<G4OpBoundaryProcess*>((*processes)[i]);
+    if (process) return process;
+  }
+  return 0;
+}
+
+// Fate of a photon absorbed in or on a volume, from its logical volume name
+singCrysPhotonTally::Fate singCrysSteppingAction::VolumeFate(
+  const G4VPhysicalVolume* volume)
+{
+  if (!volume) return singCrysPhotonTally::kEscaped;
+  const G4String& name = volume->GetLogicalVolume()->GetName();
+  if (name == "Crystal") return singCrysPhotonTally::kCrystal;
+  if (name == "Layer 1" || name == "Layer 2" || name == "Layer 1 Insert")
+    return singCrysPhotonTally::kWrapping;
+  if (name.compare(0, 2, "Al") == 0) return singCrysPhotonTally::kAluminum;
+  if (name == "Casing") return singCrysPhotonTally::kCasing;
+  if (name == "Silicon") return singCrysPhotonTally::kSilicon;
+  if (name == "Epoxy") return singCrysPhotonTally::kEpoxy;
+  if (name == "World") return singCrysPhotonTally::kEscaped;
+  return singCrysPhotonTally::kOther;
+}
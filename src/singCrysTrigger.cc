@@ -0,0 +1,113 @@
+/*!
+ * \file singCrysTrigger.cc
+ * \brief Implementation file for the singCrysTrigger class. Decides which
+ * events are written to the output.
+ */
+
+#include "singCrysTrigger.hh"
+#include "singCrysSiliconHitsCollection.hh"
+#include "singCrysConfig.hh"
+#include "singCrysHitSchema.hh"
+#include "G4SystemOfUnits.hh"
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <sstream>
+
+namespace po = boost::program_options;
+
+// Constructor. Get the options.
+singCrysTrigger::singCrysTrigger() :
+  nAccepted(0),
+  nRejected(0),
+  nPrescaled(0)
+{
+  po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
+  minHits = config["triggerMinHits"].as<G4int>();
+  coincidence = config["triggerCoincidence"].as<G4int>();
+  energyMin = config["triggerEnergyMin"].as<G4double>() * eV;
+  energyMax = config["triggerEnergyMax"].as<G4double>() * eV;
+  prescale = config["triggerPrescale"].as<G4int>();
+  G4int nAPD = config["nAPD"].as<G4int>();
+  hitsPerAPD.resize(nAPD > 0 ? nAPD : 1);
+  if (coincidence < 1) coincidence = 1;
+  if (minHits > 0 && coincidence > (G4int) hitsPerAPD.size())
+  {
+    G4cerr << "triggerCoincidence = " << coincidence << " needs more than "
+      << nAPD << " APD(s). Using " << hitsPerAPD.size() << "." << G4endl;
+    coincidence = hitsPerAPD.size();
+  }
+  active = minHits > 0 || energyMin > 0. || energyMax > 0.;
+  // The hits of each APD are counted
+  if (minHits > 0)
+    singCrysHitSchema::GetInstance()->Require(singCrysHitSchema::kAPD);
+}
+
+// Counts the event, and keeps it if it passes or is prescaled
+G4bool singCrysTrigger::Accept(const singCrysSiliconHitArena* arena)
+{
+  if (!active || Passes(arena))
+  {
+    nAccepted++;
+    return true;
+  }
+  nRejected++;
+  if (prescale > 0 && nRejected % prescale == 0)
+  {
+    nPrescaled++;
+    return true;
+  }
+  return false;
+}
+
+// Counts the hits per APD and sums their energy
+G4bool singCrysTrigger::Passes(const singCrysSiliconHitArena* arena)
+{
+  if (!arena) return false;
+  typedef singCrysSiliconHitArena A;
+  std::fill(hitsPerAPD.begin(), hitsPerAPD.end(), 0);
+  G4double energy = 0.;
+  for (size_t i = 0; i < arena->Size(); i++)
+  {
+    G4int APD = arena->Get(A::kAPDNb, i);
+    if (APD < 0 || APD >= (G4int) hitsPerAPD.size()) APD = 0;
+    hitsPerAPD[APD]++;
+    energy += arena->Get(A::kEdep, i);
+  }
+  if (minHits > 0)
+  {
+    G4int fired = 0;
+    for (size_t i = 0; i < hitsPerAPD.size(); i++)
+      if (hitsPerAPD[i] >= minHits) fired++;
+    if (fired < coincidence) return false;
+  }
+  if (energyMin > 0. && energy < energyMin) return false;
+  if (energyMax > 0. && energy > energyMax) return false;
+  return true;
+}
+
+// Describes the requirements and the counts
+std::string singCrysTrigger::Summary() const
+{
+  std::ostringstream summary;
+  if (!active)
+  {
+    summary << "no trigger: " << nAccepted << " events written";
+    return summary.str();
+  }
+  summary << "trigger";
+  if (minHits > 0)
+  {
+    summary << " [" << coincidence << " APD(s) with >= " << minHits
+      << " hits]";
+  }
+  if (energyMin > 0. || energyMax > 0.)
+  {
+    summary << " [energy " << energyMin / eV << " - ";
+    if (energyMax > 0.) summary << energyMax / eV << " eV]";
+    else summary << "inf eV]";
+  }
+  summary << ": " << nAccepted << " of " << nAccepted + nRejected
+    << " events accepted, " << nPrescaled << " rejected events written";
+  if (prescale > 0) summary << " (prescale " << prescale << ")";
+  return summary.str();
+}
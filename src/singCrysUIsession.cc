@@ -7,39 +7,223 @@
 #include "singCrysUIsession.hh"
 #include "singCrysConfig.hh"
 #include <boost/program_options.hpp>
+#include <boost/lexical_cast.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
 
 namespace po = boost::program_options;
 
-// Constructor. Open files.
-singCrysUIsession::singCrysUIsession() : G4UIsession()
+// Initialize static members
+singCrysUIsession* singCrysUIsession::fInstance = 0;
+
+// Constructor. Open files and start the flushing thread.
+singCrysUIsession::singCrysUIsession() : G4UIsession(),
+  logSize(0),
+  threadBuffer(&singCrysUIsession::KeepBuffer),
+  stopFlusher(false)
 {
-  // Get file names from config file
+  // Get file names and buffering options from config file
   po::variables_map config = *(singCrysConfig::GetInstance()->GetMap());
-  G4String logfileName = (G4String) config["logfileName"].as<std::string>();
+  logfileName = config["logfileName"].as<std::string>();
   G4String errfileName = (G4String) config["errfileName"].as<std::string>();
+  bufferSize = config["logBufferSize"].as<G4int>();
+  flushInterval = config["logFlushInterval"].as<G4int>();
+  maxLogSize = (std::streamoff) (config["logMaxSize"].as<G4double>()
+    * 1024 * 1024);
+  maxLogFiles = config["logMaxFiles"].as<G4int>();
   // Open files
-  logfile.open(logfileName);
+  logfile.open(logfileName.c_str());
   errfile.open(errfileName);
+
+  // Make sure buffered output is not lost if the program exits without
+  // deleting the session, or is killed by a fatal signal.
+  static G4bool exitHandlerRegistered = false;
+  if (!exitHandlerRegistered)
+  {
+    atexit(&singCrysUIsession::FlushAtExit);
+    exitHandlerRegistered = true;
+  }
+  fInstance = this;
+  signal(SIGSEGV, &singCrysUIsession::FlushOnSignal);
+  signal(SIGABRT, &singCrysUIsession::FlushOnSignal);
+  signal(SIGBUS, &singCrysUIsession::FlushOnSignal);
+  signal(SIGFPE, &singCrysUIsession::FlushOnSignal);
+
+  // Start the background flushing thread
+  flusher = boost::thread(&singCrysUIsession::FlusherLoop, this);
 }
 
 // Destructor
 singCrysUIsession::~singCrysUIsession()
 {
+  // Stop the flushing thread
+  {
+    boost::lock_guard<boost::mutex> lock(flushMutex);
+    stopFlusher = true;
+  }
+  flushCondition.notify_one();
+  flusher.join();
+  // Write out whatever is left
+  Flush();
+  if (fInstance == this)
+  {
+    fInstance = 0;
+    signal(SIGSEGV, SIG_DFL);
+    signal(SIGABRT, SIG_DFL);
+    signal(SIGBUS, SIG_DFL);
+    signal(SIGFPE, SIG_DFL);
+  }
   // Close files
   logfile.close();
   errfile.close();
+  // Delete the thread buffers
+  for (size_t i = 0; i < buffers.size(); i++) delete buffers[i];
+}
+
+// Returns the buffer of the calling thread
+singCrysUIsession::LogBuffer* singCrysUIsession::GetThreadBuffer()
+{
+  LogBuffer* buffer = threadBuffer.get();
+  if (!buffer)
+  {
+    // First output from this thread: make a buffer and register it so that
+    // the flushing thread can see it.
+    buffer = new LogBuffer;
+    buffer->data.reserve(bufferSize);
+    boost::lock_guard<boost::mutex> lock(buffersMutex);
+    buffers.push_back(buffer);
+    threadBuffer.reset(buffer);
+  }
+  return buffer;
 }
 
-// Diverts G4cout to file
+// Buffers G4cout. Only wakes up the flushing thread if the buffer is full.
 G4int singCrysUIsession::ReceiveG4cout(const G4String& coutString)
 {
-  logfile << coutString << flush;
+  LogBuffer* buffer = GetThreadBuffer();
+  G4bool full;
+  {
+    boost::lock_guard<boost::mutex> lock(buffer->mutex);
+    buffer->data += coutString;
+    full = buffer->data.size() >= bufferSize;
+  }
+  if (full) flushCondition.notify_one();
   return 0;
 }
 
-// Diverts G4cerr to file
+// Diverts G4cerr to file. Flushes buffered G4cout first so that the log is
+// complete up to the error. The file lock is held throughout, so output
+// taken from the buffers by the flushing thread is written before the error.
 G4int singCrysUIsession::ReceiveG4cerr(const G4String& cerrString)
 {
+  boost::lock_guard<boost::mutex> lock(fileMutex);
+  FlushLocked();
   errfile << cerrString << flush;
   return 0;
 }
+
+// Writes the buffers to the log
+void singCrysUIsession::Flush()
+{
+  boost::lock_guard<boost::mutex> lock(fileMutex);
+  FlushLocked();
+}
+
+// Collects the contents of all thread buffers and writes them to the log.
+// The file lock is taken before the buffers are emptied, so that no other
+// flush can write between the two.
+void singCrysUIsession::FlushLocked()
+{
+  std::string pending;
+  {
+    boost::lock_guard<boost::mutex> lock(buffersMutex);
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+      boost::lock_guard<boost::mutex> bufferLock(buffers[i]->mutex);
+      pending.append(buffers[i]->data);
+      // Keeps the capacity, so the buffer is not reallocated
+      buffers[i]->data.clear();
+    }
+  }
+  if (pending.empty()) return;
+  WriteLog(pending);
+  logfile.flush();
+}
+
+// Flushes whenever woken up by a full buffer, or after 'flushInterval' ms
+void singCrysUIsession::FlusherLoop()
+{
+  boost::unique_lock<boost::mutex> lock(flushMutex);
+  while (!stopFlusher)
+  {
+    flushCondition.timed_wait(lock,
+      boost::posix_time::milliseconds(flushInterval));
+    lock.unlock();
+    Flush();
+    lock.lock();
+  }
+}
+
+// Writes to the log file, rotating first if the text would make the file
+// exceed the maximum size.
+void singCrysUIsession::WriteLog(const std::string& text)
+{
+  if (maxLogSize > 0 && logSize > 0
+      && logSize + (std::streamoff) text.size() > maxLogSize)
+    RotateLog();
+  logfile << text;
+  logSize += text.size();
+}
+
+// Shifts log -> log.1 -> log.2 ... and drops the oldest file
+void singCrysUIsession::RotateLog()
+{
+  logfile.close();
+  for (G4int i = maxLogFiles - 1; i >= 1; i--)
+  {
+    std::string from = logfileName + "." + boost::lexical_cast<std::string>(i);
+    std::string to = logfileName + "." +
+      boost::lexical_cast<std::string>(i + 1);
+    std::rename(from.c_str(), to.c_str());
+  }
+  if (maxLogFiles > 0)
+    std::rename(logfileName.c_str(), (logfileName + ".1").c_str());
+  logfile.open(logfileName.c_str(), ios::trunc);
+  logSize = 0;
+}
+
+// Flushes without waiting on any lock, skipping buffers that are in use
+void singCrysUIsession::EmergencyFlush()
+{
+  if (!fileMutex.try_lock()) return;
+  if (buffersMutex.try_lock())
+  {
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+      if (!buffers[i]->mutex.try_lock()) continue;
+      logfile << buffers[i]->data;
+      buffers[i]->data.clear();
+      buffers[i]->mutex.unlock();
+    }
+    buffersMutex.unlock();
+  }
+  logfile.flush();
+  errfile.flush();
+  fileMutex.unlock();
+}
+
+// Flushes the active session at exit
+void singCrysUIsession::FlushAtExit()
+{
+  if (fInstance) fInstance->Flush();
+}
+
+// Flushes the active session on a fatal signal, then lets the signal take
+// its default action (core dump, etc.)
+void singCrysUIsession::FlushOnSignal(int sig)
+{
+  if (fInstance) fInstance->EmergencyFlush();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
@@ -0,0 +1,54 @@
+/*!
+ * \file singCrysUniformPropertyVector.cc
+ * \brief Implementation file for the singCrysUniformPropertyVector class.
+ * Material property vector on a uniform energy grid.
+ */
+
+#include "singCrysUniformPropertyVector.hh"
+#include <cmath>
+
+// Constructor: samples the original on the grid, and compares the linear
+// interpolation with the original at the middle of each bin
+singCrysUniformPropertyVector::
+  singCrysUniformPropertyVector(G4MaterialPropertyVector* original,
+                                G4int nBins)
+: G4MaterialPropertyVector(), invBinWidth(0.), maxError(0.), maxRelError(0.)
+{
+  size_t nOriginal = original->GetVectorLength();
+  G4double eMin = original->Energy(0);
+  G4double eMax = original->Energy(nOriginal - 1);
+  if (nBins < 1) nBins = 1;
+  G4double binWidth = (eMax - eMin) / nBins;
+  for (G4int i = 0; i <= nBins; i++)
+  {
+    // The last point is the exact edge, without rounding errors
+    G4double energy = (i == nBins) ? eMax : eMin + i * binWidth;
+    InsertValues(energy, original->Value(energy));
+  }
+  if (binWidth > 0.) invBinWidth = 1. / binWidth;
+
+  for (G4int i = 0; i < nBins; i++)
+  {
+    G4double energy = eMin + (i + 0.5) * binWidth;
+    G4double exact = original->Value(energy);
+    G4double linear = 0.5 * (dataVector[i] + dataVector[i + 1]);
+    G4double error = std::fabs(linear - exact);
+    if (error > maxError) maxError = error;
+    if (exact != 0. && error / std::fabs(exact) > maxRelError)
+      maxRelError = error / std::fabs(exact);
+  }
+}
+
+// Destructor: nothing to delete
+singCrysUniformPropertyVector::~singCrysUniformPropertyVector()
+{ }
+
+// The bin follows from the distance to the first energy
+size_t singCrysUniformPropertyVector::
+  FindBinLocation(G4double theEnergy) const
+{
+  if (theEnergy <= edgeMin) return 0;
+  size_t bin = (size_t) ((theEnergy - edgeMin) * invBinWidth);
+  if (bin > numberOfNodes - 2) bin = numberOfNodes - 2;
+  return bin;
+}